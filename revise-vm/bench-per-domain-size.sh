@@ -1,7 +1,8 @@
 #!/usr/bin/env bash
 
-# d64 is special - neon version does not work.
-exed=(./cj-solve-csp01 ./cj-solve-csp01-1bit)
+# d64: the kernels fall back to narrower vectors (down to scalar) when the
+# block is smaller than a vector, see src/cj-csp01/kernels.h.
+exed=("./cj-solve-csp01 --kernel neon" "./cj-solve-csp01 --kernel scalar" "./cj-solve-csp01 --kernel 1bit")
 exe=(./cj-solve-csp01 pycsp3-wrapper.sh)
 
 files=()
@@ -10,12 +11,11 @@ files+=("$d/n16d64c98t2048s7i0k10" "$d/n16d64c98t2048s2i0k10" "$d/n16d64c98t2048
 
 for i in $(seq 3); do
   for f in ${files[@]}; do
-    ./bench.sh "$f" "${exed[*]/%/-d512}" ${exe[*]} ${exe[*]}
+    ./bench.sh "$f" "${exed[@]/%/ --block-bits 512}" ${exe[*]} ${exe[*]}
   done
 done
 
-# all other domain sizes are ok.
-exed=(./cj-solve-csp01-neon ./cj-solve-csp01 ./cj-solve-csp01-1bit)
+exed=("./cj-solve-csp01 --kernel neon" "./cj-solve-csp01 --kernel scalar" "./cj-solve-csp01 --kernel 1bit")
 exe=(./cj-solve-csp01 pycsp3-wrapper.sh)
 
 d='instances/vars16-vals128-defs10/urbcsp'
@@ -29,6 +29,6 @@ files+=("$d/n10d1024c36t891289s63i1k5" "$d/n10d1024c36t891289s88i1k5" "$d/n10d10
 
 for i in $(seq 3); do
   for f in ${files[@]}; do
-    ./bench.sh "$f" "${exed[*]/%/-d512}" ${exe[*]} ${exe[*]}
+    ./bench.sh "$f" "${exed[@]/%/ --block-bits 512}" ${exe[*]} ${exe[*]}
   done
 done
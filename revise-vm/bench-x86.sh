@@ -0,0 +1,24 @@
+#!/usr/bin/env bash
+
+# The x86 revise kernels against the scalar one, at every domain size: the
+# solutions need to be the same (and so do the nodes and the revisions).
+exed=("./cj-solve-csp01 --kernel scalar" "./cj-solve-csp01 --kernel sse42" "./cj-solve-csp01 --kernel avx2" "./cj-solve-csp01 --kernel avx512")
+
+d='instances/vars16-vals64-defs10/urbcsp'
+f64=("$d/n16d64c98t2048s7i0k10" "$d/n16d64c98t2048s2i0k10" "$d/n16d64c98t2048s99i0k10")
+d='instances/vars16-vals128-defs10/urbcsp'
+f128=("$d/n16d128c96t9338s92i0k10" "$d/n16d128c96t9338s15i0k10" "$d/n16d128c96t9338s65i0k10")
+d='instances/vars12-vals256-defs10/urbcsp'
+f256=("$d/n12d256c52t47382s100i0k10" "$d/n12d256c52t47382s93i0k10" "$d/n12d256c52t47382s34i0k10")
+d='instances/vars10-vals512-defs5/urbcsp'
+f512=("$d/n10d512c36t217579s55i1k5" "$d/n10d512c36t217579s99i1k5" "$d/n10d512c36t217579s67i1k5")
+d='instances/vars10-vals1024-defs5/urbcsp'
+f1024=("$d/n10d1024c36t891289s63i1k5" "$d/n10d1024c36t891289s88i1k5" "$d/n10d1024c36t891289s78i1k5")
+
+for i in $(seq 3); do
+  for f in ${f64[@]}; do ./bench.sh "$f" "${exed[@]/%/ --block-bits 64}" "${exed[@]/%/ --block-bits 512}"; done
+  for f in ${f128[@]}; do ./bench.sh "$f" "${exed[@]/%/ --block-bits 128}" "${exed[@]/%/ --block-bits 512}"; done
+  for f in ${f256[@]}; do ./bench.sh "$f" "${exed[@]/%/ --block-bits 256}" "${exed[@]/%/ --block-bits 512}"; done
+  for f in ${f512[@]}; do ./bench.sh "$f" "${exed[@]/%/ --block-bits 512}"; done
+  for f in ${f1024[@]}; do ./bench.sh "$f" "${exed[@]/%/ --block-bits 1024}" "${exed[@]/%/ --block-bits 512}"; done
+done
@@ -0,0 +1,264 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "cj-csp-dense.h"
+
+#define CJ_LINE_BYTES 64
+
+CjDense cjDenseInit() {
+  CjDense x;
+  x.domainsSize = 0;
+  x.domains = NULL;
+  x.varsSize = 0;
+  x.vars = NULL;
+  x.defsSize = 0;
+  x.defs = NULL;
+  x.constraintsSize = 0;
+  x.constraintDefs = NULL;
+  return x;
+}
+
+void cjDenseFree(CjDense* inout) {
+  if (!inout) { return; }
+  if (inout->domains) {
+    for (int i = 0; i < inout->domainsSize; ++i) { free(inout->domains[i].values); }
+  }
+  if (inout->defs) {
+    for (int i = 0; i < inout->defsSize; ++i) { free(inout->defs[i].tuples.data); }
+  }
+  free(inout->domains);
+  free(inout->vars);
+  free(inout->defs);
+  free(inout->constraintDefs);
+  *inout = cjDenseInit();
+}
+
+int cjDenseIndex(const CjDenseDomain* domain, int value) {
+  int lo = 0, hi = domain->size;
+  while (lo < hi) {
+    const int mid = lo + (hi - lo) / 2;
+    if (domain->values[mid] < value) { lo = mid + 1; }
+    else { hi = mid; }
+  }
+  return lo < domain->size && domain->values[lo] == value ? lo : -1;
+}
+
+void cjDenseSolution(const CjDense* dense, const int* indices, int* values) {
+  for (int i = 0; i < dense->varsSize; ++i) {
+    values[i] = cjDenseValue(dense, i, indices[i]);
+  }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Domains
+//
+
+static int denseIntCompare(const void* a, const void* b) {
+  const int x = *(const int*) a;
+  const int y = *(const int*) b;
+  return (x > y) - (x < y);
+}
+
+/** Set out to the sorted distinct values of domain. */
+static CjError denseDomain(const CjDomain* domain, CjDenseDomain* out) {
+  const long long count = cjDomainCount(domain);
+  if (count < 0 || count > CJ_DENSE_MAX_VALUES) { return CJ_ERROR_ARG; }
+  out->size = 0;
+  if (!(out->values = (int*) malloc(sizeof(int) * (count > 0 ? count : 1)))) { return CJ_ERROR_NOMEM; }
+
+  if (domain->type == CJ_DOMAIN_VALUES) {
+    if (count > 0) { memcpy(out->values, domain->values.data, sizeof(int) * count); }
+    qsort(out->values, count, sizeof(int), denseIntCompare);
+    for (int i = 0; i < count; ++i) {
+      if (out->size == 0 || out->values[out->size - 1] != out->values[i]) {
+        out->values[out->size++] = out->values[i];
+      }
+    }
+  }
+  else {
+    for (int i = 0; i < domain->intervals.size; ++i) {
+      const int lo = domain->intervals.data[2 * i];
+      const int hi = domain->intervals.data[2 * i + 1];
+      for (long long v = lo; v <= hi; ++v) { out->values[out->size++] = (int) v; }
+    }
+  }
+  return CJ_ERROR_OK;
+}
+
+/**
+ * The value to index map of a domain: a table over [min, min + span) when
+ * the values are close enough together, a binary search otherwise.
+ */
+typedef struct CjDenseLookup {
+  int min;
+  int span;
+  int* index;
+} CjDenseLookup;
+
+static CjError denseLookupAlloc(const CjDenseDomain* domain, CjDenseLookup* out) {
+  out->min = 0;
+  out->span = 0;
+  out->index = NULL;
+  if (domain->size == 0) { return CJ_ERROR_OK; }
+  const long long span = (long long) domain->values[domain->size - 1] - domain->values[0] + 1;
+  if (span > 16LL * domain->size + 4096) { return CJ_ERROR_OK; }
+
+  if (!(out->index = (int*) malloc(sizeof(int) * span))) { return CJ_ERROR_NOMEM; }
+  memset(out->index, 0xff, sizeof(int) * span);
+  out->min = domain->values[0];
+  out->span = (int) span;
+  for (int i = 0; i < domain->size; ++i) {
+    out->index[domain->values[i] - out->min] = i;
+  }
+  return CJ_ERROR_OK;
+}
+
+static inline int denseLookup(const CjDenseLookup* lookup, const CjDenseDomain* domain, int value) {
+  if (!lookup->index) { return cjDenseIndex(domain, value); }
+  const unsigned r = (unsigned) value - (unsigned) lookup->min;
+  return r < (unsigned) lookup->span ? lookup->index[r] : -1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Defs
+//
+
+/** 1 if the variables of constraints a and b have the same domains. */
+static int denseSameDomains(const CjCsp* csp, const CjConstraint* a, const CjConstraint* b) {
+  if (a->vars.size != b->vars.size) { return 0; }
+  for (int i = 0; i < a->vars.size; ++i) {
+    if (csp->vars.data[a->vars.data[i]] != csp->vars.data[b->vars.data[i]]) { return 0; }
+  }
+  return 1;
+}
+
+/** Make the dense def of constraint c of csp. */
+static CjError denseDef(
+  const CjCsp* csp, const CjDense* dense, const CjDenseLookup* lookups, const CjConstraint* c,
+  CjDenseDef* out)
+{
+  const CjConstraintDef* def = &csp->constraintDefs[c->id];
+  const CjIntTuples* src;
+  if (def->type == CJ_CONSTRAINT_DEF_NO_GOODS) { src = &def->noGoods; }
+  else if (def->type == CJ_CONSTRAINT_DEF_GOODS) { src = &def->goods; }
+  else { return CJ_ERROR_ARG; }
+  const int arity = src->size > 0 ? src->arity : 0;
+  if (arity > 0 && arity != c->vars.size) { return CJ_ERROR_VALIDATION_CONSTRAINT_VARS_SIZE; }
+
+  int maxSize = 0;
+  for (int k = 0; k < arity; ++k) {
+    const int size = dense->domains[dense->vars[c->vars.data[k]]].size;
+    if (size > maxSize) { maxSize = size; }
+  }
+  const int width = maxSize <= (1 << 8) ? 1 : maxSize <= (1 << 16) ? 2 : 4;
+
+  out->id = c->id;
+  out->type = def->type;
+  out->tuples.size = 0;
+  out->tuples.arity = arity;
+  out->tuples.width = width;
+  out->tuples.data = NULL;
+  const size_t bytes = (size_t) src->size * arity * width;
+  if (bytes == 0) { return CJ_ERROR_OK; }
+  const size_t alignedBytes = (bytes + CJ_LINE_BYTES - 1) / CJ_LINE_BYTES * CJ_LINE_BYTES;
+  if (!(out->tuples.data = aligned_alloc(CJ_LINE_BYTES, alignedBytes))) { return CJ_ERROR_NOMEM; }
+
+  // Each tuple is written at the next free slot, which is only kept if all
+  // of its values are in their domains.
+  int n = 0;
+  for (int i = 0; i < src->size; ++i) {
+    const int* values = src->data + (size_t) i * arity;
+    const size_t at = (size_t) n * arity;
+    int k = 0;
+    for (; k < arity; ++k) {
+      const int iDom = dense->vars[c->vars.data[k]];
+      const int index = denseLookup(&lookups[iDom], &dense->domains[iDom], values[k]);
+      if (index < 0) { break; }
+      switch (width) {
+        case 1: ((uint8_t*) out->tuples.data)[at + k] = (uint8_t) index; break;
+        case 2: ((uint16_t*) out->tuples.data)[at + k] = (uint16_t) index; break;
+        default: ((uint32_t*) out->tuples.data)[at + k] = (uint32_t) index; break;
+      }
+    }
+    if (k == arity) { ++n; }
+  }
+  out->tuples.size = n;
+  return CJ_ERROR_OK;
+}
+
+CjError cjDenseAlloc(const CjCsp* csp, CjDense* out) {
+  if (!csp || !out) { return CJ_ERROR_ARG; }
+  *out = cjDenseInit();
+  CjDenseLookup* lookups = NULL;
+  int* heads = NULL;
+  int* nexts = NULL;
+  int* firsts = NULL;
+  int defsCapacity = csp->constraintDefsSize > 0 ? csp->constraintDefsSize : 1;
+  CjError err = CJ_ERROR_NOMEM;
+
+  // Domains and their lookups
+  if (!(out->domains = (CjDenseDomain*) calloc(csp->domainsSize + 1, sizeof(CjDenseDomain)))) { goto done; }
+  if (!(lookups = (CjDenseLookup*) calloc(csp->domainsSize + 1, sizeof(CjDenseLookup)))) { goto done; }
+  out->domainsSize = csp->domainsSize;
+  for (int i = 0; i < csp->domainsSize; ++i) {
+    if ((err = denseDomain(&csp->domains[i], &out->domains[i])) != CJ_ERROR_OK) { goto done; }
+    if ((err = denseLookupAlloc(&out->domains[i], &lookups[i])) != CJ_ERROR_OK) { goto done; }
+  }
+
+  // Variables
+  err = CJ_ERROR_NOMEM;
+  if (!(out->vars = (int*) malloc(sizeof(int) * (csp->vars.size + 1)))) { goto done; }
+  if (csp->vars.size > 0) { memcpy(out->vars, csp->vars.data, sizeof(int) * csp->vars.size); }
+  out->varsSize = csp->vars.size;
+
+  // Defs, one per def and domains of the constrained variables. Those made
+  // from a def are chained from heads[id] through nexts[], firsts[] is the
+  // constraint that made each.
+  if (!(out->constraintDefs = (int*) malloc(sizeof(int) * (csp->constraintsSize + 1)))) { goto done; }
+  out->constraintsSize = csp->constraintsSize;
+  if (!(heads = (int*) malloc(sizeof(int) * (csp->constraintDefsSize + 1)))) { goto done; }
+  for (int i = 0; i < csp->constraintDefsSize; ++i) { heads[i] = -1; }
+  if (!(out->defs = (CjDenseDef*) malloc(sizeof(CjDenseDef) * defsCapacity)) ||
+      !(nexts = (int*) malloc(sizeof(int) * defsCapacity)) ||
+      !(firsts = (int*) malloc(sizeof(int) * defsCapacity))) {
+    goto done;
+  }
+
+  for (int iC = 0; iC < csp->constraintsSize; ++iC) {
+    const CjConstraint* c = &csp->constraints[iC];
+    int j = heads[c->id];
+    while (j >= 0 && !denseSameDomains(csp, c, &csp->constraints[firsts[j]])) { j = nexts[j]; }
+    if (j < 0) {
+      if (out->defsSize == defsCapacity) {
+        defsCapacity *= 2;
+        CjDenseDef* defs = (CjDenseDef*) realloc(out->defs, sizeof(CjDenseDef) * defsCapacity);
+        if (defs) { out->defs = defs; }
+        int* grownNexts = (int*) realloc(nexts, sizeof(int) * defsCapacity);
+        if (grownNexts) { nexts = grownNexts; }
+        int* grownFirsts = (int*) realloc(firsts, sizeof(int) * defsCapacity);
+        if (grownFirsts) { firsts = grownFirsts; }
+        if (!defs || !grownNexts || !grownFirsts) { err = CJ_ERROR_NOMEM; goto done; }
+      }
+      j = out->defsSize;
+      out->defs[j].tuples.data = NULL;
+      ++out->defsSize;
+      if ((err = denseDef(csp, out, lookups, c, &out->defs[j])) != CJ_ERROR_OK) { goto done; }
+      nexts[j] = heads[c->id];
+      firsts[j] = iC;
+      heads[c->id] = j;
+    }
+    out->constraintDefs[iC] = j;
+  }
+  err = CJ_ERROR_OK;
+
+done:
+  if (lookups) {
+    for (int i = 0; i < csp->domainsSize; ++i) { free(lookups[i].index); }
+  }
+  free(lookups);
+  free(heads);
+  free(nexts);
+  free(firsts);
+  if (err != CJ_ERROR_OK) { cjDenseFree(out); }
+  return err;
+}
@@ -0,0 +1,95 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cj-csp-index.h"
+
+CjCspIndex cjCspIndexInit() {
+  CjCspIndex x;
+  x.constraintsSize = 0;
+  x.ids = NULL;
+  x.varOffsets = NULL;
+  x.varData = NULL;
+  x.varsSize = 0;
+  x.adjOffsets = NULL;
+  x.adjData = NULL;
+  return x;
+}
+
+void cjCspIndexFree(CjCspIndex* inout) {
+  if (!inout) { return; }
+  free(inout->ids);
+  free(inout->varOffsets);
+  free(inout->varData);
+  free(inout->adjOffsets);
+  free(inout->adjData);
+  *inout = cjCspIndexInit();
+}
+
+CjError cjCspIndexAlloc(const CjCsp* csp, CjCspIndex* out) {
+  if (!csp || !out) { return CJ_ERROR_ARG; }
+  *out = cjCspIndexInit();
+  const int numConstraints = csp->constraintsSize;
+  const int numVars = csp->vars.size;
+  int* last = NULL;
+  CjError err = CJ_ERROR_NOMEM;
+
+  // Constraints
+  long long numEntries = 0;
+  for (int c = 0; c < numConstraints; ++c) { numEntries += csp->constraints[c].vars.size; }
+  if (numEntries > INT_MAX) { return CJ_ERROR_ARG; }
+  if (!(out->ids = (int*) malloc(sizeof(int) * (numConstraints + 1))) ||
+      !(out->varOffsets = (int*) malloc(sizeof(int) * (numConstraints + 1))) ||
+      !(out->varData = (int*) malloc(sizeof(int) * (numEntries + 1)))) {
+    goto done;
+  }
+  out->constraintsSize = numConstraints;
+  out->varOffsets[0] = 0;
+  for (int c = 0; c < numConstraints; ++c) {
+    const CjConstraint* constraint = &csp->constraints[c];
+    out->ids[c] = constraint->id;
+    if (constraint->vars.size > 0) {
+      memcpy(out->varData + out->varOffsets[c], constraint->vars.data, sizeof(int) * constraint->vars.size);
+    }
+    out->varOffsets[c + 1] = out->varOffsets[c] + constraint->vars.size;
+  }
+
+  // Variables: count the constraints on each, turn the counts into offsets,
+  // then fill. last[v] is the latest constraint v was counted for, to count
+  // each constraint once.
+  if (!(out->adjOffsets = (int*) calloc(numVars + 1, sizeof(int))) ||
+      !(last = (int*) malloc(sizeof(int) * (numVars + 1)))) {
+    goto done;
+  }
+  out->varsSize = numVars;
+  for (int v = 0; v < numVars; ++v) { last[v] = -1; }
+  for (int c = 0; c < numConstraints; ++c) {
+    for (int i = out->varOffsets[c]; i < out->varOffsets[c + 1]; ++i) {
+      const int v = out->varData[i];
+      if (last[v] != c) {
+        last[v] = c;
+        ++out->adjOffsets[v + 1];
+      }
+    }
+  }
+  for (int v = 0; v < numVars; ++v) { out->adjOffsets[v + 1] += out->adjOffsets[v]; }
+  if (!(out->adjData = (int*) malloc(sizeof(int) * (out->adjOffsets[numVars] + 1)))) { goto done; }
+
+  // Reuse last[v] as the next free slot of v.
+  memcpy(last, out->adjOffsets, sizeof(int) * numVars);
+  for (int c = 0; c < numConstraints; ++c) {
+    for (int i = out->varOffsets[c]; i < out->varOffsets[c + 1]; ++i) {
+      const int v = out->varData[i];
+      const int at = last[v];
+      if (at > out->adjOffsets[v] && out->adjData[at - 1] == c) { continue; }
+      out->adjData[at] = c;
+      last[v] = at + 1;
+    }
+  }
+  err = CJ_ERROR_OK;
+
+done:
+  free(last);
+  if (err != CJ_ERROR_OK) { cjCspIndexFree(out); }
+  return err;
+}
@@ -10,22 +10,37 @@
 #include <vector>
 
 #include "cj/cj-csp.h"
+#include "cj/cj-csp-bin.h"
 #include "cj/cj-csp-io.h"
+#include "cj/cj.hpp"
 #include "io.h"
 
 using namespace std;
 
-IloIntVarArray genDomains(const CjCsp& csp, IloEnv& env) {
+IloIntVarArray genDomains(const cj::Csp& csp, IloEnv& env) {
   IloIntVarArray vars(env);
-  for (int iVar = 0; iVar < csp.vars.size; ++iVar) {
-    const CjDomain& dom = csp.domains[csp.vars.data[iVar]];
+  for (size_t iVar = 0; iVar < csp.vars().size(); ++iVar) {
+    const CjDomain& dom = csp.domainOf((int) iVar);
+    stringstream ss;
+    ss << "x" << iVar;
     if (dom.type == CjDomain::CJ_DOMAIN_VALUES) {
       IloIntArray values(env);
-      for (int iVal = 0; iVal < dom.values.size - 1; ++iVal) {
-        values.add(dom.values.data[iVal]);
+      for (int value : cj::values(dom)) {
+        values.add(value);
+      }
+      vars.add(IloIntVar(env, values, ss.str().c_str()));
+    }
+    else if (dom.type == CjDomain::CJ_DOMAIN_INTERVALS && dom.intervals.size == 1) {
+      vars.add(IloIntVar(env, dom.intervals.data[0], dom.intervals.data[1], ss.str().c_str()));
+    }
+    else if (dom.type == CjDomain::CJ_DOMAIN_INTERVALS) {
+      // Concert only takes bounds or a list of values, so list the values.
+      IloIntArray values(env);
+      for (cj::Span<const int> interval : cj::intervals(dom)) {
+        for (IloInt v = interval[0]; v <= interval[1]; ++v) {
+          values.add(v);
+        }
       }
-      stringstream ss;
-      ss << "x" << iVar;
       vars.add(IloIntVar(env, values, ss.str().c_str()));
     }
     else {
@@ -35,42 +50,37 @@ IloIntVarArray genDomains(const CjCsp& csp, IloEnv& env) {
   return vars;
 }
 
-int maxDomValue(const CjCsp& csp) {
+int maxDomValue(const cj::Csp& csp) {
   int maxVal = 0;
-  for (int iDom = 0; iDom < csp.domainsSize; ++iDom) {
-    CjDomain& dom = csp.domains[iDom];
-    if (dom.type == CjDomain::CJ_DOMAIN_VALUES) {
-      for (int iVal = 0; iVal < dom.values.size; ++iVal) {
-        maxVal = std::max(maxVal, dom.values.data[iVal]);
-      }
-    }
-    else {
+  for (const CjDomain& dom : csp.domains()) {
+    int domMin, domMax;
+    if (CJ_ERROR_OK != cjDomainBounds(&dom, &domMin, &domMax)) {
       throw std::string("ERROR: unsupported domain type.");
     }
+    maxVal = std::max(maxVal, domMax);
   }
   return maxVal;
 }
 
-void genConstraints(const CjCsp& csp, IloEnv& env, IloModel& model, IloIntVarArray& vars) {
+void genConstraints(const cj::Csp& csp, IloEnv& env, IloModel& model, IloIntVarArray& vars) {
   // TODO: The correct way to get these is by looking at all the domains of the variables involved in a constraint.
   int domMinVal = 0;
   int domMaxVal = maxDomValue(csp);
 
   // Constraint Definitions
+  // The tuple set copies the values it is given, so one array is reused
+  // for every tuple.
   vector<IloIntTupleSet> tupleSets;
-  for (int iCDef = 0; iCDef < csp.constraintDefsSize; ++iCDef) {
-    CjConstraintDef& cDef = csp.constraintDefs[iCDef];
-    if (cDef.type == CjConstraintDef::CJ_CONSTRAINT_DEF_NO_GOODS) {
-
-      const int arity = 2;
+  const int arity = 2;
+  IloIntArray pairValues(env, arity);
+  for (const CjConstraintDef& cDef : csp.constraintDefs()) {
+    if (cDef.type == CjConstraintDef::CJ_CONSTRAINT_DEF_NO_GOODS ||
+        cDef.type == CjConstraintDef::CJ_CONSTRAINT_DEF_GOODS) {
       tupleSets.push_back(IloIntTupleSet(env, arity));
-      for (int iTuple = 0; iTuple < cDef.noGoods.size; ++iTuple) {
-        tupleSets.back().add(
-          IloIntArray(
-            env,
-            2,
-            cDef.noGoods.data[iTuple * cDef.noGoods.arity + 0],
-            cDef.noGoods.data[iTuple * cDef.noGoods.arity + 1]));
+      for (cj::Span<const int> pair : cj::tuples(cDef)) {
+        pairValues[0] = pair[0];
+        pairValues[1] = pair[1];
+        tupleSets.back().add(pairValues);
       }
     }
     else {
@@ -78,17 +88,28 @@ void genConstraints(const CjCsp& csp, IloEnv& env, IloModel& model, IloIntVarArr
     }
   }
 
+  pairValues.end();
+
   // Constraints
-  for (int iConstraint = 0; iConstraint < csp.constraintsSize; ++iConstraint) {
-    CjConstraint& constraint = csp.constraints[iConstraint];
-    CjConstraintDef& cDef = csp.constraintDefs[constraint.id];
-    if (cDef.type == CjConstraintDef::CJ_CONSTRAINT_DEF_NO_GOODS) {
-      assert(constraint.vars.size == 2); // TODO: make this a stronger check
+  for (const CjConstraint& constraint : csp.constraints()) {
+    const CjConstraintDef& cDef = csp.constraintDefOf(constraint);
+    cj::Span<const int> scope = cj::scope(constraint);
+    if (cDef.type == CjConstraintDef::CJ_CONSTRAINT_DEF_GOODS) {
+      assert(scope.size() == 2); // TODO: make this a stronger check
+      model.add(
+        IloAllowedAssignments(
+          env,
+          vars[scope[0]],
+          vars[scope[1]],
+          tupleSets[constraint.id]));
+    }
+    else if (cDef.type == CjConstraintDef::CJ_CONSTRAINT_DEF_NO_GOODS) {
+      assert(scope.size() == 2); // TODO: make this a stronger check
       model.add(
         IloForbiddenAssignments(
           env,
-          vars[constraint.vars.data[0]],
-          vars[constraint.vars.data[1]],
+          vars[scope[0]],
+          vars[scope[1]],
           tupleSets[constraint.id]));
       std::vector<IloIntVar> cvars;
     }
@@ -99,7 +120,7 @@ void genConstraints(const CjCsp& csp, IloEnv& env, IloModel& model, IloIntVarArr
 }
 
 void printUsage() {
-  fprintf(stderr, "Usage: cj-solve-or-tools --csp INSTANCE_FILENAME\n");
+  fprintf(stderr, "Usage: cj-solve-or-tools --csp INSTANCE_FILENAME|- [--threads N]\n");
 }
 
 void solve(IloEnv& env, IloModel& model, IloIntVarArray& vars) {
@@ -153,7 +174,7 @@ int main(int argc, char** argv) {
   printCplexVersion();
 
   int err = 0;
-  if (argc != 3) {
+  if (argc < 3 || argc % 2 != 1) {
     fprintf(stderr, "ERROR: number of command line parameters.\n\n");
     printUsage();
     return 1;
@@ -165,30 +186,53 @@ int main(int argc, char** argv) {
   }
   char* cspInstanceFilename = argv[2];
 
-  FILE* cspInstanceFile = fopen(cspInstanceFilename, "r");
-  if (! cspInstanceFile) {
-    fprintf(stderr, "ERROR: failed to open csp instance file.\n");
+  CjParseOptions parseOptions = cjParseOptionsInit();
+  for (int i = 3; i < argc; i += 2) {
+    if (strcmp(argv[i], "--threads") == 0 && (parseOptions.numThreads = atoi(argv[i + 1])) >= 0) {
+      continue;
+    }
+    fprintf(stderr, "ERROR: bad %s flag.\n\n", argv[i]);
+    printUsage();
     return 1;
   }
 
-  char* cspJson = NULL;
-  size_t cspJsonLen = 0;
-  if (CJ_ERROR_OK != (err = readAll(cspInstanceFile, &cspJson, &cspJsonLen))) {
+  // The file goes after the csp, which may point into it.
+  ScopedLoadedFile cspInstanceFile;
+  if (0 != (err = loadAll(cspInstanceFilename, &cspInstanceFile))) {
     fprintf(stderr, "ERROR(%d): failed to read csp instance file.", err);
     return 1;
   }
+  const char* cspJson = cspInstanceFile.contents;
+  size_t cspJsonLen = cspInstanceFile.len;
 
-  CjCsp csp = cjCspInit();
-  if (CJ_ERROR_OK != (err = cjCspJsonParse(cspJson, cspJsonLen, &csp))) {
+  cj::Csp csp;
+  if (CJ_ERROR_OK != (err = csp.parse(cspJson, cspJsonLen, parseOptions))) {
     fprintf(stderr, "ERROR(%d): failed to parse csp instance file.", err);
     return 1;
   }
+  // A CSP-JSON csp holds its own copy of everything it needs, a cj-bin one
+  // points into the file.
+  if (!csp.borrowed()) {
+    unloadAll(&cspInstanceFile);
+  }
 
-  if (CJ_ERROR_OK != (err = cjCspValidate(&csp))) {
+  if (CJ_ERROR_OK != (err = cjCspValidate(csp.get()))) {
     fprintf(stderr, "ERROR(%d): failed to validate the csp instance.", err);
     return 1;
   }
 
+  // The tables take the tuples as listed, duplicates included.
+  if (CJ_ERROR_OK != (err = cjCspSortUniqueConstraintDefs(csp.get()))) {
+    fprintf(stderr, "ERROR(%d): failed to sort the constraint definitions.", err);
+    return 1;
+  }
+
+  // Instances often repeat the same table, build each once.
+  if (CJ_ERROR_OK != (err = cjCspDedupConstraintDefs(csp.get(), NULL))) {
+    fprintf(stderr, "ERROR(%d): failed to merge the constraint definitions.", err);
+    return 1;
+  }
+
   IloEnv env;
   try {
     IloIntVarArray vars = genDomains(csp, env);
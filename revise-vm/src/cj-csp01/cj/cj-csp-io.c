@@ -0,0 +1,1503 @@
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "cj-csp-io.h"
+
+// SSE2 is part of x86-64, the SSE4.1/AVX2 code is picked at run time.
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#include <immintrin.h>
+#include <stdint.h>
+#define CJ_SIMD_INTS
+#endif
+
+//#define CJ_DEBUG
+
+////////////////////////////////////////////////////////////////////////////////
+// json reader
+//
+// A streaming reader over the JSON text. The CSP-JSON structure is parsed
+// straight from the text and integers are written directly into the
+// CjIntTuples buffers, so no token array is ever built.
+//
+
+typedef struct CjReader {
+  /** The next unread character. */
+  const char* cur;
+  /** One past the last character. */
+  const char* end;
+  /** Allocate from this arena instead of malloc() if non-null. */
+  CjArena* arena;
+} CjReader;
+
+static CjReader readerInit(const char* json, const size_t jsonLen) {
+  CjReader r;
+  r.cur = json;
+  r.end = json + jsonLen;
+  r.arena = NULL;
+  return r;
+}
+
+/** realloc() from the arena of r, if any. */
+static void* readerRealloc(CjReader* r, void* p, size_t oldSize, size_t newSize) {
+  return r->arena ? cjArenaRealloc(r->arena, p, oldSize, newSize) : realloc(p, newSize);
+}
+
+/** free() unless p is in the arena of r. */
+static void readerFree(CjReader* r, void* p) {
+  if (!r->arena) { free(p); }
+}
+
+static void logReader(const char* prefix, CjReader* r) {
+#ifdef CJ_DEBUG
+  if (!prefix || !r) { return; }
+  printf("%s{", prefix);
+  for (const char* c = r->cur; c < r->end && c < r->cur + 32; ++c) {
+    printf("%c", *c);
+  }
+  printf("}\n");
+#endif
+}
+
+static int jsonIsWhitespace(char c) {
+  return c == ' ' || c == '\n' || c == '\r' || c == '\t';
+}
+
+/** return 1 if character is numeric, 0 otherwise. */
+static int jsonIsNumeric(char c) {
+  return c >= '0' && c <= '9';
+}
+
+static void readerSkipWhitespace(CjReader* r) {
+  while (r->cur < r->end && jsonIsWhitespace(*r->cur)) { ++r->cur; }
+}
+
+/** Skip whitespace and return the next character, or -1 at the end. */
+static int readerPeek(CjReader* r) {
+  readerSkipWhitespace(r);
+  return r->cur < r->end ? (unsigned char) *r->cur : -1;
+}
+
+/** The error for an unexpected character (or end of input) at r->cur. */
+static CjError readerSyntaxError(CjReader* r) {
+  return r->cur < r->end ? CJ_ERROR_JSMN_INVAL : CJ_ERROR_JSMN_PART;
+}
+
+/**
+ * The error for a well-formed JSON value of the wrong type at r->cur:
+ * return err, unless the next character cannot start a JSON value at all.
+ */
+static CjError readerTypeError(CjReader* r, CjError err) {
+  if (r->cur >= r->end) { return CJ_ERROR_JSMN_PART; }
+  switch (*r->cur) {
+    case '{': case '[': case '"': case '-':
+    case 't': case 'f': case 'n':
+      return err;
+    default:
+      return jsonIsNumeric(*r->cur) ? err : CJ_ERROR_JSMN_INVAL;
+  }
+}
+
+/** Consume c (after whitespace) or return a syntax error. */
+static CjError readerExpect(CjReader* r, char c) {
+  if (readerPeek(r) != c) { return readerSyntaxError(r); }
+  ++r->cur;
+  return CJ_ERROR_OK;
+}
+
+/**
+ * Consume a JSON string. On success [*start, *start + *len) holds the string
+ * without its enclosing quotes. Escapes are validated but not decoded.
+ */
+static CjError readerString(CjReader* r, const char** start, size_t* len) {
+  if (readerPeek(r) != '"') { return readerSyntaxError(r); }
+  const char* c = r->cur + 1;
+  for (; c < r->end; ++c) {
+    if (*c == '"') {
+      *start = r->cur + 1;
+      *len = c - *start;
+      r->cur = c + 1;
+      return CJ_ERROR_OK;
+    }
+    if (*c == '\\') {
+      if (++c >= r->end) { break; }
+      switch (*c) {
+        case '"': case '/': case '\\': case 'b':
+        case 'f': case 'r': case 'n': case 't':
+          break;
+        case 'u':
+          for (int i = 0; i < 4; ++i) {
+            if (++c >= r->end) { return CJ_ERROR_JSMN_PART; }
+            const char h = *c;
+            if (!jsonIsNumeric(h) && !(h >= 'A' && h <= 'F') && !(h >= 'a' && h <= 'f')) {
+              return CJ_ERROR_JSMN_INVAL;
+            }
+          }
+          break;
+        default:
+          return CJ_ERROR_JSMN_INVAL;
+      }
+    }
+  }
+  return CJ_ERROR_JSMN_PART;
+}
+
+/** Consume a string followed by ':' and return it as an object key. */
+static CjError readerKey(CjReader* r, const char** key, size_t* keyLen) {
+  CjError stat = readerString(r, key, keyLen);
+  if (stat != CJ_ERROR_OK) { return stat; }
+  return readerExpect(r, ':');
+}
+
+/** Return 1 if the key [key, key + keyLen) equals s, 0 otherwise. */
+static int jsonKeyEq(const char* key, size_t keyLen, const char* s) {
+  return strlen(s) == keyLen && strncmp(key, s, keyLen) == 0;
+}
+
+/**
+ * After a member of an object or array, consume the ',' (return 1) or the
+ * closing character (return 0). Return a negative CjError otherwise.
+ */
+static int readerNextMember(CjReader* r, char close) {
+  const int c = readerPeek(r);
+  if (c == ',') { ++r->cur; return 1; }
+  if (c == close) { ++r->cur; return 0; }
+  return readerSyntaxError(r);
+}
+
+/**
+ * Consume a JSON integer into *out and return 1.
+ * Return 0 without consuming anything if the next value is not an integer
+ * that fits in an int.
+ */
+static int readerInt(CjReader* r, int* out) {
+  readerSkipWhitespace(r);
+  const char* c = r->cur;
+  const int negative = c < r->end && *c == '-';
+  if (negative) { ++c; }
+  if (c >= r->end || !jsonIsNumeric(*c)) { return 0; }
+
+  long long value = 0;
+  for (; c < r->end && jsonIsNumeric(*c); ++c) {
+    value = value * 10 + (*c - '0');
+    if (value > (long long) INT_MAX + 1) { return 0; }
+  }
+  if (negative) { value = -value; }
+  if (value > INT_MAX) { return 0; }
+
+  // Reject the remainder of a non-integer number (eg. 1.5 or 1e3).
+  if (c < r->end && (*c == '.' || *c == 'e' || *c == 'E')) { return 0; }
+
+  *out = (int) value;
+  r->cur = c;
+  return 1;
+}
+
+/** Consume any JSON value. */
+static CjError readerSkipValue(CjReader* r, int depth) {
+  if (depth > 512) { return CJ_ERROR_JSMN_INVAL; }
+  const int c = readerPeek(r);
+  if (c == '"') {
+    const char* start;
+    size_t len;
+    return readerString(r, &start, &len);
+  }
+  else if (c == '{' || c == '[') {
+    const char close = c == '{' ? '}' : ']';
+    ++r->cur;
+    if (readerPeek(r) == close) { ++r->cur; return CJ_ERROR_OK; }
+    for (;;) {
+      if (c == '{') {
+        const char* key;
+        size_t keyLen;
+        CjError stat = readerKey(r, &key, &keyLen);
+        if (stat != CJ_ERROR_OK) { return stat; }
+      }
+      CjError stat = readerSkipValue(r, depth + 1);
+      if (stat != CJ_ERROR_OK) { return stat; }
+      int more = readerNextMember(r, close);
+      if (more < 0) { return more; }
+      if (!more) { return CJ_ERROR_OK; }
+    }
+  }
+  else if (c == '-' || jsonIsNumeric(c)) {
+    const char* p = r->cur + 1;
+    while (p < r->end && (jsonIsNumeric(*p) || *p == '.' || *p == 'e' ||
+                          *p == 'E' || *p == '+' || *p == '-')) {
+      ++p;
+    }
+    r->cur = p;
+    return CJ_ERROR_OK;
+  }
+  else {
+    static const char* literals[] = {"true", "false", "null"};
+    for (int i = 0; i < 3; ++i) {
+      const size_t len = strlen(literals[i]);
+      if ((size_t) (r->end - r->cur) >= len && strncmp(r->cur, literals[i], len) == 0) {
+        r->cur += len;
+        return CJ_ERROR_OK;
+      }
+    }
+    return readerSyntaxError(r);
+  }
+}
+
+/**
+ * Copy [start, start + len) into a new allocated, null terminated string.
+ * Return CJ_ERROR_OK on success.
+ * Free the output string with readerFree().
+ */
+static CjError jsonStrCpy(CjReader* r, const char* start, size_t len, char** out) {
+  if (!start || !out) { return CJ_ERROR_ARG; }
+  *out = readerRealloc(r, NULL, 0, len + 1);
+  if (!(*out)) { return CJ_ERROR_NOMEM; }
+  memcpy(*out, start, len);
+  (*out)[len] = '\0';
+  return CJ_ERROR_OK;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// cjIntTuples
+//
+
+/** A growable int buffer that ends up as CjIntTuples.data. */
+typedef struct CjIntBuf {
+  int* data;
+  size_t size;
+  size_t capacity;
+  /** The arena data is allocated from, or null for malloc(). */
+  CjArena* arena;
+} CjIntBuf;
+
+static CjIntBuf intBufInit(CjArena* arena) {
+  CjIntBuf buf;
+  buf.data = NULL;
+  buf.size = 0;
+  buf.capacity = 0;
+  buf.arena = arena;
+  return buf;
+}
+
+static void* intBufRealloc(CjIntBuf* buf, size_t capacity) {
+  return buf->arena
+    ? cjArenaRealloc(buf->arena, buf->data, sizeof(int) * buf->capacity, sizeof(int) * capacity)
+    : realloc(buf->data, sizeof(int) * capacity);
+}
+
+static void intBufFree(CjIntBuf* buf) {
+  if (!buf->arena) { free(buf->data); }
+  buf->data = NULL;
+  buf->size = buf->capacity = 0;
+}
+
+/** Make room for at least n more ints. */
+static CjError intBufReserve(CjIntBuf* buf, size_t n) {
+  if (buf->size + n <= buf->capacity) { return CJ_ERROR_OK; }
+  size_t capacity = buf->capacity ? 2 * buf->capacity : 64;
+  while (capacity < buf->size + n) { capacity *= 2; }
+  int* grown = intBufRealloc(buf, capacity);
+  if (!grown) { return CJ_ERROR_NOMEM; }
+  buf->data = grown;
+  buf->capacity = capacity;
+  return CJ_ERROR_OK;
+}
+
+static CjError intBufPush(CjIntBuf* buf, int x) {
+  if (buf->size == buf->capacity) {
+    CjError stat = intBufReserve(buf, 1);
+    if (stat != CJ_ERROR_OK) { return stat; }
+  }
+  buf->data[buf->size++] = x;
+  return CJ_ERROR_OK;
+}
+
+/** Hand the buffer over to ts, trimming the unused capacity. */
+static void intBufToTuples(CjIntBuf* buf, int size, int arity, CjIntTuples* ts) {
+  ts->size = size;
+  ts->arity = arity;
+  ts->data = buf->data;
+  if (buf->size == 0) {
+    intBufFree(buf);
+    ts->data = NULL;
+  }
+  else if (buf->size < buf->capacity) {
+    int* trimmed = intBufRealloc(buf, buf->size);
+    if (trimmed) { ts->data = trimmed; }
+  }
+  buf->data = NULL;
+  buf->size = buf->capacity = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// SIMD int arrays
+//
+// A fast path for the bulk of a CSP-JSON file: arrays of small ints such as
+// "noGoods": [[1, 2], [3, 4], ...]. Each 16-byte window of input is
+// classified into digits, punctuation and whitespace with vector compares.
+// The tokens of the window ('[', ',', ']' and the first digit of each number)
+// are packed together with a shuffle and checked at once against the token
+// sequence that an array of the expected arity repeats. The digits of all
+// numbers in the window are then shuffled into 4-byte slots and converted
+// together with two multiply-adds.
+//
+// Anything unusual (negative numbers, more than 4 digits, other characters,
+// a wrong arity) stops the fast path at the last complete item, and the
+// scalar reader takes over from there and reports any error.
+//
+
+#ifdef CJ_SIMD_INTS
+
+/** The longest tuple handled by the fast path. */
+#define CJ_SIMD_MAX_ARITY 8
+/** The number of tokens of one item: "[0,0,...,0],". */
+#define CJ_SIMD_MAX_PERIOD (2 * CJ_SIMD_MAX_ARITY + 2)
+
+/** Bit i of each mask describes byte i of a 16-byte window. */
+typedef struct CjSimdWindow {
+  uint32_t digits;
+  /** '[', ',' and ']'. */
+  uint32_t punct;
+  uint32_t closes;
+  /** Anything but digits, punctuation and whitespace. */
+  uint32_t other;
+  /** The window with every digit replaced by '0'. */
+  __m128i tokens;
+  /** The digit values of the window. */
+  __m128i values;
+} CjSimdWindow;
+
+/**
+ * Shuffle control that packs the bytes selected by an 8-bit mask to the
+ * front, in order. 0x80 bytes are zero filled by the shuffle.
+ */
+static const uint64_t simdPackControl[256] = {
+  0x8080808080808080ull, 0x8080808080808000ull, 0x8080808080808001ull, 0x8080808080800100ull,
+  0x8080808080808002ull, 0x8080808080800200ull, 0x8080808080800201ull, 0x8080808080020100ull,
+  0x8080808080808003ull, 0x8080808080800300ull, 0x8080808080800301ull, 0x8080808080030100ull,
+  0x8080808080800302ull, 0x8080808080030200ull, 0x8080808080030201ull, 0x8080808003020100ull,
+  0x8080808080808004ull, 0x8080808080800400ull, 0x8080808080800401ull, 0x8080808080040100ull,
+  0x8080808080800402ull, 0x8080808080040200ull, 0x8080808080040201ull, 0x8080808004020100ull,
+  0x8080808080800403ull, 0x8080808080040300ull, 0x8080808080040301ull, 0x8080808004030100ull,
+  0x8080808080040302ull, 0x8080808004030200ull, 0x8080808004030201ull, 0x8080800403020100ull,
+  0x8080808080808005ull, 0x8080808080800500ull, 0x8080808080800501ull, 0x8080808080050100ull,
+  0x8080808080800502ull, 0x8080808080050200ull, 0x8080808080050201ull, 0x8080808005020100ull,
+  0x8080808080800503ull, 0x8080808080050300ull, 0x8080808080050301ull, 0x8080808005030100ull,
+  0x8080808080050302ull, 0x8080808005030200ull, 0x8080808005030201ull, 0x8080800503020100ull,
+  0x8080808080800504ull, 0x8080808080050400ull, 0x8080808080050401ull, 0x8080808005040100ull,
+  0x8080808080050402ull, 0x8080808005040200ull, 0x8080808005040201ull, 0x8080800504020100ull,
+  0x8080808080050403ull, 0x8080808005040300ull, 0x8080808005040301ull, 0x8080800504030100ull,
+  0x8080808005040302ull, 0x8080800504030200ull, 0x8080800504030201ull, 0x8080050403020100ull,
+  0x8080808080808006ull, 0x8080808080800600ull, 0x8080808080800601ull, 0x8080808080060100ull,
+  0x8080808080800602ull, 0x8080808080060200ull, 0x8080808080060201ull, 0x8080808006020100ull,
+  0x8080808080800603ull, 0x8080808080060300ull, 0x8080808080060301ull, 0x8080808006030100ull,
+  0x8080808080060302ull, 0x8080808006030200ull, 0x8080808006030201ull, 0x8080800603020100ull,
+  0x8080808080800604ull, 0x8080808080060400ull, 0x8080808080060401ull, 0x8080808006040100ull,
+  0x8080808080060402ull, 0x8080808006040200ull, 0x8080808006040201ull, 0x8080800604020100ull,
+  0x8080808080060403ull, 0x8080808006040300ull, 0x8080808006040301ull, 0x8080800604030100ull,
+  0x8080808006040302ull, 0x8080800604030200ull, 0x8080800604030201ull, 0x8080060403020100ull,
+  0x8080808080800605ull, 0x8080808080060500ull, 0x8080808080060501ull, 0x8080808006050100ull,
+  0x8080808080060502ull, 0x8080808006050200ull, 0x8080808006050201ull, 0x8080800605020100ull,
+  0x8080808080060503ull, 0x8080808006050300ull, 0x8080808006050301ull, 0x8080800605030100ull,
+  0x8080808006050302ull, 0x8080800605030200ull, 0x8080800605030201ull, 0x8080060503020100ull,
+  0x8080808080060504ull, 0x8080808006050400ull, 0x8080808006050401ull, 0x8080800605040100ull,
+  0x8080808006050402ull, 0x8080800605040200ull, 0x8080800605040201ull, 0x8080060504020100ull,
+  0x8080808006050403ull, 0x8080800605040300ull, 0x8080800605040301ull, 0x8080060504030100ull,
+  0x8080800605040302ull, 0x8080060504030200ull, 0x8080060504030201ull, 0x8006050403020100ull,
+  0x8080808080808007ull, 0x8080808080800700ull, 0x8080808080800701ull, 0x8080808080070100ull,
+  0x8080808080800702ull, 0x8080808080070200ull, 0x8080808080070201ull, 0x8080808007020100ull,
+  0x8080808080800703ull, 0x8080808080070300ull, 0x8080808080070301ull, 0x8080808007030100ull,
+  0x8080808080070302ull, 0x8080808007030200ull, 0x8080808007030201ull, 0x8080800703020100ull,
+  0x8080808080800704ull, 0x8080808080070400ull, 0x8080808080070401ull, 0x8080808007040100ull,
+  0x8080808080070402ull, 0x8080808007040200ull, 0x8080808007040201ull, 0x8080800704020100ull,
+  0x8080808080070403ull, 0x8080808007040300ull, 0x8080808007040301ull, 0x8080800704030100ull,
+  0x8080808007040302ull, 0x8080800704030200ull, 0x8080800704030201ull, 0x8080070403020100ull,
+  0x8080808080800705ull, 0x8080808080070500ull, 0x8080808080070501ull, 0x8080808007050100ull,
+  0x8080808080070502ull, 0x8080808007050200ull, 0x8080808007050201ull, 0x8080800705020100ull,
+  0x8080808080070503ull, 0x8080808007050300ull, 0x8080808007050301ull, 0x8080800705030100ull,
+  0x8080808007050302ull, 0x8080800705030200ull, 0x8080800705030201ull, 0x8080070503020100ull,
+  0x8080808080070504ull, 0x8080808007050400ull, 0x8080808007050401ull, 0x8080800705040100ull,
+  0x8080808007050402ull, 0x8080800705040200ull, 0x8080800705040201ull, 0x8080070504020100ull,
+  0x8080808007050403ull, 0x8080800705040300ull, 0x8080800705040301ull, 0x8080070504030100ull,
+  0x8080800705040302ull, 0x8080070504030200ull, 0x8080070504030201ull, 0x8007050403020100ull,
+  0x8080808080800706ull, 0x8080808080070600ull, 0x8080808080070601ull, 0x8080808007060100ull,
+  0x8080808080070602ull, 0x8080808007060200ull, 0x8080808007060201ull, 0x8080800706020100ull,
+  0x8080808080070603ull, 0x8080808007060300ull, 0x8080808007060301ull, 0x8080800706030100ull,
+  0x8080808007060302ull, 0x8080800706030200ull, 0x8080800706030201ull, 0x8080070603020100ull,
+  0x8080808080070604ull, 0x8080808007060400ull, 0x8080808007060401ull, 0x8080800706040100ull,
+  0x8080808007060402ull, 0x8080800706040200ull, 0x8080800706040201ull, 0x8080070604020100ull,
+  0x8080808007060403ull, 0x8080800706040300ull, 0x8080800706040301ull, 0x8080070604030100ull,
+  0x8080800706040302ull, 0x8080070604030200ull, 0x8080070604030201ull, 0x8007060403020100ull,
+  0x8080808080070605ull, 0x8080808007060500ull, 0x8080808007060501ull, 0x8080800706050100ull,
+  0x8080808007060502ull, 0x8080800706050200ull, 0x8080800706050201ull, 0x8080070605020100ull,
+  0x8080808007060503ull, 0x8080800706050300ull, 0x8080800706050301ull, 0x8080070605030100ull,
+  0x8080800706050302ull, 0x8080070605030200ull, 0x8080070605030201ull, 0x8007060503020100ull,
+  0x8080808007060504ull, 0x8080800706050400ull, 0x8080800706050401ull, 0x8080070605040100ull,
+  0x8080800706050402ull, 0x8080070605040200ull, 0x8080070605040201ull, 0x8007060504020100ull,
+  0x8080800706050403ull, 0x8080070605040300ull, 0x8080070605040301ull, 0x8007060504030100ull,
+  0x8080070605040302ull, 0x8007060504030200ull, 0x8007060504030201ull, 0x0706050403020100ull,
+};
+
+// The fast path is compiled for SSE4.1 and for AVX2 whatever the flags of
+// the build, simdParseItems() runs the one the CPU has.
+#define CJ_SIMD_TARGET "sse4.1"
+#define CJ_SIMD_NAME(name) name##Sse41
+#include "cj-csp-io-simd.h"
+#undef CJ_SIMD_TARGET
+#undef CJ_SIMD_NAME
+
+#define CJ_SIMD_TARGET "avx2"
+#define CJ_SIMD_NAME(name) name##Avx2
+#define CJ_SIMD_AVX2
+#include "cj-csp-io-simd.h"
+#undef CJ_SIMD_TARGET
+#undef CJ_SIMD_NAME
+#undef CJ_SIMD_AVX2
+
+/**
+ * Decode as many complete items as possible starting at r->cur with the
+ * fast path of the CPU, see simdParseItemsSse41().
+ * @return the number of items decoded (0 if the CPU has no fast path), or
+ *   a negative CjError.
+ */
+static int simdParseItems(CjReader* r, const int arity, CjIntBuf* buf) {
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2")) { return simdParseItemsAvx2(r, arity, buf); }
+  if (__builtin_cpu_supports("sse4.1")) { return simdParseItemsSse41(r, arity, buf); }
+  return 0;
+}
+
+#endif // CJ_SIMD_INTS
+
+/** Parse the ints of one tuple (after its '[') and return the arity. */
+static int cjIntTuplesParseTuple(CjReader* r, CjIntBuf* buf) {
+  if (readerPeek(r) == ']') { ++r->cur; return 0; }
+  int arity = 0;
+  for (;;) {
+    int x;
+    if (!readerInt(r, &x)) { return readerTypeError(r, CJ_ERROR_INTTUPLES_ITEM_TYPE); }
+    CjError stat = intBufPush(buf, x);
+    if (stat != CJ_ERROR_OK) { return stat; }
+    ++arity;
+    int more = readerNextMember(r, ']');
+    if (more < 0) { return more; }
+    if (!more) { return arity; }
+  }
+}
+
+static CjError cjIntTuplesParseReader(const int defaultArity, CjReader* r, CjIntTuples* ts) {
+  logReader("CjIntTuples:", r);
+  if (!r || !ts) { return CJ_ERROR_ARG; }
+  *ts = cjIntTuplesInit();
+  if (readerPeek(r) != '[') { return readerTypeError(r, CJ_ERROR_IS_NOT_ARRAY); }
+  ++r->cur;
+
+  const int first = readerPeek(r);
+  if (first == ']') {
+    ++r->cur;
+    ts->arity = defaultArity;
+    return CJ_ERROR_OK;
+  }
+
+  CjIntBuf buf = intBufInit(r->arena);
+  int size = 0;
+  int arity = -1;
+  CjError stat = CJ_ERROR_OK;
+
+#ifdef CJ_SIMD_INTS
+  // Items to parse with the scalar reader before trying the fast path again.
+  int scalarItems = 0;
+#endif
+
+  // 2D case (array of tuples)
+  if (first == '[') {
+    for (;;) {
+      int decoded = 0;
+#ifdef CJ_SIMD_INTS
+      // The first tuple sets the arity for the fast path.
+      if (size > 0 && arity > 0 && --scalarItems < 0) {
+        decoded = simdParseItems(r, arity, &buf);
+        if (decoded < 0) { stat = decoded; break; }
+        size += decoded;
+        scalarItems = decoded ? 0 : 16;
+      }
+#endif
+      if (decoded == 0) {
+        if (readerPeek(r) != '[') { stat = readerTypeError(r, CJ_ERROR_INTTUPLES_ITEM_TYPE); break; }
+        ++r->cur;
+        const int tupleArity = cjIntTuplesParseTuple(r, &buf);
+        if (tupleArity < 0) { stat = tupleArity; break; }
+        if (size > 0 && tupleArity != arity) { stat = CJ_ERROR_INTTUPLES_ITEM_TYPE; break; }
+        arity = tupleArity;
+        ++size;
+      }
+      const int more = readerNextMember(r, ']');
+      if (more < 0) { stat = more; break; }
+      if (!more) { break; }
+    }
+  }
+  // 1D case (array of ints)
+  else if (first == '-' || jsonIsNumeric(first)) {
+    for (;;) {
+      int decoded = 0;
+#ifdef CJ_SIMD_INTS
+      if (--scalarItems < 0) {
+        decoded = simdParseItems(r, arity, &buf);
+        if (decoded < 0) { stat = decoded; break; }
+        size += decoded;
+        scalarItems = decoded ? 0 : 16;
+      }
+#endif
+      if (decoded == 0) {
+        int x;
+        if (!readerInt(r, &x)) { stat = readerTypeError(r, CJ_ERROR_INTTUPLES_ITEM_TYPE); break; }
+        if ((stat = intBufPush(&buf, x)) != CJ_ERROR_OK) { break; }
+        ++size;
+      }
+      const int more = readerNextMember(r, ']');
+      if (more < 0) { stat = more; break; }
+      if (!more) { break; }
+    }
+  }
+  // Error case (eg. array of objects)
+  else {
+    stat = readerTypeError(r, CJ_ERROR_INTTUPLES_ITEM_TYPE);
+  }
+
+  if (stat != CJ_ERROR_OK) {
+    intBufFree(&buf);
+    return stat;
+  }
+  intBufToTuples(&buf, size, arity, ts);
+  return CJ_ERROR_OK;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// cjCsp
+//
+
+static CjError cjCspJsonParseMeta(CjReader* r, CjCsp* csp) {
+  logReader("meta:", r);
+  if (!r || !csp) { return CJ_ERROR_ARG; }
+  if (readerPeek(r) != '{') { return readerTypeError(r, CJ_ERROR_META_IS_NOT_OBJECT); }
+  ++r->cur;
+  if (readerPeek(r) == '}') { return CJ_ERROR_META_IS_NOT_OBJECT; }
+
+  int numFields = 0;
+  for (;;) {
+    const char* key;
+    size_t keyLen;
+    CjError stat = readerKey(r, &key, &keyLen);
+    if (stat != CJ_ERROR_OK) { return stat; }
+    ++numFields;
+
+    logReader("meta-child:", r);
+    if (jsonKeyEq(key, keyLen, "id") || jsonKeyEq(key, keyLen, "algo")) {
+      const int isId = jsonKeyEq(key, keyLen, "id");
+      const char* str;
+      size_t strLen;
+      if (readerPeek(r) != '"') {
+        return readerTypeError(r, isId ? CJ_ERROR_META_ID_NOT_STRING : CJ_ERROR_META_ALGO_NOT_STRING);
+      }
+      if ((stat = readerString(r, &str, &strLen)) != CJ_ERROR_OK) { return stat; }
+      char** out = isId ? &csp->meta.id : &csp->meta.algo;
+      readerFree(r, *out);
+      if ((stat = jsonStrCpy(r, str, strLen, out)) != CJ_ERROR_OK) { return stat; }
+    }
+    else if (jsonKeyEq(key, keyLen, "params")) {
+      // Keep the unparsed JSON text of the value (quotes and braces included).
+      readerSkipWhitespace(r);
+      const char* start = r->cur;
+      if ((stat = readerSkipValue(r, 0)) != CJ_ERROR_OK) { return stat; }
+      readerFree(r, csp->meta.paramsJSON);
+      if ((stat = jsonStrCpy(r, start, r->cur - start, &csp->meta.paramsJSON)) != CJ_ERROR_OK) {
+        return stat;
+      }
+    }
+    else {
+      return CJ_ERROR_META_UNKNOWN_FIELD;
+    }
+
+    int more = readerNextMember(r, '}');
+    if (more < 0) { return more; }
+    if (!more) { break; }
+  }
+
+  if (numFields != 3) { return CJ_ERROR_META_IS_NOT_OBJECT; }
+  return CJ_ERROR_OK;
+}
+
+static CjError cjCspJsonParseDomain(CjReader* r, CjDomain* domain) {
+  logReader("values:", r);
+  if (!r || !domain) { return CJ_ERROR_ARG; }
+  if (readerPeek(r) != '{') { return readerTypeError(r, CJ_ERROR_DOMAIN_IS_NOT_OBJECT); }
+  ++r->cur;
+
+  const char* key;
+  size_t keyLen;
+  if (readerPeek(r) == '}') { return CJ_ERROR_DOMAIN_IS_NOT_OBJECT; }
+  CjError stat = readerKey(r, &key, &keyLen);
+  if (stat != CJ_ERROR_OK) { return stat; }
+  if (jsonKeyEq(key, keyLen, "values")) {
+    if (readerPeek(r) != '[') { return readerTypeError(r, CJ_ERROR_DOMAIN_VALUES_IS_NOT_ARRAY); }
+    const int defaultArity = -1;
+    stat = cjIntTuplesParseReader(defaultArity, r, &domain->values);
+    if (stat != CJ_ERROR_OK) { return stat; }
+    domain->type = CJ_DOMAIN_VALUES;
+  }
+  else if (jsonKeyEq(key, keyLen, "intervals")) {
+    if (readerPeek(r) != '[') { return readerTypeError(r, CJ_ERROR_DOMAIN_INTERVALS_IS_NOT_ARRAY); }
+    const int defaultArity = 2;
+    stat = cjIntTuplesParseReader(defaultArity, r, &domain->intervals);
+    if (stat != CJ_ERROR_OK) { return stat; }
+    domain->type = CJ_DOMAIN_INTERVALS;
+    if (domain->intervals.arity != 2) { return CJ_ERROR_DOMAIN_INTERVALS_IS_NOT_ARRAY; }
+  }
+  else {
+    return CJ_ERROR_DOMAIN_UNKNOWN_TYPE;
+  }
+
+  if (readerPeek(r) == ',') { return CJ_ERROR_DOMAIN_IS_NOT_OBJECT; }
+  return readerExpect(r, '}');
+}
+
+static CjError cjCspJsonParseDomains(CjReader* r, CjCsp* csp) {
+  logReader("domains:", r);
+  if (!r || !csp) { return CJ_ERROR_ARG; }
+  if (readerPeek(r) != '[') { return readerTypeError(r, CJ_ERROR_DOMAINS_IS_NOT_ARRAY); }
+  ++r->cur;
+  if (readerPeek(r) == ']') { ++r->cur; return CJ_ERROR_OK; }
+
+  int capacity = 0;
+  for (;;) {
+    if (csp->domainsSize == capacity) {
+      const int oldCapacity = capacity;
+      capacity = capacity ? 2 * capacity : 4;
+      CjDomain* grown = readerRealloc(
+        r, csp->domains, sizeof(CjDomain) * oldCapacity, sizeof(CjDomain) * capacity);
+      if (!grown) { return CJ_ERROR_NOMEM; }
+      csp->domains = grown;
+    }
+    logReader("domains-child:", r);
+    csp->domains[csp->domainsSize] = cjDomainInit();
+    CjError stat = cjCspJsonParseDomain(r, &csp->domains[csp->domainsSize++]);
+    if (stat != CJ_ERROR_OK) { return stat; }
+
+    int more = readerNextMember(r, ']');
+    if (more < 0) { return more; }
+    if (!more) { return CJ_ERROR_OK; }
+  }
+}
+
+static CjError cjCspJsonParseVars(CjReader* r, CjCsp* csp) {
+  logReader("vars:", r);
+  if (!r || !csp) { return CJ_ERROR_ARG; }
+  if (readerPeek(r) != '[') { return readerTypeError(r, CJ_ERROR_VARS_IS_NOT_ARRAY); }
+
+  const int defaultArity = -1;
+  readerFree(r, csp->vars.data);
+  return cjIntTuplesParseReader(defaultArity, r, &csp->vars);
+}
+
+static CjError cjCspJsonParseNoGoods(CjReader* r, CjConstraintDef* constraintDef) {
+  logReader("noGoods:", r);
+  if (!r || !constraintDef) { return CJ_ERROR_ARG; }
+  if (readerPeek(r) != '[') { return readerTypeError(r, CJ_ERROR_NOGOODS_IS_NOT_ARRAY); }
+
+  const int defaultArity = 0;
+  CjError stat = cjIntTuplesParseReader(defaultArity, r, &constraintDef->noGoods);
+  if (stat != CJ_ERROR_OK) { return stat; }
+  constraintDef->type = CJ_CONSTRAINT_DEF_NO_GOODS;
+  return CJ_ERROR_OK;
+}
+
+static CjError cjCspJsonParseGoods(CjReader* r, CjConstraintDef* constraintDef) {
+  logReader("goods:", r);
+  if (!r || !constraintDef) { return CJ_ERROR_ARG; }
+  if (readerPeek(r) != '[') { return readerTypeError(r, CJ_ERROR_GOODS_IS_NOT_ARRAY); }
+
+  const int defaultArity = 0;
+  CjError stat = cjIntTuplesParseReader(defaultArity, r, &constraintDef->goods);
+  if (stat != CJ_ERROR_OK) { return stat; }
+  constraintDef->type = CJ_CONSTRAINT_DEF_GOODS;
+  return CJ_ERROR_OK;
+}
+
+static CjError cjCspJsonParseConstraintDef(CjReader* r, CjConstraintDef* constraintDef) {
+  logReader("constraintDefs-child:", r);
+  if (readerPeek(r) != '{') { return readerTypeError(r, CJ_CONSTRAINTDEF_UNKNOWN_TYPE); }
+  ++r->cur;
+  if (readerPeek(r) == '}') { return CJ_CONSTRAINTDEF_UNKNOWN_TYPE; }
+
+  const char* key;
+  size_t keyLen;
+  CjError stat = readerKey(r, &key, &keyLen);
+  if (stat != CJ_ERROR_OK) { return stat; }
+  if (jsonKeyEq(key, keyLen, "noGoods")) {
+    stat = cjCspJsonParseNoGoods(r, constraintDef);
+    if (stat != CJ_ERROR_OK) { return stat; }
+  }
+  else if (jsonKeyEq(key, keyLen, "goods")) {
+    stat = cjCspJsonParseGoods(r, constraintDef);
+    if (stat != CJ_ERROR_OK) { return stat; }
+  }
+  else {
+    return CJ_CONSTRAINTDEF_UNKNOWN_TYPE;
+  }
+
+  if (readerPeek(r) == ',') { return CJ_CONSTRAINTDEF_UNKNOWN_TYPE; }
+  return readerExpect(r, '}');
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Parallel constraintDefs
+//
+// The constraintDefs are independent and hold most of the bytes of a big
+// instance. The array is first split into one span of text per def with a
+// bracket counting scan, then the defs are decoded on a pool of threads.
+//
+// Anything unexpected (a syntax error, a def that fails to parse) discards
+// the parallel result, and the array is parsed again serially so that the
+// same error is reported as without threads.
+//
+
+/** Don't bother with threads for less input than this. */
+#define CJ_PARALLEL_MIN_BYTES (1 << 20)
+
+/**
+ * p is at a '{' or '['. Return one past its matching close, or NULL if the
+ * text ends first. Only brackets are counted, the parser checks the rest.
+ */
+static const char* jsonScanValueEnd(const char* p, const char* end) {
+  int depth = 0;
+  while (p < end) {
+#ifdef CJ_SIMD_INTS
+    // Skip 16 bytes at once when they have no string and depth can't reach
+    // 0 in them.
+    if (depth > 0 && end - p >= 16) {
+      const __m128i x = _mm_loadu_si128((const __m128i*) p);
+      if (!_mm_movemask_epi8(_mm_cmpeq_epi8(x, _mm_set1_epi8('"')))) {
+        const __m128i opens = _mm_or_si128(
+          _mm_cmpeq_epi8(x, _mm_set1_epi8('[')), _mm_cmpeq_epi8(x, _mm_set1_epi8('{')));
+        const __m128i closes = _mm_or_si128(
+          _mm_cmpeq_epi8(x, _mm_set1_epi8(']')), _mm_cmpeq_epi8(x, _mm_set1_epi8('}')));
+        // +1 per open, -1 per close, then the running sum over the bytes.
+        __m128i sum = _mm_sub_epi8(closes, opens);
+        sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 1));
+        sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 2));
+        sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 4));
+        sum = _mm_add_epi8(sum, _mm_slli_si128(sum, 8));
+        if (depth > 16 || !_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8((char) (1 - depth)), sum))) {
+          depth += (signed char) (_mm_extract_epi16(sum, 7) >> 8);
+          p += 16;
+          continue;
+        }
+      }
+    }
+#endif
+    const char* blockEnd = end - p > 16 ? p + 16 : end;
+    while (p < blockEnd) {
+      const char c = *p++;
+      if (c == '"') {
+        while (p < end && *p != '"') {
+          if (*p == '\\') { ++p; }
+          ++p;
+        }
+        if (p >= end) { return NULL; }
+        ++p;
+      }
+      else if (c == '{' || c == '[') {
+        ++depth;
+      }
+      else if (c == '}' || c == ']') {
+        if (--depth <= 0) { return p; }
+      }
+    }
+  }
+  return NULL;
+}
+
+/** The text of one constraintDef and the result of parsing it. */
+typedef struct CjDefJob {
+  const char* start;
+  const char* end;
+  CjError stat;
+} CjDefJob;
+
+typedef struct CjDefPool {
+  CjDefJob* jobs;
+  CjConstraintDef* defs;
+  int size;
+  /** The next job to take. */
+  int next;
+  pthread_mutex_t lock;
+} CjDefPool;
+
+/** A thread of the pool, with its own arena if the csp uses one. */
+typedef struct CjDefWorker {
+  CjDefPool* pool;
+  CjArena* arena;
+} CjDefWorker;
+
+static void* defPoolWork(void* arg) {
+  CjDefWorker* worker = (CjDefWorker*) arg;
+  CjDefPool* pool = worker->pool;
+  for (;;) {
+    pthread_mutex_lock(&pool->lock);
+    const int i = pool->next++;
+    pthread_mutex_unlock(&pool->lock);
+    if (i >= pool->size) { return NULL; }
+
+    CjDefJob* job = &pool->jobs[i];
+    CjReader r = readerInit(job->start, job->end - job->start);
+    r.arena = worker->arena;
+    job->stat = cjCspJsonParseConstraintDef(&r, &pool->defs[i]);
+    if (job->stat == CJ_ERROR_OK && r.cur != job->end) { job->stat = CJ_ERROR_JSMN_INVAL; }
+  }
+}
+
+/**
+ * Split the constraintDefs array (r is just past its '[') into jobs.
+ * @return the number of jobs, 0 if the text doesn't split cleanly, or a
+ *         negative CjError.
+ */
+static int defJobsSplit(CjReader* r, CjDefJob** jobs, const char** after) {
+  int size = 0;
+  int capacity = 0;
+  *jobs = NULL;
+  const char* p = r->cur;
+  for (;;) {
+    while (p < r->end && jsonIsWhitespace(*p)) { ++p; }
+    if (p >= r->end || *p != '{') { break; }
+    const char* end = jsonScanValueEnd(p, r->end);
+    if (!end) { break; }
+
+    if (size == capacity) {
+      capacity = capacity ? 2 * capacity : 16;
+      CjDefJob* grown = realloc(*jobs, sizeof(CjDefJob) * capacity);
+      if (!grown) { free(*jobs); *jobs = NULL; return CJ_ERROR_NOMEM; }
+      *jobs = grown;
+    }
+    (*jobs)[size].start = p;
+    (*jobs)[size].end = end;
+    (*jobs)[size].stat = CJ_ERROR_OK;
+    ++size;
+
+    p = end;
+    while (p < r->end && jsonIsWhitespace(*p)) { ++p; }
+    if (p < r->end && *p == ',') { ++p; continue; }
+    if (p < r->end && *p == ']') {
+      *after = p + 1;
+      return size;
+    }
+    break;
+  }
+  free(*jobs);
+  *jobs = NULL;
+  return 0;
+}
+
+/**
+ * Parse the constraintDefs array (r is just past its '[') with numThreads.
+ * @return 1 when done (csp->constraintDefs is set, or a CjError is stored in
+ *         *stat), 0 to leave it to the serial parser.
+ */
+static int cjCspJsonParseConstraintsDefParallel(CjReader* r, int numThreads, CjCsp* csp, CjError* stat) {
+  CjDefJob* jobs;
+  const char* after;
+  const int size = defJobsSplit(r, &jobs, &after);
+  *stat = size < 0 ? size : CJ_ERROR_OK;
+  if (size <= 1) {
+    free(jobs);
+    return size < 0;
+  }
+
+  if (numThreads > size) { numThreads = size; }
+  CjDefPool pool;
+  pool.jobs = jobs;
+  pool.defs = readerRealloc(r, NULL, 0, sizeof(CjConstraintDef) * size);
+  pool.size = size;
+  pool.next = 0;
+  CjDefWorker* workers = calloc(numThreads, sizeof(CjDefWorker));
+  pthread_t* threads = malloc(sizeof(pthread_t) * numThreads);
+  int ok = pool.defs && workers && threads;
+  for (int i = 0; ok && i < numThreads; ++i) {
+    // Threads don't share an arena, theirs are merged into the csp's after.
+    workers[i].pool = &pool;
+    workers[i].arena = r->arena ? cjArenaNew(0) : NULL;
+    if (r->arena && !workers[i].arena) { ok = 0; }
+  }
+  if (!ok) {
+    for (int i = 0; workers && i < numThreads; ++i) { cjArenaFree(&workers[i].arena); }
+    free(workers);
+    free(threads);
+    readerFree(r, pool.defs);
+    free(jobs);
+    *stat = CJ_ERROR_NOMEM;
+    return 1;
+  }
+  for (int i = 0; i < size; ++i) {
+    pool.defs[i] = cjConstraintDefInit();
+  }
+  pthread_mutex_init(&pool.lock, NULL);
+
+  // The calling thread is one of the workers.
+  int started = 0;
+  for (int i = 1; i < numThreads; ++i) {
+    if (pthread_create(&threads[started], NULL, defPoolWork, &workers[i]) == 0) { ++started; }
+  }
+  defPoolWork(&workers[0]);
+  for (int i = 0; i < started; ++i) {
+    pthread_join(threads[i], NULL);
+  }
+  free(threads);
+  pthread_mutex_destroy(&pool.lock);
+
+  for (int i = 0; i < size; ++i) {
+    if (jobs[i].stat == CJ_ERROR_NOMEM) { *stat = CJ_ERROR_NOMEM; }
+    if (jobs[i].stat != CJ_ERROR_OK) { ok = 0; }
+  }
+  free(jobs);
+  for (int i = 0; i < numThreads; ++i) {
+    if (ok) { cjArenaMerge(r->arena, &workers[i].arena); }
+    else { cjArenaFree(&workers[i].arena); }
+  }
+  free(workers);
+  if (!ok) {
+    if (!r->arena) { cjConstraintDefArrayFree(&pool.defs, size); }
+    return *stat == CJ_ERROR_NOMEM;
+  }
+
+  csp->constraintDefs = pool.defs;
+  csp->constraintDefsSize = size;
+  r->cur = after;
+  return 1;
+}
+
+/** The number of threads to use for numThreads = 0. */
+static int cjParseThreadsAuto() {
+  const long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? (int) n : 1;
+}
+
+static CjError cjCspJsonParseConstraintsDef(CjReader* r, const CjParseOptions* options, CjCsp* csp) {
+  logReader("constraintDefs:", r);
+  if (!r || !csp) { return CJ_ERROR_ARG; }
+  if (readerPeek(r) != '[') { return readerTypeError(r, CJ_CONSTRAINTDEFS_IS_NOT_ARRAY); }
+  ++r->cur;
+  if (readerPeek(r) == ']') { ++r->cur; return CJ_ERROR_OK; }
+
+  const int lazy = options->lazyConstraintDefs;
+  const int numThreads = options->numThreads == 0 ? cjParseThreadsAuto() : options->numThreads;
+  if (!lazy && numThreads > 1 && r->end - r->cur >= CJ_PARALLEL_MIN_BYTES) {
+    CjError stat;
+    if (cjCspJsonParseConstraintsDefParallel(r, numThreads, csp, &stat)) { return stat; }
+  }
+
+  int capacity = 0;
+  for (;;) {
+    if (csp->constraintDefsSize == capacity) {
+      const int oldCapacity = capacity;
+      capacity = capacity ? 2 * capacity : 4;
+      CjConstraintDef* grown = readerRealloc(
+        r, csp->constraintDefs, sizeof(CjConstraintDef) * oldCapacity, sizeof(CjConstraintDef) * capacity);
+      if (!grown) { return CJ_ERROR_NOMEM; }
+      csp->constraintDefs = grown;
+    }
+    CjConstraintDef* def = &csp->constraintDefs[csp->constraintDefsSize++];
+    *def = cjConstraintDefInit();
+    const char* end;
+    if (lazy && readerPeek(r) == '{' && (end = jsonScanValueEnd(r->cur, r->end))) {
+      // Only find the end, cjCspConstraintDefGet() decodes it.
+      def->type = CJ_CONSTRAINT_DEF_LAZY;
+      def->lazy.json = r->cur;
+      def->lazy.jsonLen = end - r->cur;
+      r->cur = end;
+    }
+    else {
+      CjError stat = cjCspJsonParseConstraintDef(r, def);
+      if (stat != CJ_ERROR_OK) { return stat; }
+    }
+
+    int more = readerNextMember(r, ']');
+    if (more < 0) { return more; }
+    if (!more) { return CJ_ERROR_OK; }
+  }
+}
+
+static CjError cjCspJsonParseConstraint(CjReader* r, CjConstraint* constraint) {
+  logReader("constraint:", r);
+  if (!r || !constraint) { return CJ_ERROR_ARG; }
+  if (readerPeek(r) != '{') { return readerTypeError(r, CJ_ERROR_CONSTRAINT_IS_NOT_OBJECT); }
+  ++r->cur;
+  if (readerPeek(r) == '}') { ++r->cur; return CJ_ERROR_OK; }
+
+  for (;;) {
+    const char* key;
+    size_t keyLen;
+    CjError stat = readerKey(r, &key, &keyLen);
+    if (stat != CJ_ERROR_OK) { return stat; }
+
+    logReader("constraint-child:", r);
+    if (jsonKeyEq(key, keyLen, "id")) {
+      if (!readerInt(r, &constraint->id)) { return readerTypeError(r, CJ_ERROR_CONSTRAINT_ID_IS_NOT_INT); }
+    }
+    else if (jsonKeyEq(key, keyLen, "vars")) {
+      if (readerPeek(r) != '[') { return readerTypeError(r, CJ_ERROR_CONSTRAINT_VARS_IS_NOT_ARRAY); }
+
+      const int defaultArity = -1;
+      readerFree(r, constraint->vars.data);
+      stat = cjIntTuplesParseReader(defaultArity, r, &constraint->vars);
+      if (stat != CJ_ERROR_OK) { return stat; }
+    }
+    else {
+      return CJ_ERROR_CONSTRAINT_UNKNOWN_FIELD;
+    }
+
+    int more = readerNextMember(r, '}');
+    if (more < 0) { return more; }
+    if (!more) { return CJ_ERROR_OK; }
+  }
+}
+
+static CjError cjCspJsonParseConstraints(CjReader* r, CjCsp* csp) {
+  logReader("constraints:", r);
+  if (!r || !csp) { return CJ_ERROR_ARG; }
+  if (readerPeek(r) != '[') { return readerTypeError(r, CJ_ERROR_CONSTRAINTS_IS_NOT_ARRAY); }
+  ++r->cur;
+  if (readerPeek(r) == ']') { ++r->cur; return CJ_ERROR_OK; }
+
+  int capacity = 0;
+  for (;;) {
+    if (csp->constraintsSize == capacity) {
+      const int oldCapacity = capacity;
+      capacity = capacity ? 2 * capacity : 16;
+      CjConstraint* grown = readerRealloc(
+        r, csp->constraints, sizeof(CjConstraint) * oldCapacity, sizeof(CjConstraint) * capacity);
+      if (!grown) { return CJ_ERROR_NOMEM; }
+      csp->constraints = grown;
+    }
+    csp->constraints[csp->constraintsSize] = cjConstraintInit();
+    CjError stat = cjCspJsonParseConstraint(r, &csp->constraints[csp->constraintsSize++]);
+    if (stat != CJ_ERROR_OK) { return stat; }
+
+    int more = readerNextMember(r, ']');
+    if (more < 0) { return more; }
+    if (!more) { return CJ_ERROR_OK; }
+  }
+}
+
+static CjError cjCspJsonParseTop(CjReader* r, const CjParseOptions* options, CjCsp* csp) {
+  logReader("top:", r);
+  if (!r || !csp) { return CJ_ERROR_ARG; }
+  if (readerPeek(r) != '{') {
+    // A valid JSON value that is not an object, or no JSON at all.
+    CjReader probe = *r;
+    CjError stat = readerSkipValue(&probe, 0);
+    return stat == CJ_ERROR_OK ? CJ_ERROR_CSPJSON_IS_NOT_OBJECT : stat;
+  }
+  ++r->cur;
+  if (readerPeek(r) == '}') { return CJ_ERROR_CSPJSON_BAD_FIELD_COUNT; }
+
+  int numFields = 0;
+  for (;;) {
+    const char* key;
+    size_t keyLen;
+    CjError stat = readerKey(r, &key, &keyLen);
+    if (stat != CJ_ERROR_OK) { return stat; }
+    ++numFields;
+
+    logReader("top-child:", r);
+    if (jsonKeyEq(key, keyLen, "meta")) {
+      stat = cjCspJsonParseMeta(r, csp);
+    }
+    else if (jsonKeyEq(key, keyLen, "domains")) {
+      stat = cjCspJsonParseDomains(r, csp);
+    }
+    else if (jsonKeyEq(key, keyLen, "vars")) {
+      stat = cjCspJsonParseVars(r, csp);
+    }
+    else if (jsonKeyEq(key, keyLen, "constraintDefs")) {
+      stat = cjCspJsonParseConstraintsDef(r, options, csp);
+    }
+    else if (jsonKeyEq(key, keyLen, "constraints")) {
+      stat = cjCspJsonParseConstraints(r, csp);
+    }
+    else {
+      stat = CJ_ERROR_CSPJSON_UNKNOWN_FIELD;
+    }
+    if (stat != CJ_ERROR_OK) { return stat; }
+
+    int more = readerNextMember(r, '}');
+    if (more < 0) { return more; }
+    if (!more) { break; }
+  }
+
+  if (numFields != 5) { return CJ_ERROR_CSPJSON_BAD_FIELD_COUNT; }
+  if (readerPeek(r) != -1) { return CJ_ERROR_JSMN_INVAL; }
+  return CJ_ERROR_OK;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public parsing functions
+//
+
+CjError cjIntTuplesParse(
+  const int defaultArity, const char* json, const size_t jsonLen, CjIntTuples* ts)
+{
+  if (!json || !ts) { return CJ_ERROR_ARG; }
+  if (defaultArity < -1) { return CJ_ERROR_ARG; }
+
+  *ts = cjIntTuplesInit();
+
+  CjReader r = readerInit(json, jsonLen);
+  if (readerPeek(&r) == -1) { return CJ_ERROR_ARG; }
+
+  CjError stat = cjIntTuplesParseReader(defaultArity, &r, ts);
+  if (stat == CJ_ERROR_OK && readerPeek(&r) != -1) {
+    cjIntTuplesFree(ts);
+    stat = CJ_ERROR_JSMN_INVAL;
+  }
+  return stat;
+}
+
+CjParseOptions cjParseOptionsInit() {
+  CjParseOptions x;
+  x.numThreads = 1;
+  x.useArena = 0;
+  x.lazyConstraintDefs = 0;
+  return x;
+}
+
+CjError cjCspJsonParse(const char* json, const size_t jsonLen, CjCsp* csp) {
+  const CjParseOptions options = cjParseOptionsInit();
+  return cjCspJsonParseOpts(json, jsonLen, &options, csp);
+}
+
+CjError cjCspJsonParseOpts(
+  const char* json, const size_t jsonLen, const CjParseOptions* options, CjCsp* csp)
+{
+  if (!json || !options || !csp) { return CJ_ERROR_ARG; }
+  if (options->numThreads < 0) { return CJ_ERROR_ARG; }
+
+  *csp = cjCspInit();
+
+  CjReader r = readerInit(json, jsonLen);
+  if (readerPeek(&r) == -1) { return CJ_ERROR_ARG; }
+
+  if (options->useArena) {
+    csp->arena = cjArenaNew(0);
+    if (!csp->arena) { return CJ_ERROR_NOMEM; }
+    r.arena = csp->arena;
+  }
+  CjError stat = cjCspJsonParseTop(&r, options, csp);
+  if (stat != CJ_ERROR_OK) {
+    cjCspFree(csp);
+  }
+  return stat;
+}
+
+CjError cjCspConstraintDefGet(CjCsp* csp, int i, CjConstraintDef** out) {
+  if (!csp || !out) { return CJ_ERROR_ARG; }
+  if (i < 0 || i >= csp->constraintDefsSize) { return CJ_ERROR_ARG; }
+
+  CjConstraintDef* def = &csp->constraintDefs[i];
+  if (def->type == CJ_CONSTRAINT_DEF_LAZY) {
+    CjReader r = readerInit(def->lazy.json, def->lazy.jsonLen);
+    r.arena = csp->arena;
+    CjConstraintDef decoded = cjConstraintDefInit();
+    CjError stat = cjCspJsonParseConstraintDef(&r, &decoded);
+    if (stat == CJ_ERROR_OK && readerPeek(&r) != -1) { stat = CJ_ERROR_JSMN_INVAL; }
+    if (stat != CJ_ERROR_OK) {
+      if (!csp->arena) { cjConstraintDefFree(&decoded); }
+      return stat;
+    }
+    *def = decoded;
+  }
+  *out = def;
+  return CJ_ERROR_OK;
+}
+
+CjError cjCspConstraintDefsDecode(CjCsp* csp) {
+  if (!csp) { return CJ_ERROR_ARG; }
+  for (int i = 0; i < csp->constraintDefsSize; ++i) {
+    CjConstraintDef* def;
+    CjError stat = cjCspConstraintDefGet(csp, i, &def);
+    if (stat != CJ_ERROR_OK) { return stat; }
+  }
+  return CJ_ERROR_OK;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// json writer
+//
+// Text is formatted into a large buffer that is written out with fwrite()
+// when full, instead of calling fprintf() per number and separator.
+//
+
+#define CJ_WRITER_SIZE (1 << 16)
+/** The most a single int takes, "-2147483648". */
+#define CJ_WRITER_INT_MAX 11
+
+typedef struct CjWriter {
+  FILE* f;
+  /** 1 to leave out the whitespace. */
+  int compact;
+  /** CJ_ERROR_OK, or CJ_ERROR_WRITE once a write failed. */
+  CjError stat;
+  char* buf;
+  size_t len;
+} CjWriter;
+
+static void writerFlush(CjWriter* w) {
+  if (w->len > 0 && w->stat == CJ_ERROR_OK && fwrite(w->buf, 1, w->len, w->f) != w->len) {
+    w->stat = CJ_ERROR_WRITE;
+  }
+  w->len = 0;
+}
+
+/** Return where to write at least n (<= CJ_WRITER_SIZE) bytes. */
+static char* writerReserve(CjWriter* w, size_t n) {
+  if (w->len + n > CJ_WRITER_SIZE) { writerFlush(w); }
+  return w->buf + w->len;
+}
+
+static void writerPut(CjWriter* w, const char* s, size_t n) {
+  if (n > CJ_WRITER_SIZE / 2) {
+    writerFlush(w);
+    if (w->stat == CJ_ERROR_OK && fwrite(s, 1, n, w->f) != n) { w->stat = CJ_ERROR_WRITE; }
+    return;
+  }
+  memcpy(writerReserve(w, n), s, n);
+  w->len += n;
+}
+
+static void writerStr(CjWriter* w, const char* s) {
+  writerPut(w, s, strlen(s));
+}
+
+/** Write pretty, or compact in compact mode. */
+static void writerLayout(CjWriter* w, const char* pretty, const char* compact) {
+  writerStr(w, w->compact ? compact : pretty);
+}
+
+static const char writerDigits[201] =
+  "0001020304050607080910111213141516171819"
+  "2021222324252627282930313233343536373839"
+  "4041424344454647484950515253545556575859"
+  "6061626364656667686970717273747576777879"
+  "8081828384858687888990919293949596979899";
+
+/** Format x at p (two digits at a time) and return the end. */
+static char* writerFormatInt(char* p, int x) {
+  unsigned u = (unsigned) x;
+  if (x < 0) {
+    *p++ = '-';
+    u = 0u - u;
+  }
+  // Instances mostly hold small values.
+  if (u < 10) {
+    *p = (char) ('0' + u);
+    return p + 1;
+  }
+  if (u < 100) {
+    memcpy(p, writerDigits + 2 * u, 2);
+    return p + 2;
+  }
+  if (u < 10000) {
+    const unsigned q = u / 100;
+    const unsigned r = u - q * 100;
+    if (q < 10) {
+      *p = (char) ('0' + q);
+      memcpy(p + 1, writerDigits + 2 * r, 2);
+      return p + 3;
+    }
+    memcpy(p, writerDigits + 2 * q, 2);
+    memcpy(p + 2, writerDigits + 2 * r, 2);
+    return p + 4;
+  }
+  char tmp[CJ_WRITER_INT_MAX];
+  char* t = tmp + sizeof(tmp);
+  while (u >= 100) {
+    const unsigned q = u / 100;
+    t -= 2;
+    memcpy(t, writerDigits + 2 * (u - q * 100), 2);
+    u = q;
+  }
+  if (u >= 10) {
+    t -= 2;
+    memcpy(t, writerDigits + 2 * u, 2);
+  }
+  else {
+    *--t = (char) ('0' + u);
+  }
+  const size_t n = tmp + sizeof(tmp) - t;
+  memcpy(p, t, n);
+  return p + n;
+}
+
+static void writerInt(CjWriter* w, int x) {
+  char* p = writerReserve(w, CJ_WRITER_INT_MAX);
+  w->len = writerFormatInt(p, x) - w->buf;
+}
+
+static void writerIntTuples(CjWriter* w, const CjIntTuples* ts) {
+  const char* sep = w->compact ? "," : ", ";
+  const size_t sepLen = w->compact ? 1 : 2;
+  const int arity = abs(ts->arity);
+  const int* x = ts->data;
+  // Room for a whole item at once if it is small, otherwise int by int.
+  const size_t intRoom = sepLen + CJ_WRITER_INT_MAX;
+  const size_t itemRoom = arity <= 64 ? sepLen + 2 + arity * intRoom : sepLen + 1;
+  writerPut(w, "[", 1);
+  for (int s = 0; s < ts->size; ++s) {
+    char* p = writerReserve(w, itemRoom);
+    if (s > 0) { memcpy(p, sep, sepLen); p += sepLen; }
+    if (ts->arity >= 0) { *p++ = '['; }
+    for (int a = 0; a < arity; ++a) {
+      if (arity > 64) {
+        w->len = p - w->buf;
+        p = writerReserve(w, intRoom + 1);
+      }
+      if (a > 0) { memcpy(p, sep, sepLen); p += sepLen; }
+      p = writerFormatInt(p, *x++);
+    }
+    if (ts->arity >= 0) { *p++ = ']'; }
+    w->len = p - w->buf;
+  }
+  writerPut(w, "]", 1);
+}
+
+/** Write a meta string the way printf("%s") does. */
+static void writerMetaStr(CjWriter* w, const char* s) {
+  writerStr(w, s ? s : "(null)");
+}
+
+static CjError writerCsp(CjWriter* w, CjCsp* csp) {
+  writerLayout(w, "{\n", "{");
+
+  writerLayout(w, "  \"meta\": {\n", "\"meta\":{");
+  writerLayout(w, "    \"id\": \"", "\"id\":\"");
+  writerMetaStr(w, csp->meta.id);
+  writerLayout(w, "\",\n    \"algo\": \"", "\",\"algo\":\"");
+  writerMetaStr(w, csp->meta.algo);
+  writerLayout(w, "\",\n    \"params\": ", "\",\"params\":");
+  writerMetaStr(w, csp->meta.paramsJSON);
+  writerLayout(w, "\n  },\n", "},");
+
+  if (csp->domainsSize == 0) {
+    writerLayout(w, "  \"domains\": [],\n", "\"domains\":[],");
+  } else {
+    writerLayout(w, "  \"domains\": [\n", "\"domains\":[");
+    for (int iDom = 0; iDom < csp->domainsSize; ++iDom) {
+      if (csp->domains[iDom].type == CJ_DOMAIN_VALUES) {
+        writerLayout(w, "    {\"values\": ", "{\"values\":");
+        writerIntTuples(w, &csp->domains[iDom].values);
+        writerPut(w, "}", 1);
+      }
+      else if (csp->domains[iDom].type == CJ_DOMAIN_INTERVALS) {
+        writerLayout(w, "    {\"intervals\": ", "{\"intervals\":");
+        writerIntTuples(w, &csp->domains[iDom].intervals);
+        writerPut(w, "}", 1);
+      }
+      else {
+        return CJ_ERROR_DOMAIN_UNKNOWN_TYPE;
+      }
+      if (iDom != csp->domainsSize - 1) { writerLayout(w, ",\n", ","); }
+      else { writerLayout(w, "\n", ""); }
+    }
+    writerLayout(w, "  ],\n", "],");
+  }
+
+  writerLayout(w, "  \"vars\": ", "\"vars\":");
+  writerIntTuples(w, &csp->vars);
+  writerLayout(w, ",\n", ",");
+
+  if (csp->constraintDefsSize == 0) {
+    writerLayout(w, "  \"constraintDefs\": [],\n", "\"constraintDefs\":[],");
+  }
+  else {
+    writerLayout(w, "  \"constraintDefs\": [\n", "\"constraintDefs\":[");
+    for (int iDef = 0; iDef < csp->constraintDefsSize; ++iDef) {
+      CjConstraintDef* def;
+      CjError stat = cjCspConstraintDefGet(csp, iDef, &def);
+      if (stat != CJ_ERROR_OK) { return stat; }
+      if (def->type == CJ_CONSTRAINT_DEF_NO_GOODS) {
+        writerLayout(w, "    {\"noGoods\": ", "{\"noGoods\":");
+        writerIntTuples(w, &def->noGoods);
+        writerPut(w, "}", 1);
+      }
+      else if (def->type == CJ_CONSTRAINT_DEF_GOODS) {
+        writerLayout(w, "    {\"goods\": ", "{\"goods\":");
+        writerIntTuples(w, &def->goods);
+        writerPut(w, "}", 1);
+      }
+      else {
+        return CJ_CONSTRAINTDEF_UNKNOWN_TYPE;
+      }
+      if (iDef != csp->constraintDefsSize - 1) { writerLayout(w, ",\n", ","); }
+      else { writerLayout(w, "\n", ""); }
+    }
+    writerLayout(w, "  ],\n", "],");
+  }
+
+  if (csp->constraintsSize == 0) {
+    writerLayout(w, "  \"constraints\": []\n", "\"constraints\":[]");
+  }
+  else {
+    writerLayout(w, "  \"constraints\": [\n", "\"constraints\":[");
+    for (int i = 0; i < csp->constraintsSize; ++i) {
+      writerLayout(w, "    {\"id\": ", "{\"id\":");
+      writerInt(w, csp->constraints[i].id);
+      writerLayout(w, ", \"vars\": ", ",\"vars\":");
+      writerIntTuples(w, &csp->constraints[i].vars);
+      writerPut(w, "}", 1);
+      if (i != csp->constraintsSize - 1) { writerLayout(w, ",\n", ","); }
+      else { writerLayout(w, "\n", ""); }
+    }
+    writerLayout(w, "  ]\n", "]");
+  }
+
+  writerPut(w, "}\n", 2);
+  return CJ_ERROR_OK;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Public printing functions
+//
+
+CjError cjIntTuplesJsonPrint(FILE* f, CjIntTuples* ts) {
+  if (!f || !ts) { return CJ_ERROR_ARG; }
+  if (ts->size < 0 || ts->arity < -1) { return CJ_ERROR_ARG; }
+
+  CjWriter w = {f, 0, CJ_ERROR_OK, malloc(CJ_WRITER_SIZE), 0};
+  if (!w.buf) { return CJ_ERROR_NOMEM; }
+  writerIntTuples(&w, ts);
+  writerFlush(&w);
+  free(w.buf);
+  return w.stat;
+}
+
+CjPrintOptions cjPrintOptionsInit() {
+  CjPrintOptions x;
+  x.compact = 0;
+  return x;
+}
+
+CjError cjCspJsonPrint(FILE* f, CjCsp* csp) {
+  const CjPrintOptions options = cjPrintOptionsInit();
+  return cjCspJsonPrintOpts(f, csp, &options);
+}
+
+CjError cjCspJsonPrintOpts(FILE* f, CjCsp* csp, const CjPrintOptions* options) {
+  if (!f || !csp || !options) { return CJ_ERROR_ARG; }
+
+  CjWriter w = {f, options->compact, CJ_ERROR_OK, malloc(CJ_WRITER_SIZE), 0};
+  if (!w.buf) { return CJ_ERROR_NOMEM; }
+  CjError stat = writerCsp(&w, csp);
+  writerFlush(&w);
+  free(w.buf);
+  return stat != CJ_ERROR_OK ? stat : w.stat;
+}
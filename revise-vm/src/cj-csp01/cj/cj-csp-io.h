@@ -0,0 +1,108 @@
+#ifndef __CJ_CSP_IO_H__
+#define __CJ_CSP_IO_H__
+
+#include <stdio.h>
+
+#include "cj-csp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// cjIntTuples Parsing and Printing
+//
+
+/**
+ * Parse into ts which needs to be freed prior to call.
+ * @arg defaultArity specifies the arity to use for an size 0 array
+ *                   where you can infer the arity from the data.
+ *                   Use -1 for 1D, 0+ for 2D.
+ * @return CJ_ERROR_OK on success
+ */
+CjError cjIntTuplesParse(
+  const int defaultArity,
+  const char* json,
+  const size_t jsonLen,
+  CjIntTuples* ts);
+
+/** Print from ts. @return CJ_ERROR_OK on success */
+CjError cjIntTuplesJsonPrint(FILE* f, CjIntTuples* ts);
+
+////////////////////////////////////////////////////////////////////////////////
+// cjCsp Parsing and Printing
+//
+
+/** Options of cjCspJsonParseOpts(). */
+typedef struct CjParseOptions {
+  /**
+   * The number of threads that decode constraintDefs: 1 (the default)
+   * parses on the calling thread only, 0 uses one per online CPU. Small
+   * inputs are always parsed on the calling thread. The solvers and the
+   * tools take it from --threads.
+   */
+  int numThreads;
+  /**
+   * 1 to allocate all of the csp from one arena (see CjCsp.arena): fewer
+   * allocations, the parts of the csp end up close together in memory, and
+   * cjCspFree() releases it at once. 0 to malloc() each part.
+   */
+  int useArena;
+  /**
+   * 1 to only find the text of each constraintDef and leave it as
+   * CJ_CONSTRAINT_DEF_LAZY, decoded by cjCspConstraintDefGet() on first
+   * use. The json buffer must then outlive the csp, and errors inside a
+   * constraintDef are only reported when it is decoded.
+   */
+  int lazyConstraintDefs;
+} CjParseOptions;
+
+/** The default options, also used by cjCspJsonParse(). */
+CjParseOptions cjParseOptionsInit();
+
+/**
+ * @param json does not have to be null terminated.
+ * @param jsonLen specifies the length of the json arg.
+ * @param csp parse into this variable. Needs to be freed prior to call.
+ * @return CJ_ERROR_OK on success
+ * free CjCsp with CjCspFree().
+ * */
+CjError cjCspJsonParse(const char* json, const size_t jsonLen, CjCsp* csp);
+
+/** cjCspJsonParse() with options. */
+CjError cjCspJsonParseOpts(
+  const char* json,
+  const size_t jsonLen,
+  const CjParseOptions* options,
+  CjCsp* csp);
+
+/**
+ * Set *out to csp->constraintDefs[i], decoding it first if it is
+ * CJ_CONSTRAINT_DEF_LAZY. Not thread safe, decode before sharing the csp.
+ * @return CJ_ERROR_OK on success, the def is left lazy on error.
+ */
+CjError cjCspConstraintDefGet(CjCsp* csp, int i, CjConstraintDef** out);
+
+/** Decode every lazy constraintDef. @return CJ_ERROR_OK on success */
+CjError cjCspConstraintDefsDecode(CjCsp* csp);
+
+/** Options of cjCspJsonPrintOpts(). */
+typedef struct CjPrintOptions {
+  /** 1 to leave out all whitespace, 0 to pretty print. */
+  int compact;
+} CjPrintOptions;
+
+/** The default options, also used by cjCspJsonPrint(). */
+CjPrintOptions cjPrintOptionsInit();
+
+/** Lazy constraintDefs are decoded first. return CJ_ERROR_OK on success */
+CjError cjCspJsonPrint(FILE* f, CjCsp* csp);
+
+/** cjCspJsonPrint() with options. */
+CjError cjCspJsonPrintOpts(FILE* f, CjCsp* csp, const CjPrintOptions* options);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // __CJ_CSP_IO_H__
@@ -0,0 +1,476 @@
+#ifndef __CJ_CSP_H__
+#define __CJ_CSP_H__
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Errors
+//
+
+/** Error values are always negative. */
+typedef enum CjError {
+  /** No error. */
+  CJ_ERROR_OK = 0,
+  /** JSON syntax: Not enough tokens were provided (no longer returned). */
+  CJ_ERROR_JSMN_NOMEM = -1,
+  /** JSON syntax: Invalid or unexpected character. */
+  CJ_ERROR_JSMN_INVAL = -2,
+  /** JSON syntax: The string is not a full JSON packet, more bytes expected */
+  CJ_ERROR_JSMN_PART = -3,
+  /** JSON syntax: Unknown error. */
+  CJ_ERROR_JSMN = -4,
+  /** Unknown error. */
+  CJ_ERROR = -5,
+  /** A memory allocation failed. */
+  CJ_ERROR_NOMEM = -6,
+  /** The provided argument is out of range or NULL. */
+  CJ_ERROR_ARG = -7,
+  /** Unknown JSON type encountered. */
+  CJ_ERROR_JSON_TYPE = -8,
+  /** csp-json.meta is not a JSON object type. */
+  CJ_ERROR_META_IS_NOT_OBJECT = -9,
+  /** csp-json.meta.id is not a string type. */
+  CJ_ERROR_META_ID_NOT_STRING = -10,
+  /** csp-json.meta.algo is not a string type. */
+  CJ_ERROR_META_ALGO_NOT_STRING = -11,
+  /** csp-json.meta has a field that is not recognized. */
+  CJ_ERROR_META_UNKNOWN_FIELD = -12,
+  /** csp-json.domains is not an array. */
+  CJ_ERROR_DOMAINS_IS_NOT_ARRAY = -13,
+  /** csp-json.domains[i] is not an object. */
+  CJ_ERROR_DOMAIN_IS_NOT_OBJECT = -14,
+  /** csp-json.domains[i] has an unknown type (eg. "values" and "intervals" keys are known). */
+  CJ_ERROR_DOMAIN_UNKNOWN_TYPE = -15,
+  /** csp-json.domains[i].values is not a JSON array. */
+  CJ_ERROR_DOMAIN_VALUES_IS_NOT_ARRAY = -16,
+  /** csp-json.domains[i].values[j] is not an integer. */
+  CJ_ERROR_DOMAIN_VALUES_IS_NOT_INT = -17,
+  /** csp-json.vars is not an array. */
+  CJ_ERROR_VARS_IS_NOT_ARRAY = -18,
+  /** csp-json.vars[i] int not an int. */
+  CJ_ERROR_VAR_IS_NOT_INT = -19,
+  /** csp-json.constraintDefs is not an array. */
+  CJ_CONSTRAINTDEFS_IS_NOT_ARRAY = -20,
+  /** csp-json.constraintDefs[i] is an unknown type (eg. noGoods and goods are known). */
+  CJ_CONSTRAINTDEF_UNKNOWN_TYPE = -21,
+  /** csp-json.constraintDefs[i].noGoods is not an array. */
+  CJ_ERROR_NOGOODS_IS_NOT_ARRAY = -22,
+  /** csp-json.constraintDefs[i].noGoods[j] is not a tuple. */
+  CJ_ERROR_NOGOODS_ARRAY_HAS_NOT_A_TUPLE = -23,
+  /** csp-json.constraintDefs[i].noGoods[j] has different arity than at j-1. */
+  CJ_ERROR_NOGOODS_ARRAY_DIFFERENT_ARITIES = -24,
+  /** csp-json.constraintDefs[i].noGoods[j][k] is not an integer. */
+  CJ_ERROR_NOGOODS_ARRAY_VALUE_IS_NOT_INT = -25,
+  /** csp-json.constraints is not an array. */
+  CJ_ERROR_CONSTRAINTS_IS_NOT_ARRAY = -26,
+  /** csp-json.constraints[i] is not an object. */
+  CJ_ERROR_CONSTRAINT_IS_NOT_OBJECT = -27,
+  /** csp-json.constraints[i].id is not an integer. */
+  CJ_ERROR_CONSTRAINT_ID_IS_NOT_INT = -28,
+  /** csp-json.constraints[i].vars is not an array. */
+  CJ_ERROR_CONSTRAINT_VARS_IS_NOT_ARRAY = -29,
+  /** csp-json.constraints[i].vars[j] is not an integer. */
+  CJ_ERROR_CONSTRAINT_VAR_IS_NOT_INT = -30,
+  /** csp-json.constraints[i] has an unknown field (eg. "id" key is known). */
+  CJ_ERROR_CONSTRAINT_UNKNOWN_FIELD = -31,
+  /** csp-json (the top-level object) is not an object. */
+  CJ_ERROR_CSPJSON_IS_NOT_OBJECT = -32,
+  /** csp-json (the top-level object) is missing or has extra fields. */
+  CJ_ERROR_CSPJSON_BAD_FIELD_COUNT = -33,
+  /** csp-json (the top-level object) has an unknown field (eg. "meta" is known) */
+  CJ_ERROR_CSPJSON_UNKNOWN_FIELD = -34,
+  /** CjIntTuples[i] is not an array nor integer, or is of inconsistent type. */
+  CJ_ERROR_INTTUPLES_ITEM_TYPE = -35,
+  /** Expected an array, got something else. */
+  CJ_ERROR_IS_NOT_ARRAY = -36,
+  /** Validation failed because of invalid domains.size. */
+  CJ_ERROR_VALIDATION_DOMAINS_SIZE = -37,
+  CJ_ERROR_VALIDATION_DOMAINS_TYPE = -38,
+  CJ_ERROR_VALIDATION_VARS_ARITY = -39,
+  CJ_ERROR_VALIDATION_VARS_SIZE = -40,
+  CJ_ERROR_VALIDATION_VAR_RANGE = -41,
+  CJ_ERROR_VALIDATION_CONSTRAINTDEFS_SIZE = -42,
+  CJ_ERROR_VALIDATION_CONSTRAINTDEF_TYPE = -43,
+  CJ_ERROR_VALIDATION_CONSTRAINTS_SIZE = -44,
+  CJ_ERROR_VALIDATION_CONSTRAINT_ID_RANGE = -45,
+  CJ_ERROR_VALIDATION_CONSTRAINT_VARS_ARITY = -46,
+  CJ_ERROR_VALIDATION_CONSTRAINT_VARS_SIZE = -47,
+  CJ_ERROR_VALIDATION_CONSTRAINT_VAR_RANGE = -48,
+  /** Not a cj-bin file, or a cj-bin version that is not supported. */
+  CJ_ERROR_BIN_MAGIC = -49,
+  /** cj-bin files are little-endian and this host is not. */
+  CJ_ERROR_BIN_BYTE_ORDER = -50,
+  /** A cj-bin size, offset or type is out of range. */
+  CJ_ERROR_BIN_CORRUPT = -51,
+  /** cj-bin data is misaligned (eg. the buffer is not 4-byte aligned). */
+  CJ_ERROR_BIN_ALIGNMENT = -52,
+  /** Writing a cj-bin file failed. */
+  CJ_ERROR_BIN_WRITE = -53,
+  /** Writing CSP-JSON text failed. */
+  CJ_ERROR_WRITE = -54,
+  /** csp-json.domains[i].intervals is not an array of [min, max] integer pairs. */
+  CJ_ERROR_DOMAIN_INTERVALS_IS_NOT_ARRAY = -55,
+  /** Validation failed because intervals are empty, unsorted or overlapping. */
+  CJ_ERROR_VALIDATION_DOMAIN_INTERVALS = -56,
+  /** csp-json.constraintDefs[i].goods is not an array. */
+  CJ_ERROR_GOODS_IS_NOT_ARRAY = -57
+} CjError;
+
+////////////////////////////////////////////////////////////////////////////////
+// CjIntTuples
+//
+// A representation of an array of tuples of ints.
+// Can also represent an array of ints if arity=0.
+//
+
+/**
+ * A 2D array of tuples of integers, or a 1D array of integers.
+ *
+ * 1) 2D: [[1,2], [3,4], [5,6]] has arity =  2, size = 2.
+ * 2) 2D:                  [[]] has arity =  0, size = 1.
+ * 3) 1D:               [1,2,3] has arity = -1, size = 3.
+ */
+typedef struct CjIntTuples {
+  /** The number of tuples */
+  int size;
+  /** The arity of each tuple */
+  int arity;
+  /**
+   * Holds `size * abs(arity)` entries.
+   * If 2D use `data[i*arity + j]` where i in [0, size) and j in [0, arity).
+   * If 1D use `data[i]` where i in [0, size).
+   */
+  int* data;
+} CjIntTuples;
+
+/** Zero/null init a CjIntTuples. */
+CjIntTuples cjIntTuplesInit();
+
+/**
+ * Initialize and allocate a CjIntTuples and return CJ_ERROR_OK on success.
+ * Free the created object with cjIntTuplesFree.
+ * @arg arity is -1 for a 1D array, arity is >= 0 for 2D array.
+ */
+CjError cjIntTuplesAlloc(int size, int arity, CjIntTuples* out);
+
+/** Free a CjIntTuples. */
+void cjIntTuplesFree(CjIntTuples* inout);
+
+/**
+ * Allocate an array of CjIntTuples and cjIntTuplesInit() each item.
+ * @return null on memory allocation error.
+ */
+CjIntTuples* cjIntTuplesArray(int size);
+
+/** (1) free each item (2) free the array (3) set pointer to null. */
+void cjIntTuplesArrayFree(CjIntTuples** inout, int size);
+
+/**
+ * Sort the tuples in increasing lexicographic order and drop the duplicates,
+ * which lowers size (data keeps its allocation). A 1D array is sorted as
+ * tuples of arity 1. Packs each tuple into a 64-bit key and radix sorts the
+ * keys when the value ranges of the columns allow, about linear time.
+ * data needs to be writable, see cjCspSortUniqueConstraintDefs() for a csp.
+ * @return CJ_ERROR_OK on success
+ */
+CjError cjIntTuplesSortUnique(CjIntTuples* inout);
+
+/**
+ * 1 if tuple (arity values) is one of tuples, 0 otherwise, in O(log size).
+ * tuples needs to be sorted, see cjIntTuplesSortUnique().
+ */
+int cjIntTuplesContains(const CjIntTuples* tuples, const int* tuple);
+
+////////////////////////////////////////////////////////////////////////////////
+// CjMeta
+//
+// The CSP-JSON metadata object.
+//
+
+typedef struct CjMeta {
+  char* id;
+  char* algo;
+  /** Unparsed JSON string, since params is generator dependent. */
+  char* paramsJSON;
+} CjMeta;
+
+/** Zero/null init a CjMeta. */
+CjMeta cjMetaInit();
+void cjMetaFree(CjMeta* inout);
+
+////////////////////////////////////////////////////////////////////////////////
+// CjDomain
+//
+// The CSP-JSON Domain object.
+//
+
+/** The Domain of a CSP variable. */
+typedef struct CjDomain {
+  enum {CJ_DOMAIN_UNDEF, CJ_DOMAIN_VALUES, CJ_DOMAIN_INTERVALS, CJ_DOMAIN_SIZE} type;
+  union {
+    /**
+     * Explicitly list the values of the domain, one by one.
+     * This union field is only used if type == CJ_DOMAIN_VALUES.
+     **/
+    CjIntTuples values;
+    /**
+     * List the values of the domain as [min, max] pairs (both inclusive) of
+     * arity 2, in increasing order and without overlaps, eg. [[0, 1023]].
+     * This union field is only used if type == CJ_DOMAIN_INTERVALS.
+     **/
+    CjIntTuples intervals;
+  };
+} CjDomain;
+
+/** Zero/null init a CjDomain. */
+CjDomain cjDomainInit();
+
+/**
+ * Init & allocate a domain using a values definition.
+ * Return 0 on success.
+ * Free the resulting struct with cjDomainFree().
+ */
+CjError cjDomainValuesAlloc(int size, CjDomain* out);
+
+/**
+ * Init & allocate a domain of size intervals.
+ * Return 0 on success.
+ * Free the resulting struct with cjDomainFree().
+ */
+CjError cjDomainIntervalsAlloc(int size, CjDomain* out);
+void cjDomainFree(CjDomain* inout);
+
+/**
+ * Set the smallest and the largest value of a domain.
+ * @return CJ_ERROR_ARG if the domain is empty or of an unknown type.
+ */
+CjError cjDomainBounds(const CjDomain* domain, int* min, int* max);
+
+/**
+ * The number of values of a domain, or -1 if it is of an unknown type.
+ * The intervals are expected to be valid (see cjCspValidate).
+ */
+long long cjDomainCount(const CjDomain* domain);
+
+/**
+ * Allocate an array of CjDomain and cjDomainInit() each item.
+ * @return null on memory allocation error.
+ */
+CjDomain* cjDomainArray(int size);
+
+/** (1) free each item (2) free the array (3) set pointer to null. */
+void cjDomainArrayFree(CjDomain** inout, int size);
+
+////////////////////////////////////////////////////////////////////////////////
+// CjConstraintDef
+
+/** A constraint definition. */
+typedef struct CjConstraintDef {
+  enum {
+    CJ_CONSTRAINT_DEF_UNDEF,
+    CJ_CONSTRAINT_DEF_NO_GOODS,
+    CJ_CONSTRAINT_DEF_GOODS,
+    /** Not decoded yet, see cjCspConstraintDefGet(). */
+    CJ_CONSTRAINT_DEF_LAZY,
+    CJ_CONSTRAINT_DEF_SIZE
+  } type;
+
+  union {
+    /**
+     * List the combination of values that are invalid.
+     * This union field is used only if type == CJ_CONSTRAINT_DEF_NO_GOODS.
+     */
+    CjIntTuples noGoods;
+    /**
+     * List the combination of values that are valid, any other is invalid.
+     * This union field is used only if type == CJ_CONSTRAINT_DEF_GOODS.
+     */
+    CjIntTuples goods;
+    /**
+     * The JSON text of the definition, in the buffer it was parsed from.
+     * This union field is used only if type == CJ_CONSTRAINT_DEF_LAZY.
+     */
+    struct {
+      const char* json;
+      size_t jsonLen;
+    } lazy;
+  };
+} CjConstraintDef;
+
+
+/** Zero/null init a CjConstraintDef. */
+CjConstraintDef cjConstraintDefInit();
+
+/**
+ * Init & allocate a constraint def based on a no-goods definition.
+ * Return 0 on success.
+ * Free the resulting struct with cjConstraintDefFree().
+ */
+CjError cjConstraintDefNoGoodAlloc(int arity, int size, CjConstraintDef* out);
+
+/**
+ * Init & allocate a constraint def based on a goods definition.
+ * Return 0 on success.
+ * Free the resulting struct with cjConstraintDefFree().
+ */
+CjError cjConstraintDefGoodAlloc(int arity, int size, CjConstraintDef* out);
+void cjConstraintDefFree(CjConstraintDef* inout);
+
+/**
+ * Allocate an array of CjConstraintDef and cjConstraintDefInit() each item.
+ * @return null on memory allocaton error.
+ */
+CjConstraintDef* cjConstraintDefArray(int size);
+
+/** (1) free each item (2) free the array (3) set pointer to null. */
+void cjConstraintDefArrayFree(CjConstraintDef** inout, int size);
+
+////////////////////////////////////////////////////////////////////////////////
+// CjConstraint: Instantiating a constraint between variables.
+
+/** A constraint instantiation between variables. */
+typedef struct CjConstraint {
+  /** References an entry in constraintDefs */
+  int id;
+  CjIntTuples vars;
+} CjConstraint;
+
+/** Zero/null init a CjConstraint. */
+CjConstraint cjConstraintInit();
+
+/**
+ * Init & allocate a constraint based on a constraintDef reference id.
+ * Return 0 on success.
+ * Free the resulting struct with cjConstraintDefFree().
+ */
+CjError cjConstraintAlloc(int size, CjConstraint* out);
+void cjConstraintFree(CjConstraint* inout);
+
+/**
+ * Allocate an array of CjConstraintDef and cjConstraintDefInit() each item.
+ * @return null on memory allocation error.
+ */
+CjConstraint* cjConstraintArray(int size);
+
+/** (1) free each item (2) free the array (3) set pointer to null. */
+void cjConstraintArrayFree(CjConstraint** inout, int size);
+
+////////////////////////////////////////////////////////////////////////////////
+// CjArena
+//
+// A bump allocator. Everything allocated from an arena is released at once
+// by cjArenaFree(), never one by one. Allocations are 16-byte aligned.
+//
+
+typedef struct CjArena CjArena;
+
+/**
+ * Create an empty arena.
+ * @arg blockSize the size of the first block, 0 for the default (64 KB).
+ * @return null on memory allocation error.
+ */
+CjArena* cjArenaNew(size_t blockSize);
+
+/** @return null on memory allocation error. */
+void* cjArenaAlloc(CjArena* arena, size_t size);
+
+/**
+ * Resize p (allocated from arena with oldSize bytes) to newSize bytes, like
+ * realloc(). The most recent allocation is resized in place when possible.
+ * @return null on memory allocation error, p is left as is.
+ */
+void* cjArenaRealloc(CjArena* arena, void* p, size_t oldSize, size_t newSize);
+
+/** Move all the memory of *from to into, free *from and set it to null. */
+void cjArenaMerge(CjArena* into, CjArena** from);
+
+/** The number of bytes the arena holds, including unused space. */
+size_t cjArenaCapacity(const CjArena* arena);
+
+/** (1) free all memory of the arena (2) set pointer to null. */
+void cjArenaFree(CjArena** inout);
+
+////////////////////////////////////////////////////////////////////////////////
+// CjCsp
+//
+// The CSP-JSON instance object itself.
+//
+
+typedef struct CjCsp {
+  CjMeta meta;
+
+  int domainsSize;
+  CjDomain* domains;
+
+  /** Each variable references a domain above. Arity is 0. */
+  CjIntTuples vars;
+
+  int constraintDefsSize;
+  CjConstraintDef* constraintDefs;
+
+  int constraintsSize;
+  CjConstraint* constraints;
+
+  /**
+   * Non-null if the meta strings and the CjIntTuples data point into this
+   * caller owned buffer (eg. a mapped cj-bin file, see cjCspBinView()). The
+   * buffer must outlive the csp, and cjCspFree() leaves that memory alone.
+   * Tuples replaced after the view (eg. by cjCspEncodeSmallest()) are
+   * allocated from the arena below.
+   */
+  const void* borrowed;
+
+  /**
+   * Non-null if all of the csp (arrays, strings and CjIntTuples data) is
+   * allocated from this arena, see CjParseOptions.useArena. cjCspFree()
+   * then releases the arena as a whole, so don't free the parts on their
+   * own. Of a borrowed csp, only the tuples that don't point into the
+   * borrowed buffer are in the arena.
+   */
+  CjArena* arena;
+} CjCsp;
+
+/**
+ * Zero/null Init a cjCsp.
+ * Free the resulting struct with cjCspFree().
+ */
+CjCsp cjCspInit();
+void cjCspFree(CjCsp* inout);
+
+/**
+ * @return CJ_ERROR_OK only if the CSP instance is valid.
+ * Eg. check that the indexes in vars are valid in domains.
+ */
+CjError cjCspValidate(const CjCsp* csp);
+
+/**
+ * cjIntTuplesSortUnique() the tuples of each constraintDef, which can then
+ * be searched with cjIntTuplesContains(). The tuples of a borrowed csp are
+ * copied to its arena first.
+ * csp needs its constraintDefs decoded (see cjCspConstraintDefsDecode()).
+ * @return CJ_ERROR_OK on success
+ */
+CjError cjCspSortUniqueConstraintDefs(CjCsp* csp);
+
+/**
+ * Merge the constraintDefs of the same type and the same tuples (in any
+ * order) into the first of them: the constraints of the others are moved
+ * to it, and the others are dropped from constraintDefs. Defs are found by
+ * a hash of their tuples, so this is about linear in the size of the defs.
+ * csp needs to be valid (see cjCspValidate()) with its constraintDefs
+ * decoded (see cjCspConstraintDefsDecode()).
+ * Backends then build one table per distinct def.
+ * @param numMerged if not null, set to the number of defs dropped.
+ * @return CJ_ERROR_OK on success
+ */
+CjError cjCspDedupConstraintDefs(CjCsp* csp, int* numMerged);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // __CJ_CSP_H__
@@ -0,0 +1,149 @@
+#ifndef __CSP01_KERNELS_H__
+#define __CSP01_KERNELS_H__
+
+// The block kernels of the revise: the test-zero of the AND of a support
+// row and a domain, and the OR of a row into a union, B words at a time.
+//
+// Without an ISA flag they are plain loops over the B words. With one, a
+// block goes by the widest vector of the ISA that divides it and the
+// narrower ones after that, so every B (and so every domain size) has a
+// correct path, down to the scalar loop for B = 1:
+//
+//   CJ_NEON    128 bits (ARM).
+//   CJ_SSE42   128 bits, PTEST.
+//   CJ_AVX2    256 bits, VPTEST, then SSE4.2.
+//   CJ_AVX512  512 bits, VPTESTMQ, then AVX2 and SSE4.2.
+//
+// The code that uses the x86 ones needs to be compiled for the ISA, see
+// solve-kernel.cpp. Each kernel (and CJ_REVISE_1BIT, see Solver) has its
+// own inline namespace, CSP01_KERNEL, so that one binary can link the
+// solvers of all of them.
+
+#include <stdint.h>
+
+#if defined(CJ_NEON)
+#include <arm_neon.h>
+#elif defined(CJ_AVX512) || defined(CJ_AVX2) || defined(CJ_SSE42)
+#include <immintrin.h>
+#endif
+
+// The widest x86 vector of the ISA in bits, and the names of the kernel.
+#if defined(CJ_REVISE_1BIT)
+#define CSP01_X86_BITS 0
+#define CSP01_KERNEL kernel1Bit
+#define CSP01_SOLVE solve1Bit
+#elif defined(CJ_NEON)
+#define CSP01_X86_BITS 0
+#define CSP01_KERNEL kernelNeon
+#define CSP01_SOLVE solveNeon
+#elif defined(CJ_AVX512)
+#define CSP01_X86_BITS 512
+#define CSP01_KERNEL kernelAvx512
+#define CSP01_SOLVE solveAvx512
+#elif defined(CJ_AVX2)
+#define CSP01_X86_BITS 256
+#define CSP01_KERNEL kernelAvx2
+#define CSP01_SOLVE solveAvx2
+#elif defined(CJ_SSE42)
+#define CSP01_X86_BITS 128
+#define CSP01_KERNEL kernelSse42
+#define CSP01_SOLVE solveSse42
+#else
+#define CSP01_X86_BITS 0
+#define CSP01_KERNEL kernelScalar
+#define CSP01_SOLVE solveScalar
+#endif
+
+namespace csp01 {
+inline namespace CSP01_KERNEL {
+
+/** true if the B words of a and b have a bit in common. */
+template <int B>
+inline bool intersectsBlock(const uint64_t* a, const uint64_t* b) {
+#ifdef CJ_NEON
+  if (B % 2 == 0) {
+    uint64x2_t acc = vdupq_n_u64(0);
+    for (int k = 0; k < B; k += 2) {
+      acc = vorrq_u64(acc, vandq_u64(vld1q_u64(a + k), vld1q_u64(b + k)));
+    }
+    return (vgetq_lane_u64(acc, 0) | vgetq_lane_u64(acc, 1)) != 0;
+  }
+#endif
+#if CSP01_X86_BITS >= 512
+  if (B % 8 == 0) {
+    __mmask8 any = 0;
+    for (int k = 0; k < B; k += 8) {
+      any |= _mm512_test_epi64_mask(_mm512_loadu_si512(a + k), _mm512_loadu_si512(b + k));
+    }
+    return any != 0;
+  }
+#endif
+#if CSP01_X86_BITS >= 256
+  if (B % 4 == 0) {
+    __m256i acc = _mm256_setzero_si256();
+    for (int k = 0; k < B; k += 4) {
+      acc = _mm256_or_si256(acc, _mm256_and_si256(
+        _mm256_loadu_si256((const __m256i*) (a + k)), _mm256_loadu_si256((const __m256i*) (b + k))));
+    }
+    return !_mm256_testz_si256(acc, acc);
+  }
+#endif
+#if CSP01_X86_BITS >= 128
+  if (B % 2 == 0) {
+    __m128i acc = _mm_setzero_si128();
+    for (int k = 0; k < B; k += 2) {
+      acc = _mm_or_si128(acc, _mm_and_si128(
+        _mm_loadu_si128((const __m128i*) (a + k)), _mm_loadu_si128((const __m128i*) (b + k))));
+    }
+    return !_mm_testz_si128(acc, acc);
+  }
+#endif
+  uint64_t any = 0;
+  for (int k = 0; k < B; ++k) { any |= a[k] & b[k]; }
+  return any != 0;
+}
+
+/** acc |= row, over B words. */
+template <int B>
+inline void orBlock(uint64_t* acc, const uint64_t* row) {
+#ifdef CJ_NEON
+  if (B % 2 == 0) {
+    for (int k = 0; k < B; k += 2) {
+      vst1q_u64(acc + k, vorrq_u64(vld1q_u64(acc + k), vld1q_u64(row + k)));
+    }
+    return;
+  }
+#endif
+#if CSP01_X86_BITS >= 512
+  if (B % 8 == 0) {
+    for (int k = 0; k < B; k += 8) {
+      _mm512_storeu_si512(acc + k, _mm512_or_si512(_mm512_loadu_si512(acc + k), _mm512_loadu_si512(row + k)));
+    }
+    return;
+  }
+#endif
+#if CSP01_X86_BITS >= 256
+  if (B % 4 == 0) {
+    for (int k = 0; k < B; k += 4) {
+      _mm256_storeu_si256((__m256i*) (acc + k), _mm256_or_si256(
+        _mm256_loadu_si256((const __m256i*) (acc + k)), _mm256_loadu_si256((const __m256i*) (row + k))));
+    }
+    return;
+  }
+#endif
+#if CSP01_X86_BITS >= 128
+  if (B % 2 == 0) {
+    for (int k = 0; k < B; k += 2) {
+      _mm_storeu_si128((__m128i*) (acc + k), _mm_or_si128(
+        _mm_loadu_si128((const __m128i*) (acc + k)), _mm_loadu_si128((const __m128i*) (row + k))));
+    }
+    return;
+  }
+#endif
+  for (int k = 0; k < B; ++k) { acc[k] |= row[k]; }
+}
+
+} // inline namespace CSP01_KERNEL
+} // namespace csp01
+
+#endif // __CSP01_KERNELS_H__
@@ -0,0 +1,154 @@
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cj/cj-csp.h"
+#include "cj/cj-csp-bin.h"
+#include "cj/cj.hpp"
+#include "io.h"
+#include "model.h"
+#include "solve.h"
+
+void printUsage() {
+  fprintf(stderr, "Usage: cj-solve-csp01 [--revise auto|generic] [-e BITS] [--kernel NAME] [--block-bits BITS]\n");
+  fprintf(stderr, "                      [--threads N] --csp INSTANCE_FILENAME|-\n");
+  fprintf(stderr, "  --revise      auto picks a revise program per constraint (default), generic\n");
+  fprintf(stderr, "                runs the same residue scan for all of them.\n");
+  fprintf(stderr, "  -e            with auto, replace the scans by unions of the supports looked up\n");
+  fprintf(stderr, "                BITS (1 to %d) values at a time, from tables of 2^BITS entries\n", csp01::LUT_MAX_BITS);
+  fprintf(stderr, "                per chunk of values (up to %zu MiB of them).\n", csp01::LUT_MAX_BYTES >> 20);
+  fprintf(stderr, "  --kernel      scalar, 1bit, sse42, avx2, avx512 or neon, the widest vectors\n");
+  fprintf(stderr, "                of the CPU by default.\n");
+  fprintf(stderr, "  --block-bits  revise 64, 128, 256, 512 or 1024 bits at a time, by default\n");
+  fprintf(stderr, "                the bits of the largest domain rounded up.\n");
+  fprintf(stderr, "  --threads     the threads that parse the constraintDefs, 1 by default, 0 for\n");
+  fprintf(stderr, "                one per CPU.\n");
+}
+
+int main(int argc, char** argv) {
+  int err = 0;
+  const char* cspInstanceFilename = NULL;
+  csp01::BuildOptions options;
+  options.blockWords = 0;
+  csp01::Kernel kernel = csp01::bestKernel();
+  CjParseOptions parseOptions = cjParseOptionsInit();
+  for (int i = 1; i < argc; ++i) {
+    if (strcmp(argv[i], "--csp") == 0 && i + 1 < argc) {
+      cspInstanceFilename = argv[++i];
+    }
+    else if (strcmp(argv[i], "--revise") == 0 && i + 1 < argc && strcmp(argv[i + 1], "auto") == 0) {
+      options.policy = csp01::REVISE_AUTO;
+      ++i;
+    }
+    else if (strcmp(argv[i], "--revise") == 0 && i + 1 < argc && strcmp(argv[i + 1], "generic") == 0) {
+      options.policy = csp01::REVISE_GENERIC;
+      ++i;
+    }
+    else if (strcmp(argv[i], "-e") == 0 && i + 1 < argc) {
+      options.lutBits = atoi(argv[++i]);
+      if (options.lutBits < 1 || options.lutBits > csp01::LUT_MAX_BITS) {
+        fprintf(stderr, "ERROR: -e takes 1 to %d bits.\n\n", csp01::LUT_MAX_BITS);
+        printUsage();
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--kernel") == 0 && i + 1 < argc) {
+      if (!csp01::kernelByName(argv[++i], kernel)) {
+        fprintf(stderr, "ERROR: unknown kernel '%s'.\n\n", argv[i]);
+        printUsage();
+        return 1;
+      }
+      if (!csp01::kernelRuns(kernel)) {
+        fprintf(stderr, "ERROR: the %s kernel does not run on this CPU.\n", argv[i]);
+        return 1;
+      }
+    }
+    else if (strcmp(argv[i], "--block-bits") == 0 && i + 1 < argc) {
+      const int bits = atoi(argv[++i]);
+      if (bits < 64 || bits > 64 * csp01::MAX_BLOCK_WORDS || bits % 64 || ((bits / 64) & (bits / 64 - 1))) {
+        fprintf(stderr, "ERROR: --block-bits takes 64, 128, 256, 512 or 1024.\n\n");
+        printUsage();
+        return 1;
+      }
+      options.blockWords = bits / 64;
+    }
+    else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      if ((parseOptions.numThreads = atoi(argv[++i])) < 0) {
+        fprintf(stderr, "ERROR: --threads takes 0 or more.\n\n");
+        printUsage();
+        return 1;
+      }
+    }
+    else {
+      fprintf(stderr, "ERROR: unknown command line parameter '%s'.\n\n", argv[i]);
+      printUsage();
+      return 1;
+    }
+  }
+  if (!cspInstanceFilename) {
+    fprintf(stderr, "ERROR: missing --csp flag.\n\n");
+    printUsage();
+    return 1;
+  }
+
+  // The file goes after the csp, which may point into it.
+  ScopedLoadedFile cspInstanceFile;
+  if (0 != (err = loadAll(cspInstanceFilename, &cspInstanceFile))) {
+    fprintf(stderr, "ERROR(%d): failed to read csp instance file.", err);
+    return 1;
+  }
+
+  cj::Csp csp;
+  if (CJ_ERROR_OK != (err = csp.parse(cspInstanceFile.contents, cspInstanceFile.len, parseOptions))) {
+    fprintf(stderr, "ERROR(%d): failed to parse csp instance file.", err);
+    return 1;
+  }
+  // A CSP-JSON csp holds its own copy of everything it needs, a cj-bin one
+  // points into the file.
+  if (!csp.borrowed()) {
+    unloadAll(&cspInstanceFile);
+  }
+
+  if (CJ_ERROR_OK != (err = cjCspValidate(csp.get()))) {
+    fprintf(stderr, "ERROR(%d): failed to validate the csp instance.", err);
+    return 1;
+  }
+
+  // Instances often repeat the same table, build each once.
+  if (CJ_ERROR_OK != (err = cjCspDedupConstraintDefs(csp.get(), NULL))) {
+    fprintf(stderr, "ERROR(%d): failed to merge the constraint definitions.", err);
+    return 1;
+  }
+
+  auto startTime = std::chrono::high_resolution_clock::now();
+
+  csp01::Model model;
+  if (CJ_ERROR_OK != (err = model.build(csp.get(), options))) {
+    fprintf(stderr, "ERROR(%d): failed to compile the csp instance (binary constraints only).", err);
+    return 1;
+  }
+  std::vector<int> solution;
+  csp01::Stats stats;
+  const bool solved = csp01::solve(kernel, model, solution, stats);
+
+  auto endTime = std::chrono::high_resolution_clock::now();
+  auto timeMs = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count();
+
+  printf("{\"solution\": ");
+  if (solved) {
+    printf("[");
+    for (int iVar = 0; iVar < model.numVars; ++iVar) {
+      if (iVar > 0) { printf(","); }
+      printf("%d", solution[iVar]);
+    }
+    printf("]");
+  }
+  else {
+    printf("null");
+  }
+  printf(", \"timeMs\": %lld, \"nodes\": %lld, \"fails\": %lld, \"depthMax\": %d, \"revisions\": %lld, \"tableBytes\": %zu, \"lutBits\": %d, \"lutBytes\": %zu, \"kernel\": \"%s\", \"blockBits\": %d}\n",
+    (long long) timeMs, stats.nodes, stats.fails, stats.depthMax, stats.revisions, model.tableBytes(),
+    model.lutBits(), model.lutBytes(), csp01::kernelName(kernel), model.blockWords * 64);
+  return 0;
+}
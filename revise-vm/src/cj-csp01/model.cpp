@@ -0,0 +1,196 @@
+#include <algorithm>
+
+#include "cj/cj-csp-index.h"
+#include "model.h"
+
+namespace csp01 {
+
+/** Set the first n bits of words. */
+static void setPrefix(uint64_t* words, int n) {
+  for (int i = 0; i < n / 64; ++i) { words[i] = ~(uint64_t) 0; }
+  if (n % 64) { words[n / 64] = ((uint64_t) 1 << (n % 64)) - 1; }
+}
+
+static void setBit(uint64_t* words, int i) { words[i / 64] |= (uint64_t) 1 << (i % 64); }
+static void clearBit(uint64_t* words, int i) { words[i / 64] &= ~((uint64_t) 1 << (i % 64)); }
+
+/**
+ * The values of a variable allowed by def on it alone: a unary def, or a
+ * binary one on the same variable twice (its pairs (i, i)).
+ */
+static void unaryMask(const CjDenseDef& def, int size, std::vector<uint64_t>& mask) {
+  const bool goods = def.type == CjConstraintDef::CJ_CONSTRAINT_DEF_GOODS;
+  std::fill(mask.begin(), mask.end(), 0);
+  if (!goods) { setPrefix(mask.data(), size); }
+  const int arity = def.tuples.arity;
+  for (int t = 0; t < def.tuples.size; ++t) {
+    const int i = cjDenseTuplesGet(&def.tuples, (size_t) t * arity);
+    if (arity == 2 && cjDenseTuplesGet(&def.tuples, (size_t) t * arity + 1) != i) { continue; }
+    if (goods) { setBit(mask.data(), i); } else { clearBit(mask.data(), i); }
+  }
+}
+
+/** The CjCspIndex of a build, freed with it. */
+struct ScopedIndex {
+  CjCspIndex index = cjCspIndexInit();
+  ~ScopedIndex() { cjCspIndexFree(&index); }
+};
+
+static Table compileTable(const CjDenseDef& def, int xSize, int ySize, int words) {
+  const bool goods = def.type == CjConstraintDef::CJ_CONSTRAINT_DEF_GOODS;
+  Table t;
+  t.xSize = xSize;
+  t.ySize = ySize;
+  t.rows.assign((size_t) xSize * words, 0);
+  t.cols.assign((size_t) ySize * words, 0);
+  if (!goods) {
+    for (int i = 0; i < xSize; ++i) { setPrefix(&t.rows[(size_t) i * words], ySize); }
+    for (int j = 0; j < ySize; ++j) { setPrefix(&t.cols[(size_t) j * words], xSize); }
+  }
+  for (int k = 0; k < def.tuples.size; ++k) {
+    const int i = cjDenseTuplesGet(&def.tuples, (size_t) k * 2);
+    const int j = cjDenseTuplesGet(&def.tuples, (size_t) k * 2 + 1);
+    if (goods) {
+      setBit(&t.rows[(size_t) i * words], j);
+      setBit(&t.cols[(size_t) j * words], i);
+    }
+    else {
+      clearBit(&t.rows[(size_t) i * words], j);
+      clearBit(&t.cols[(size_t) j * words], i);
+    }
+  }
+  return t;
+}
+
+CjError Model::build(const CjCsp* csp, const BuildOptions& options) {
+  CjError err = CJ_ERROR_OK;
+  const int lutBits = options.policy == REVISE_AUTO ? options.lutBits : 0;
+  if (lutBits < 0 || lutBits > LUT_MAX_BITS) { return CJ_ERROR_ARG; }
+  blockWords = options.blockWords;
+  if (blockWords < 0 || blockWords > MAX_BLOCK_WORDS || (blockWords & (blockWords - 1))) { return CJ_ERROR_ARG; }
+  cjDenseFree(&dense);
+  if (CJ_ERROR_OK != (err = cjDenseAlloc(csp, &dense))) { return err; }
+  numVars = dense.varsSize;
+
+  // Domains
+  int maxSize = 1;
+  for (int d = 0; d < dense.domainsSize; ++d) {
+    if (dense.domains[d].size > MAX_VALUES) { return CJ_ERROR_ARG; }
+    if (dense.domains[d].size > maxSize) { maxSize = dense.domains[d].size; }
+  }
+  words = (maxSize + 63) / 64;
+  if (blockWords == 0) {
+    for (blockWords = 1; blockWords < words && blockWords < MAX_BLOCK_WORDS; blockWords *= 2) {}
+  }
+  words = (words + blockWords - 1) / blockWords * blockWords;
+  domains.assign((size_t) numVars * words, 0);
+  for (int v = 0; v < numVars; ++v) {
+    setPrefix(&domains[(size_t) v * words], dense.domains[dense.vars[v]].size);
+  }
+
+  ScopedIndex scoped;
+  const CjCspIndex& index = scoped.index;
+  if (CJ_ERROR_OK != (err = cjCspIndexAlloc(csp, &scoped.index))) { return err; }
+
+  // Constraints: one table per dense def, built for the first constraint
+  // that uses it, and an arc each way, at arcsOf[c] (x revised against y)
+  // and arcsOf[c] + 1. The unary ones go into the domains.
+  std::vector<int> tableOf(dense.defsSize, -1);
+  std::vector<int> programOf;
+  size_t lutBytesUsed = 0;
+  std::vector<Arc> unsorted;
+  std::vector<int> arcsOf(index.constraintsSize, -1);
+  std::vector<uint64_t> mask(words);
+  tables.clear();
+  tables.reserve(dense.defsSize);
+  code.clear();
+  for (int c = 0; c < index.constraintsSize; ++c) {
+    const int arity = cjCspIndexArity(&index, c);
+    const int* scope = index.varData + index.varOffsets[c];
+    const CjDenseDef& def = dense.defs[dense.constraintDefs[c]];
+    if (arity < 1 || arity > 2) { return CJ_ERROR_ARG; }
+    if (def.tuples.size > 0 && def.tuples.arity != arity) { return CJ_ERROR_ARG; }
+    const int x = scope[0];
+    const int y = scope[arity - 1];
+    const int xSize = dense.domains[dense.vars[x]].size;
+    if (x == y) {
+      unaryMask(def, xSize, mask);
+      for (int k = 0; k < words; ++k) { domains[(size_t) x * words + k] &= mask[k]; }
+      continue;
+    }
+
+    int& t = tableOf[dense.constraintDefs[c]];
+    if (t < 0) {
+      const int ySize = dense.domains[dense.vars[y]].size;
+      t = (int) tables.size();
+      tables.push_back(compileTable(def, xSize, ySize, words));
+      Table& table = tables[t];
+      // The revise of x looks up the supports of the values of y, the cols.
+      const int xProgram = compileRevise(
+        table.rows.data(), xSize, ySize, words, blockWords, lutBits, LUT_MAX_BYTES - lutBytesUsed,
+        options.policy, code);
+      if (programUsesLut(code, xProgram)) {
+        compileLut(table.cols.data(), ySize, words, lutBits, table.colsLut);
+        lutBytesUsed += table.colsLut.entries.size() * sizeof(uint64_t);
+      }
+      const int yProgram = compileRevise(
+        table.cols.data(), ySize, xSize, words, blockWords, lutBits, LUT_MAX_BYTES - lutBytesUsed,
+        options.policy, code);
+      if (programUsesLut(code, yProgram)) {
+        compileLut(table.rows.data(), xSize, words, lutBits, table.rowsLut);
+        lutBytesUsed += table.rowsLut.entries.size() * sizeof(uint64_t);
+      }
+      programOf.push_back(xProgram);
+      programOf.push_back(yProgram);
+    }
+    const Table& table = tables[t];
+    const Lut* rowsLut = table.rowsLut.entries.empty() ? nullptr : &table.rowsLut;
+    const Lut* colsLut = table.colsLut.entries.empty() ? nullptr : &table.colsLut;
+    arcsOf[c] = (int) unsorted.size();
+    unsorted.push_back(Arc{x, y, table.rows.data(), table.cols.data(), colsLut, programOf[2 * t], 0});
+    unsorted.push_back(Arc{y, x, table.cols.data(), table.rows.data(), rowsLut, programOf[2 * t + 1], 0});
+  }
+
+  // Order the arcs by y, from the constraints on each variable: y is the
+  // second variable of the first arc of a constraint, the first of the other.
+  arcOffsets.assign(numVars + 1, 0);
+  arcs.clear();
+  arcs.reserve(unsorted.size());
+  numResidues = 0;
+  for (int y = 0; y < numVars; ++y) {
+    for (int i = index.adjOffsets[y]; i < index.adjOffsets[y + 1]; ++i) {
+      const int c = index.adjData[i];
+      if (arcsOf[c] < 0) { continue; }
+      const Arc& arc = unsorted[arcsOf[c] + (unsorted[arcsOf[c]].y == y ? 0 : 1)];
+      arcs.push_back(arc);
+      arcs.back().residues = numResidues;
+      numResidues += dense.domains[dense.vars[arc.x]].size;
+    }
+    arcOffsets[y + 1] = (int) arcs.size();
+  }
+  return CJ_ERROR_OK;
+}
+
+size_t Model::tableBytes() const {
+  size_t bytes = 0;
+  for (const Table& t : tables) { bytes += (t.rows.size() + t.cols.size()) * sizeof(uint64_t); }
+  return bytes;
+}
+
+size_t Model::lutBytes() const {
+  size_t bytes = 0;
+  for (const Table& t : tables) {
+    bytes += (t.rowsLut.entries.size() + t.colsLut.entries.size()) * sizeof(uint64_t);
+  }
+  return bytes;
+}
+
+int Model::lutBits() const {
+  for (const Table& t : tables) {
+    if (!t.rowsLut.entries.empty()) { return t.rowsLut.bits; }
+    if (!t.colsLut.entries.empty()) { return t.colsLut.bits; }
+  }
+  return 0;
+}
+
+} // namespace csp01
@@ -0,0 +1,121 @@
+#ifndef __CSP01_MODEL_H__
+#define __CSP01_MODEL_H__
+
+// The binary csp of the native solver, compiled for bit-parallel revise.
+//
+// The values of each variable are replaced by their dense index (see
+// CjDense) and a domain is a bitset of `words` uint64 words, bit i for
+// index i. For each binary constraintDef (and combination of domains) a
+// Table holds the supports of every value of either variable as a bitset
+// over the values of the other, so that a value keeps a support in a
+// domain iff the AND of its row and the domain is not zero.
+
+#include <stdint.h>
+#include <vector>
+
+#include "cj/cj-csp.h"
+#include "cj/cj-csp-dense.h"
+#include "revise.h"
+
+namespace csp01 {
+
+/** The largest domain the tables are built for, d * d bits each. */
+const int MAX_VALUES = 1 << 16;
+
+/** The largest block of the solvers (see solve.h), 1024 bits. */
+const int MAX_BLOCK_WORDS = 16;
+
+struct Table {
+  int xSize;
+  int ySize;
+  /** xSize rows of words, row i the supports of x = i among the values of y. */
+  std::vector<uint64_t> rows;
+  /** ySize rows of words, row j the supports of y = j among the values of x. */
+  std::vector<uint64_t> cols;
+  /** The Luts of the rows and of the cols, empty unless a program uses them. */
+  Lut rowsLut;
+  Lut colsLut;
+};
+
+/**
+ * Revise of the domain of x against that of y: value i of x is kept iff
+ * supports[i * words ...] intersects the domain of y.
+ */
+struct Arc {
+  int x;
+  int y;
+  /** The rows (or cols) of a Table, for the values of x. */
+  const uint64_t* supports;
+  /** The other half of the Table, for the values of y. */
+  const uint64_t* inverse;
+  /** The Lut of inverse, or null. */
+  const Lut* inverseLut;
+  /** The offset of the revise program in Model::code. */
+  int program;
+  /** The first of the residues of the values of x, see Solver. */
+  int residues;
+};
+
+struct BuildOptions {
+  /**
+   * Domains take a multiple of blockWords words, a power of two up to
+   * MAX_BLOCK_WORDS. 0 picks the words of the largest domain, rounded up.
+   */
+  int blockWords = 1;
+  RevisePolicy policy = REVISE_AUTO;
+  /** The bits of the chunks of the Luts (see Lut), 0 for none. */
+  int lutBits = 0;
+};
+
+class Model {
+public:
+  Model() : numVars(0), words(0), blockWords(1), numResidues(0), dense(cjDenseInit()) {}
+  ~Model() { cjDenseFree(&dense); }
+  Model(const Model&) = delete;
+  Model& operator=(const Model&) = delete;
+
+  /**
+   * Compile csp, which needs to be valid with its constraintDefs decoded.
+   * Domains take a multiple of blockWords words so that the revise loops
+   * can work a block at a time.
+   * @return CJ_ERROR_OK on success, CJ_ERROR_ARG if a constraint has more
+   *   than 2 variables or a domain more than MAX_VALUES values, or if
+   *   options has a lutBits more than LUT_MAX_BITS or a blockWords that
+   *   is not 0 or a power of two up to MAX_BLOCK_WORDS.
+   */
+  CjError build(const CjCsp* csp, const BuildOptions& options);
+
+  /** The value of index of variable var. */
+  int value(int var, int index) const { return cjDenseValue(&dense, var, index); }
+
+  int numVars;
+  /** The words of a domain, a multiple of blockWords. */
+  int words;
+  /** The words the revise works on at a time, see BuildOptions. */
+  int blockWords;
+  /** numVars domains of words each, after the unary constraints. */
+  std::vector<uint64_t> domains;
+  /**
+   * numVars + 1 entries, the arcs to revise when the domain of y changes are
+   * arcs[arcOffsets[y]] to arcs[arcOffsets[y + 1] - 1].
+   */
+  std::vector<int> arcOffsets;
+  std::vector<Arc> arcs;
+  /** The sum of the domain sizes of the x of the arcs. */
+  int numResidues;
+  std::vector<Table> tables;
+  /** The revise programs of the arcs, one per table and direction. */
+  std::vector<Instr> code;
+  /** The bytes of the tables, and of their Luts. */
+  size_t tableBytes() const;
+  size_t lutBytes() const;
+  /** The bits of the chunks of the Luts, 0 if no arc uses one. */
+  int lutBits() const;
+
+private:
+  CjDense dense;
+};
+
+} // namespace csp01
+
+#endif // __CSP01_MODEL_H__
@@ -0,0 +1,95 @@
+#include <algorithm>
+
+#include "revise.h"
+
+namespace csp01 {
+
+/**
+ * A union takes words per value of y, a scan about a test per value of x
+ * and more as the table gets tighter (the residues miss). This weighs the
+ * two, it was measured on the urbcsp sets from d64 to d512.
+ */
+static const double UNION_COST = 0.5;
+
+int lutChunks(int size, int bits) {
+  if (size <= 0) { return 0; }
+  const int lastWord = (size - 1) / 64;
+  return lastWord * ((64 + bits - 1) / bits) + (size - lastWord * 64 + bits - 1) / bits;
+}
+
+size_t lutBytes(int size, int words, int bits) {
+  return ((size_t) lutChunks(size, bits) << bits) * words * sizeof(uint64_t);
+}
+
+void compileLut(const uint64_t* rows, int size, int words, int bits, Lut& out) {
+  out.bits = bits;
+  out.chunksPerWord = (64 + bits - 1) / bits;
+  const int chunks = lutChunks(size, bits);
+  out.entries.assign(((size_t) chunks << bits) * words, 0);
+
+  // Each entry is that of the subset less its first value, or'ed with the
+  // row of that value.
+  for (int c = 0; c < chunks; ++c) {
+    const int first = (c / out.chunksPerWord) * 64 + (c % out.chunksPerWord) * bits;
+    const int n = std::min(std::min(bits, 64 - (c % out.chunksPerWord) * bits), size - first);
+    uint64_t* entries = out.entries.data() + ((size_t) c << bits) * words;
+    for (uint64_t subset = 1; subset < ((uint64_t) 1 << n); ++subset) {
+      const uint64_t* less = entries + (subset & (subset - 1)) * words;
+      const uint64_t* row = rows + (size_t) (first + __builtin_ctzll(subset)) * words;
+      for (int k = 0; k < words; ++k) { entries[subset * words + k] = less[k] | row[k]; }
+    }
+  }
+}
+
+int compileRevise(
+  const uint64_t* supports, int xSize, int ySize, int words, int blockWords,
+  int lutBits, size_t lutBytesLeft, RevisePolicy policy, std::vector<Instr>& code) {
+  const int program = (int) code.size();
+  const int blocks = words / blockWords;
+  if (policy == REVISE_GENERIC) {
+    code.push_back(Instr{OP_SCAN_RESIDUE, 0});
+    return program;
+  }
+
+  // The most conflicts of a value of x, and the tightness of the table.
+  int maxConflicts = 0;
+  long long conflicts = 0;
+  for (int i = 0; i < xSize; ++i) {
+    int count = ySize;
+    for (int k = 0; k < words; ++k) { count -= __builtin_popcountll(supports[(size_t) i * words + k]); }
+    conflicts += count;
+    if (count > maxConflicts) { maxConflicts = count; }
+  }
+  const double tightness = xSize > 0 && ySize > 0 ? (double) conflicts / ((double) xSize * ySize) : 0;
+
+  // Counting y costs about as much as the revise it may save, so only when
+  // it can exit while y still has half of its values.
+  if (2 * maxConflicts < ySize) {
+    code.push_back(Instr{OP_EXIT_IF_MORE, maxConflicts});
+  }
+
+  // A single value of y (an assigned variable) is always a union.
+  const int unionAtMost = std::max(1, (int) (UNION_COST * xSize * (1 + tightness) / words));
+  code.push_back(Instr{OP_UNION_IF_AT_MOST, unionAtMost});
+
+  // A Lut takes a lookup per chunk of y with a value in it, whatever their
+  // number: asked for, it replaces the scan past the unions of rows, as long
+  // as it fits.
+  if (lutBits > 0 && lutChunks(ySize, lutBits) > 0 && lutBytes(ySize, words, lutBits) <= lutBytesLeft) {
+    code.push_back(Instr{OP_UNION_LUT, 0});
+    return program;
+  }
+
+  code.push_back(Instr{blocks > 1 ? OP_SCAN_RESIDUE : OP_SCAN, 0});
+  return program;
+}
+
+bool programUsesLut(const std::vector<Instr>& code, int program) {
+  for (size_t pc = program; pc < code.size(); ++pc) {
+    if (code[pc].op == OP_UNION_LUT) { return true; }
+    if (code[pc].op == OP_SCAN_RESIDUE || code[pc].op == OP_SCAN) { return false; }
+  }
+  return false;
+}
+
+} // namespace csp01
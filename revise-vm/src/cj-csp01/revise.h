@@ -0,0 +1,118 @@
+#ifndef __CSP01_REVISE_H__
+#define __CSP01_REVISE_H__
+
+// Revise programs.
+//
+// The revise of the domain of x against that of y is a short program of
+// Instrs run by the interpreter of Solver, so that the strategy can change
+// per constraint (and direction) without rebuilding the solver. A program
+// is a list of guards, each of which may settle the revise and exit, ended
+// by a union of a Lut or a scan that always does:
+//
+//   EXIT_IF_MORE n    y has more than n values: every value of x keeps a
+//                     support since none has more than n conflicts. Exit.
+//   UNION_IF_AT_MOST n
+//                     y has at most n values: x keeps the union of their
+//                     supports, a row of the inverse table each. Exit.
+//   UNION_LUT         x keeps the union of the supports of the values of
+//                     y, looked up a chunk of values at a time (see Lut).
+//                     Exit.
+//   SCAN_RESIDUE      test each value of x: the block of its residue
+//                     first, then AND-scan the blocks. Exit.
+//   SCAN              test each value of x, AND-scan the blocks. Exit.
+//
+// compileRevise() picks the program of an arc from the tightness of its
+// table and the size of the domains.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+namespace csp01 {
+
+enum Op : uint8_t {
+  OP_EXIT_IF_MORE,
+  OP_UNION_IF_AT_MOST,
+  OP_SCAN_RESIDUE,
+  OP_SCAN,
+  OP_UNION_LUT,
+};
+
+struct Instr {
+  Op op;
+  int arg;
+};
+
+enum RevisePolicy {
+  /** A program per arc, see compileRevise(). */
+  REVISE_AUTO,
+  /** SCAN_RESIDUE for every arc, the revise of a solver without programs. */
+  REVISE_GENERIC,
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// Lut
+//
+// The union of the rows of a table for any set of values, a chunk of bits
+// values at a time (Four Russians): each word of a domain is cut into
+// chunks of bits bits, the last one shorter when bits doesn't divide 64,
+// and the entry of a chunk for each of its 2^bits subsets is the union of
+// their rows. A union then takes a lookup per chunk of the domain that has
+// a value in it, instead of a row per value.
+//
+
+/** The most bits of a chunk, 2^16 entries of a row each. */
+const int LUT_MAX_BITS = 16;
+
+/** The most bytes of the Luts of a model, the arcs past it go without. */
+const size_t LUT_MAX_BYTES = (size_t) 64 << 20;
+
+/** The bytes of a Lut of size rows of words with chunks of bits values. */
+size_t lutBytes(int size, int words, int bits);
+
+struct Lut {
+  int bits = 0;
+  int chunksPerWord = 0;
+  /** The entries of each chunk, 2^bits of words each. */
+  std::vector<uint64_t> entries;
+
+  /**
+   * The union of the rows of subset, the values of chunk of word of a
+   * domain of words.
+   */
+  const uint64_t* entry(int word, int chunk, uint64_t subset, int words) const {
+    const size_t c = (size_t) word * chunksPerWord + chunk;
+    return entries.data() + (((c << bits) + subset) * words);
+  }
+};
+
+/** The chunks of a Lut of size rows with chunks of bits values. */
+int lutChunks(int size, int bits);
+
+/**
+ * Build the Lut of the union of the size rows of words of rows, with chunks
+ * of bits (1 to LUT_MAX_BITS) values.
+ */
+void compileLut(const uint64_t* rows, int size, int words, int bits, Lut& out);
+
+/**
+ * Append the program of an arc to code.
+ * @param supports xSize rows of words, the supports of each value of x.
+ * @param ySize the values of y (bits of a row).
+ * @param blockWords the words the scans test at a time.
+ * @param lutBits the bits of the chunks of a Lut of the supports of the
+ *   values of y, the program then ends with UNION_LUT instead of a scan if
+ *   the Lut fits. 0 for none.
+ * @param lutBytesLeft the most bytes that Lut can take.
+ * @return the offset of the program in code.
+ */
+int compileRevise(
+  const uint64_t* supports, int xSize, int ySize, int words, int blockWords,
+  int lutBits, size_t lutBytesLeft, RevisePolicy policy, std::vector<Instr>& code);
+
+/** true if the program at offset program of code uses a Lut. */
+bool programUsesLut(const std::vector<Instr>& code, int program);
+
+} // namespace csp01
+
+#endif // __CSP01_REVISE_H__
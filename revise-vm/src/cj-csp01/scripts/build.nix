@@ -0,0 +1,6 @@
+with import <nixpkgs> {};
+stdenv.mkDerivation {
+  name = "env";
+  nativeBuildInputs = [ cmake ]; # build time
+  buildInputs = []; # runtime
+}
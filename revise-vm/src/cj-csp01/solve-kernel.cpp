@@ -0,0 +1,76 @@
+// The solve() of a kernel, see solve.h. CMake builds this file once per
+// kernel with its define (see kernels.h).
+//
+// The Solver of the x86 kernels is compiled for their ISA with a target
+// pragma rather than -m flags: the std code it instantiates is then compiled
+// (and merged by the linker) for the base ISA like in the other files, so
+// that nothing past the base ISA runs before bestKernel() picked it.
+
+#include <assert.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+#if defined(CJ_AVX512) || defined(CJ_AVX2) || defined(CJ_SSE42)
+#include <immintrin.h>
+#endif
+
+#include "model.h"
+#include "solve.h"
+
+#if defined(__clang__)
+#if defined(CJ_AVX512)
+#pragma clang attribute push(__attribute__((target("avx512f"))), apply_to = function)
+#elif defined(CJ_AVX2)
+#pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#elif defined(CJ_SSE42)
+#pragma clang attribute push(__attribute__((target("sse4.2"))), apply_to = function)
+#endif
+#else
+#pragma GCC push_options
+#if defined(CJ_AVX512)
+#pragma GCC target("avx512f")
+#elif defined(CJ_AVX2)
+#pragma GCC target("avx2")
+#elif defined(CJ_SSE42)
+#pragma GCC target("sse4.2")
+#endif
+#endif
+
+#include "solver.h"
+
+namespace csp01 {
+inline namespace CSP01_KERNEL {
+
+template <int B>
+static bool solveBlock(const Model& model, std::vector<int>& solution, Stats& stats) {
+  Solver<B> solver(model);
+  const bool solved = solver.solve();
+  if (solved) { solution = solver.solution(); }
+  stats = solver.stats();
+  return solved;
+}
+
+} // inline namespace CSP01_KERNEL
+
+bool CSP01_SOLVE(const Model& model, std::vector<int>& solution, Stats& stats) {
+  static_assert(MAX_BLOCK_WORDS == 16, "a case per block");
+  switch (model.blockWords) {
+    case 1: return solveBlock<1>(model, solution, stats);
+    case 2: return solveBlock<2>(model, solution, stats);
+    case 4: return solveBlock<4>(model, solution, stats);
+    case 8: return solveBlock<8>(model, solution, stats);
+    case 16: return solveBlock<16>(model, solution, stats);
+  }
+  assert(0);
+  return false;
+}
+
+} // namespace csp01
+
+#if defined(__clang__)
+#if defined(CJ_AVX512) || defined(CJ_AVX2) || defined(CJ_SSE42)
+#pragma clang attribute pop
+#endif
+#else
+#pragma GCC pop_options
+#endif
@@ -0,0 +1,77 @@
+#include <assert.h>
+#include <string.h>
+
+#include "solve.h"
+
+// The kernels CMake builds for the target, see CMakeLists.txt.
+#if defined(__x86_64__) || defined(_M_X64)
+#define CSP01_X86 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define CSP01_ARM 1
+#endif
+
+namespace csp01 {
+
+static const char* KERNEL_NAMES[KERNEL_COUNT] = {"scalar", "1bit", "sse42", "avx2", "avx512", "neon"};
+
+const char* kernelName(Kernel kernel) {
+  return kernel >= 0 && kernel < KERNEL_COUNT ? KERNEL_NAMES[kernel] : "";
+}
+
+bool kernelByName(const char* name, Kernel& out) {
+  for (int k = 0; k < KERNEL_COUNT; ++k) {
+    if (strcmp(name, KERNEL_NAMES[k]) == 0) {
+      out = (Kernel) k;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool kernelRuns(Kernel kernel) {
+  switch (kernel) {
+    case KERNEL_SCALAR:
+    case KERNEL_1BIT:
+      return true;
+#ifdef CSP01_X86
+    // The checks of the CPU include the OS saving the vector registers.
+    case KERNEL_SSE42: return __builtin_cpu_supports("sse4.2");
+    case KERNEL_AVX2: return __builtin_cpu_supports("avx2");
+    case KERNEL_AVX512: return __builtin_cpu_supports("avx512f");
+#endif
+#ifdef CSP01_ARM
+    // NEON is part of AArch64.
+    case KERNEL_NEON: return true;
+#endif
+    default:
+      return false;
+  }
+}
+
+Kernel bestKernel() {
+  const Kernel best[] = {KERNEL_AVX512, KERNEL_AVX2, KERNEL_SSE42, KERNEL_NEON};
+  for (Kernel kernel : best) {
+    if (kernelRuns(kernel)) { return kernel; }
+  }
+  return KERNEL_SCALAR;
+}
+
+bool solve(Kernel kernel, const Model& model, std::vector<int>& solution, Stats& stats) {
+  switch (kernel) {
+    case KERNEL_SCALAR: return solveScalar(model, solution, stats);
+    case KERNEL_1BIT: return solve1Bit(model, solution, stats);
+#ifdef CSP01_X86
+    case KERNEL_SSE42: return solveSse42(model, solution, stats);
+    case KERNEL_AVX2: return solveAvx2(model, solution, stats);
+    case KERNEL_AVX512: return solveAvx512(model, solution, stats);
+#endif
+#ifdef CSP01_ARM
+    case KERNEL_NEON: return solveNeon(model, solution, stats);
+#endif
+    default:
+      assert(0);
+      return false;
+  }
+}
+
+} // namespace csp01
@@ -0,0 +1,65 @@
+#ifndef __CSP01_SOLVE_H__
+#define __CSP01_SOLVE_H__
+
+// Run the Solver of a kernel on a Model.
+//
+// The Solver (solver.h) is built once per kernel (see kernels.h), each for
+// its own ISA, and per block (B = 1 to MAX_BLOCK_WORDS words, powers of
+// two), all in the one binary. solve() picks the one of the blockWords of
+// the model, and bestKernel() the kernel of the CPU it runs on.
+
+#include <vector>
+
+#include "model.h"
+
+namespace csp01 {
+
+struct Stats {
+  long long nodes = 0;
+  long long fails = 0;
+  long long revisions = 0;
+  int depthMax = 0;
+};
+
+enum Kernel {
+  /** The plain loops. */
+  KERNEL_SCALAR,
+  /** A bit at a time, see CJ_REVISE_1BIT. */
+  KERNEL_1BIT,
+  KERNEL_SSE42,
+  KERNEL_AVX2,
+  KERNEL_AVX512,
+  KERNEL_NEON,
+  KERNEL_COUNT,
+};
+
+/** The name of kernel, "scalar", "1bit", "sse42", "avx2", "avx512" or "neon". */
+const char* kernelName(Kernel kernel);
+
+/** The kernel of name. @return false if there is none. */
+bool kernelByName(const char* name, Kernel& out);
+
+/** true if kernel is in this binary and the CPU has its ISA. */
+bool kernelRuns(Kernel kernel);
+
+/** The widest vectors that run, KERNEL_SCALAR if none do. */
+Kernel bestKernel();
+
+/**
+ * Search for a solution of model with kernel, which needs to run, and the
+ * block of the model.
+ * @return true if one is found, the value of each variable in solution.
+ */
+bool solve(Kernel kernel, const Model& model, std::vector<int>& solution, Stats& stats);
+
+// The solve() of each kernel, see solve-kernel.cpp.
+bool solveScalar(const Model& model, std::vector<int>& solution, Stats& stats);
+bool solve1Bit(const Model& model, std::vector<int>& solution, Stats& stats);
+bool solveSse42(const Model& model, std::vector<int>& solution, Stats& stats);
+bool solveAvx2(const Model& model, std::vector<int>& solution, Stats& stats);
+bool solveAvx512(const Model& model, std::vector<int>& solution, Stats& stats);
+bool solveNeon(const Model& model, std::vector<int>& solution, Stats& stats);
+
+} // namespace csp01
+
+#endif // __CSP01_SOLVE_H__
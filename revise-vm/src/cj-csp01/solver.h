@@ -0,0 +1,298 @@
+#ifndef __CSP01_SOLVER_H__
+#define __CSP01_SOLVER_H__
+
+// A MAC (maintaining arc consistency) search over a Model.
+//
+// Variables are taken in order and values in increasing order, with a
+// binary branching (x = v, then x != v), so the first solution found is the
+// lexicographically smallest one like with the CHOOSE_FIRST_UNBOUND /
+// ASSIGN_MIN_VALUE phase of the OR-Tools adapter. Arc consistency is kept
+// by an AC3 variable queue. Each arc is revised by running its program
+// (see revise.h), whose scans test the support of a value a block of B
+// words at a time. Each value remembers the block of its last support (its
+// residue), which is checked first.
+//
+// CJ_REVISE_1BIT tests the supports a bit (value of y) at a time instead,
+// the reference the bit-parallel revise is measured against. The block
+// kernels may be vectorized, see kernels.h, and solve() (solve.h) runs the
+// Solver of the kernel and block of the CPU and the model.
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "kernels.h"
+#include "model.h"
+#include "solve.h"
+
+namespace csp01 {
+inline namespace CSP01_KERNEL {
+
+template <int B>
+class Solver {
+public:
+  explicit Solver(const Model& model)
+    : model_(model),
+      words_(model.words),
+      blocks_(model.words / B),
+      doms_((size_t) (model.numVars + 1) * model.numVars * model.words),
+      residues_(model.numResidues, 0),
+      queue_(model.numVars),
+      queued_(model.numVars, 0),
+      union_(model.words) {
+    if (model_.numVars > 0) {
+      memcpy(doms_.data(), model_.domains.data(), sizeof(uint64_t) * model_.domains.size());
+    }
+  }
+
+  /** Search for a solution, see solution(). @return true if one is found. */
+  bool solve() {
+    const int n = model_.numVars;
+    uint64_t* doms = doms_.data();
+    // The unary constraints may have emptied a domain no arc revises.
+    for (int v = 0; v < n; ++v) {
+      if (first(doms + (size_t) v * words_) < 0) { return false; }
+    }
+    for (int v = 0; v < n; ++v) { push(v); }
+    if (!propagate(doms)) { return false; }
+    if (!search(0)) { return false; }
+    solution_.resize(n);
+    for (int v = 0; v < n; ++v) { solution_[v] = model_.value(v, first(doms_.data() + (size_t) v * words_)); }
+    return true;
+  }
+
+  /** The value of each variable, after solve() returned true. */
+  const std::vector<int>& solution() const { return solution_; }
+  const Stats& stats() const { return stats_; }
+
+private:
+  uint64_t* domsAt(int depth) { return doms_.data() + (size_t) depth * model_.numVars * words_; }
+
+  /** The domains at depth + 1 are copied from depth before each decision. */
+  bool search(int depth) {
+    if (depth > stats_.depthMax) { stats_.depthMax = depth; }
+    uint64_t* doms = domsAt(depth);
+    for (;;) {
+      const int x = unbound(doms);
+      if (x < 0) {
+        if (depth > 0) { memcpy(doms_.data(), doms, sizeof(uint64_t) * model_.numVars * words_); }
+        return true;
+      }
+      uint64_t* dom = doms + (size_t) x * words_;
+      const int i = first(dom);
+
+      // x = i
+      ++stats_.nodes;
+      uint64_t* child = domsAt(depth + 1);
+      memcpy(child, doms, sizeof(uint64_t) * model_.numVars * words_);
+      uint64_t* childDom = child + (size_t) x * words_;
+      memset(childDom, 0, sizeof(uint64_t) * words_);
+      childDom[i / 64] = (uint64_t) 1 << (i % 64);
+      push(x);
+      if (propagate(child) && search(depth + 1)) { return true; }
+
+      // x != i
+      dom[i / 64] &= ~((uint64_t) 1 << (i % 64));
+      push(x);
+      if (!propagate(doms)) { return false; }
+    }
+  }
+
+  /** The first variable with more than one value, -1 if there is none. */
+  int unbound(const uint64_t* doms) const {
+    for (int v = 0; v < model_.numVars; ++v) {
+      const uint64_t* dom = doms + (size_t) v * words_;
+      int count = 0;
+      for (int k = 0; k < words_ && count < 2; ++k) { count += __builtin_popcountll(dom[k]); }
+      if (count > 1) { return v; }
+    }
+    return -1;
+  }
+
+  int first(const uint64_t* dom) const {
+    for (int k = 0; k < words_; ++k) {
+      if (dom[k]) { return k * 64 + __builtin_ctzll(dom[k]); }
+    }
+    return -1;
+  }
+
+  void push(int v) {
+    if (queued_[v]) { return; }
+    queued_[v] = 1;
+    queue_[(head_ + size_++) % model_.numVars] = v;
+  }
+
+  int pop() {
+    const int v = queue_[head_];
+    head_ = (head_ + 1) % model_.numVars;
+    --size_;
+    queued_[v] = 0;
+    return v;
+  }
+
+  /** Revise until the queue is empty. @return false on a domain wipe out. */
+  bool propagate(uint64_t* doms) {
+    while (size_ > 0) {
+      const int y = pop();
+      for (int a = model_.arcOffsets[y]; a < model_.arcOffsets[y + 1]; ++a) {
+        const Arc& arc = model_.arcs[a];
+        bool changed = false;
+        if (!revise(arc, doms, changed)) {
+          ++stats_.fails;
+          while (size_ > 0) { pop(); }
+          return false;
+        }
+        if (changed) { push(arc.x); }
+      }
+    }
+    return true;
+  }
+
+  /**
+   * Run the revise program of arc (see revise.h): remove the values of x
+   * without support in y. @return false if x is left empty.
+   */
+  bool revise(const Arc& arc, uint64_t* doms, bool& changed) {
+    ++stats_.revisions;
+    uint64_t* domX = doms + (size_t) arc.x * words_;
+    const uint64_t* domY = doms + (size_t) arc.y * words_;
+    int sizeY = -1;
+    for (const Instr* pc = model_.code.data() + arc.program;; ++pc) {
+      switch (pc->op) {
+        case OP_EXIT_IF_MORE:
+          if (sizeY < 0) { sizeY = count(domY); }
+          if (sizeY > pc->arg) { return true; }
+          break;
+        case OP_UNION_IF_AT_MOST:
+          if (sizeY < 0) { sizeY = count(domY); }
+          if (sizeY <= pc->arg) { return reviseUnion(arc, domX, domY, changed); }
+          break;
+        case OP_SCAN_RESIDUE:
+          return reviseScan<true>(arc, domX, domY, changed);
+        case OP_SCAN:
+          return reviseScan<false>(arc, domX, domY, changed);
+        case OP_UNION_LUT:
+          return reviseUnionLut(arc, domX, domY, changed);
+      }
+    }
+  }
+
+  int count(const uint64_t* dom) const {
+    int n = 0;
+    for (int k = 0; k < words_; ++k) { n += __builtin_popcountll(dom[k]); }
+    return n;
+  }
+
+  /** x keeps the union of the supports of the values of y. */
+  bool reviseUnion(const Arc& arc, uint64_t* domX, const uint64_t* domY, bool& changed) {
+    uint64_t* all = union_.data();
+    memset(all, 0, sizeof(uint64_t) * words_);
+    for (int k = 0; k < words_; ++k) {
+      for (uint64_t bits = domY[k]; bits; bits &= bits - 1) {
+        const uint64_t* row = arc.inverse + (size_t) (k * 64 + __builtin_ctzll(bits)) * words_;
+        for (int w = 0; w < words_; w += B) { orBlock<B>(all + w, row + w); }
+      }
+    }
+    return keep(domX, all, changed);
+  }
+
+  /** reviseUnion() a chunk of values of y at a time, see Lut. */
+  bool reviseUnionLut(const Arc& arc, uint64_t* domX, const uint64_t* domY, bool& changed) {
+    const Lut& lut = *arc.inverseLut;
+    const uint64_t mask = ((uint64_t) 1 << lut.bits) - 1;
+    uint64_t* all = union_.data();
+    memset(all, 0, sizeof(uint64_t) * words_);
+    for (int k = 0; k < words_; ++k) {
+      int chunk = 0;
+      for (uint64_t bits = domY[k]; bits; bits >>= lut.bits, ++chunk) {
+        if (!(bits & mask)) { continue; }
+        const uint64_t* entry = lut.entry(k, chunk, bits & mask, words_);
+        for (int w = 0; w < words_; w += B) { orBlock<B>(all + w, entry + w); }
+      }
+    }
+    return keep(domX, all, changed);
+  }
+
+  /** dom &= kept. @return false if dom is left empty. */
+  bool keep(uint64_t* dom, const uint64_t* kept, bool& changed) const {
+    uint64_t left = 0;
+    for (int k = 0; k < words_; ++k) {
+      const uint64_t d = dom[k] & kept[k];
+      if (d != dom[k]) {
+        dom[k] = d;
+        changed = true;
+      }
+      left |= d;
+    }
+    return left != 0;
+  }
+
+  /** Test the support of each value of x, its residue block first if RESIDUE. */
+  template <bool RESIDUE>
+  bool reviseScan(const Arc& arc, uint64_t* domX, const uint64_t* domY, bool& changed) {
+    uint16_t* residues = residues_.data() + arc.residues;
+    uint64_t left = 0;
+    for (int k = 0; k < words_; ++k) {
+      uint64_t removed = 0;
+      for (uint64_t bits = domX[k]; bits; bits &= bits - 1) {
+        const int i = k * 64 + __builtin_ctzll(bits);
+        if (!supported<RESIDUE>(arc.supports + (size_t) i * words_, domY, residues[i])) {
+          removed |= bits & -bits;
+        }
+      }
+      if (removed) {
+        domX[k] &= ~removed;
+        changed = true;
+      }
+      left |= domX[k];
+    }
+    return left != 0;
+  }
+
+#ifdef CJ_REVISE_1BIT
+  template <bool RESIDUE>
+  bool supported(const uint64_t* row, const uint64_t* dom, uint16_t&) const {
+    for (int k = 0; k < words_; ++k) {
+      for (uint64_t bits = dom[k]; bits; bits &= bits - 1) {
+        if ((row[k] >> __builtin_ctzll(bits)) & 1) { return true; }
+      }
+    }
+    return false;
+  }
+#else
+  template <bool RESIDUE>
+  bool supported(const uint64_t* row, const uint64_t* dom, uint16_t& residue) const {
+    const int skip = RESIDUE ? residue : -1;
+    if (RESIDUE && intersectsBlock<B>(row + skip * B, dom + skip * B)) { return true; }
+    for (int b = 0; b < blocks_; ++b) {
+      if (b != skip && intersectsBlock<B>(row + b * B, dom + b * B)) {
+        if (RESIDUE) { residue = (uint16_t) b; }
+        return true;
+      }
+    }
+    return false;
+  }
+#endif
+
+  const Model& model_;
+  const int words_;
+  const int blocks_;
+  /** The domains at each depth, numVars + 1 levels of numVars * words. */
+  std::vector<uint64_t> doms_;
+  /** The block of the last support of each value of the x of each arc. */
+  std::vector<uint16_t> residues_;
+  /** The variables whose domain changed, a ring of numVars. */
+  std::vector<int> queue_;
+  std::vector<char> queued_;
+  /** The supports of the values of y, see reviseUnion(). */
+  std::vector<uint64_t> union_;
+  int head_ = 0;
+  int size_ = 0;
+  std::vector<int> solution_;
+  Stats stats_;
+};
+
+} // inline namespace CSP01_KERNEL
+} // namespace csp01
+
+#endif // __CSP01_SOLVER_H__
@@ -0,0 +1,112 @@
+#ifndef __CJ_CSP_DENSE_H__
+#define __CJ_CSP_DENSE_H__
+
+#include <stdint.h>
+
+#include "cj-csp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// CjDense
+//
+// A normalized view of a csp for solvers: the values of each domain are
+// replaced by their dense index 0..d-1 (in increasing order of value), and
+// the tuples of the constraintDefs are stored with the narrowest unsigned
+// type that holds the indices, uint8_t for d <= 256 and uint16_t for
+// d <= 65536. Use cjDenseValue() to map a solution back.
+//
+// The indices of a tuple depend on the domains of the constrained variables,
+// so there is one dense def per constraintDef and combination of domains
+// (for most instances it is one per constraintDef, a def that no constraint
+// uses has none). Tuples with a value that is not in its domain can't be
+// assigned and are left out.
+//
+
+/** The largest domain that can be made dense. */
+#define CJ_DENSE_MAX_VALUES (1 << 24)
+
+typedef struct CjDenseDomain {
+  int size;
+  /** values[i] is the value of index i, in increasing order. */
+  int* values;
+} CjDenseDomain;
+
+/** A CjIntTuples of arity >= 0 with narrow entries. */
+typedef struct CjDenseTuples {
+  int size;
+  int arity;
+  /** The bytes of an entry: 1 (uint8_t), 2 (uint16_t) or 4 (uint32_t). */
+  int width;
+  /** size * arity entries of width bytes, 64-byte aligned. */
+  void* data;
+} CjDenseTuples;
+
+typedef struct CjDenseDef {
+  /** The def it was made from, in csp->constraintDefs. */
+  int id;
+  /** CJ_CONSTRAINT_DEF_NO_GOODS or CJ_CONSTRAINT_DEF_GOODS. */
+  int type;
+  CjDenseTuples tuples;
+} CjDenseDef;
+
+typedef struct CjDense {
+  /** Same indices as csp->domains. */
+  int domainsSize;
+  CjDenseDomain* domains;
+
+  /** The domain of each variable, same as csp->vars. */
+  int varsSize;
+  int* vars;
+
+  int defsSize;
+  CjDenseDef* defs;
+
+  /** The dense def of each of csp->constraints, whose vars are kept. */
+  int constraintsSize;
+  int* constraintDefs;
+} CjDense;
+
+/** Zero/null init a CjDense. */
+CjDense cjDenseInit();
+
+/**
+ * Make the dense view of csp, which needs to be valid (see cjCspValidate())
+ * with its constraintDefs decoded (see cjCspConstraintDefsDecode()).
+ * Free the created object with cjDenseFree.
+ * @return CJ_ERROR_OK on success, CJ_ERROR_ARG if a domain has more than
+ *   CJ_DENSE_MAX_VALUES values or a def is of an unknown type.
+ */
+CjError cjDenseAlloc(const CjCsp* csp, CjDense* out);
+void cjDenseFree(CjDense* inout);
+
+/** The index of value in domain, or -1 if it is not in it. */
+int cjDenseIndex(const CjDenseDomain* domain, int value);
+
+/** The value of index of variable var. */
+static inline int cjDenseValue(const CjDense* dense, int var, int index) {
+  return dense->domains[dense->vars[var]].values[index];
+}
+
+/** Entry i of tuples (tuple i / arity, position i % arity). */
+static inline int cjDenseTuplesGet(const CjDenseTuples* tuples, size_t i) {
+  switch (tuples->width) {
+    case 1: return ((const uint8_t*) tuples->data)[i];
+    case 2: return ((const uint16_t*) tuples->data)[i];
+    default: return (int) ((const uint32_t*) tuples->data)[i];
+  }
+}
+
+/**
+ * Map a solution of indices (one per variable) back to values.
+ * indices and values can be the same array.
+ */
+void cjDenseSolution(const CjDense* dense, const int* indices, int* values);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // __CJ_CSP_DENSE_H__
@@ -0,0 +1,640 @@
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cj-csp-matrix.h"
+
+#define CJ_LINE_WORDS 8
+
+////////////////////////////////////////////////////////////////////////////////
+// CjBitMatrix
+//
+
+CjBitMatrix cjBitMatrixInit() {
+  CjBitMatrix x;
+  x.rowMin = 0;
+  x.colMin = 0;
+  x.rows = 0;
+  x.cols = 0;
+  x.rowWords = 0;
+  x.bits = NULL;
+  return x;
+}
+
+CjError cjBitMatrixAlloc(int rowMin, int rows, int colMin, int cols, CjBitMatrix* out) {
+  if (!out || rows < 0 || cols < 0) { return CJ_ERROR_ARG; }
+  if ((long long) rowMin + rows - 1 > INT_MAX || (long long) colMin + cols - 1 > INT_MAX) {
+    return CJ_ERROR_ARG;
+  }
+  *out = cjBitMatrixInit();
+  const int words = (int) (((long long) cols + 63) / 64);
+  const int rowWords = (words + CJ_LINE_WORDS - 1) / CJ_LINE_WORDS * CJ_LINE_WORDS;
+  const size_t bytes = sizeof(uint64_t) * (size_t) rows * rowWords;
+  uint64_t* bits = NULL;
+  if (bytes > 0) {
+    bits = (uint64_t*) aligned_alloc(sizeof(uint64_t) * CJ_LINE_WORDS, bytes);
+    if (!bits) { return CJ_ERROR_NOMEM; }
+    memset(bits, 0, bytes);
+  }
+  out->rowMin = rowMin;
+  out->colMin = colMin;
+  out->rows = rows;
+  out->cols = cols;
+  out->rowWords = rowWords;
+  out->bits = bits;
+  return CJ_ERROR_OK;
+}
+
+void cjBitMatrixFree(CjBitMatrix* inout) {
+  if (!inout) { return; }
+  free(inout->bits);
+  *inout = cjBitMatrixInit();
+}
+
+long long cjBitMatrixCount(const CjBitMatrix* m) {
+  long long n = 0;
+  const size_t words = (size_t) m->rows * m->rowWords;
+  for (size_t i = 0; i < words; ++i) { n += __builtin_popcountll(m->bits[i]); }
+  return n;
+}
+
+CjError cjBitMatrixSetTuples(CjBitMatrix* m, const CjIntTuples* tuples) {
+  if (!m || !tuples) { return CJ_ERROR_ARG; }
+  if (tuples->size == 0) { return CJ_ERROR_OK; }
+  if (tuples->arity != 2) { return CJ_ERROR_ARG; }
+  const int* pair = tuples->data;
+  for (int i = 0; i < tuples->size; ++i, pair += 2) {
+    const unsigned r = (unsigned) pair[0] - (unsigned) m->rowMin;
+    const unsigned c = (unsigned) pair[1] - (unsigned) m->colMin;
+    if (r < (unsigned) m->rows && c < (unsigned) m->cols) {
+      m->bits[(size_t) r * m->rowWords + c / 64] |= (uint64_t) 1 << (c % 64);
+    }
+  }
+  return CJ_ERROR_OK;
+}
+
+CjError cjBitMatrixTuples(const CjBitMatrix* m, CjIntTuples* out) {
+  if (!m || !out) { return CJ_ERROR_ARG; }
+  const long long n = cjBitMatrixCount(m);
+  if (n > INT_MAX) { return CJ_ERROR_ARG; }
+  CjError stat = cjIntTuplesAlloc((int) n, 2, out);
+  if (stat != CJ_ERROR_OK) { return stat; }
+  int* pair = out->data;
+  for (int r = 0; r < m->rows; ++r) {
+    const uint64_t* row = m->bits + (size_t) r * m->rowWords;
+    for (int word = 0; word < m->rowWords; ++word) {
+      for (uint64_t bits = row[word]; bits; bits &= bits - 1) {
+        pair[0] = m->rowMin + r;
+        pair[1] = m->colMin + word * 64 + __builtin_ctzll(bits);
+        pair += 2;
+      }
+    }
+  }
+  return CJ_ERROR_OK;
+}
+
+/**
+ * Transpose a 64x64 block in place: bit c of a[r] ends up as bit r of a[c].
+ * Swaps ever smaller off-diagonal blocks (32x32, 16x16, ...) at once.
+ */
+static void transpose64(uint64_t a[64]) {
+  uint64_t m = 0x00000000FFFFFFFFULL;
+  for (int j = 32; j != 0; j >>= 1, m ^= m << j) {
+    for (int k = 0; k < 64; k = ((k | j) + 1) & ~j) {
+      const uint64_t t = ((a[k] >> j) ^ a[k | j]) & m;
+      a[k] ^= t << j;
+      a[k | j] ^= t;
+    }
+  }
+}
+
+CjError cjBitMatrixTranspose(const CjBitMatrix* m, CjBitMatrix* out) {
+  if (!m || !out) { return CJ_ERROR_ARG; }
+  CjError stat = cjBitMatrixAlloc(m->colMin, m->cols, m->rowMin, m->rows, out);
+  if (stat != CJ_ERROR_OK) { return stat; }
+
+  uint64_t block[64];
+  for (int r0 = 0; r0 < m->rows; r0 += 64) {
+    const int numRows = m->rows - r0 < 64 ? m->rows - r0 : 64;
+    for (int c0 = 0; c0 < m->cols; c0 += 64) {
+      const int numCols = m->cols - c0 < 64 ? m->cols - c0 : 64;
+      for (int i = 0; i < 64; ++i) {
+        block[i] = i < numRows ? m->bits[(size_t) (r0 + i) * m->rowWords + c0 / 64] : 0;
+      }
+      transpose64(block);
+      for (int i = 0; i < numCols; ++i) {
+        out->bits[(size_t) (c0 + i) * out->rowWords + r0 / 64] = block[i];
+      }
+    }
+  }
+  return CJ_ERROR_OK;
+}
+
+CjError cjBitMatrixMarkDomain(CjBitMatrix* m, int x, const CjDomain* dom) {
+  if (!m || !dom) { return CJ_ERROR_ARG; }
+  const unsigned r = (unsigned) x - (unsigned) m->rowMin;
+  if (r >= (unsigned) m->rows) { return CJ_ERROR_ARG; }
+  uint64_t* row = m->bits + (size_t) r * m->rowWords;
+
+  if (dom->type == CJ_DOMAIN_VALUES) {
+    for (int i = 0; i < dom->values.size; ++i) {
+      const unsigned c = (unsigned) dom->values.data[i] - (unsigned) m->colMin;
+      if (c < (unsigned) m->cols) { row[c / 64] |= (uint64_t) 1 << (c % 64); }
+    }
+    return CJ_ERROR_OK;
+  }
+  if (dom->type == CJ_DOMAIN_INTERVALS) {
+    // Fill [lo, hi] a word at a time.
+    for (int i = 0; i < dom->intervals.size; ++i) {
+      long long lo = (long long) dom->intervals.data[2 * i] - m->colMin;
+      long long hi = (long long) dom->intervals.data[2 * i + 1] - m->colMin;
+      if (lo < 0) { lo = 0; }
+      if (hi > m->cols - 1) { hi = m->cols - 1; }
+      for (long long c = lo; c <= hi; ) {
+        const int bit = (int) (c % 64);
+        const int n = hi - c + 1 < 64 - bit ? (int) (hi - c + 1) : 64 - bit;
+        row[c / 64] |= (n == 64 ? ~(uint64_t) 0 : ((uint64_t) 1 << n) - 1) << bit;
+        c += n;
+      }
+    }
+    return CJ_ERROR_OK;
+  }
+  return CJ_ERROR_ARG;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// CjDefMatrix
+//
+
+CjDefMatrix cjDefMatrixInit() {
+  CjDefMatrix x;
+  x.noGoods = cjBitMatrixInit();
+  x.transposed = cjBitMatrixInit();
+  return x;
+}
+
+CjError cjDefMatrixCompile(
+  const CjIntTuples* noGoods, int xMin, int xSize, int yMin, int ySize, CjDefMatrix* out)
+{
+  if (!noGoods || !out) { return CJ_ERROR_ARG; }
+  if (noGoods->arity != 2 && !(noGoods->arity == 0 && noGoods->size == 0)) { return CJ_ERROR_ARG; }
+  *out = cjDefMatrixInit();
+
+  CjBitMatrix* m = &out->noGoods;
+  CjError stat = cjBitMatrixAlloc(xMin, xSize, yMin, ySize, m);
+  if (stat != CJ_ERROR_OK) { return stat; }
+  const int* pair = noGoods->data;
+  for (int i = 0; i < noGoods->size; ++i, pair += 2) {
+    const unsigned r = (unsigned) pair[0] - (unsigned) xMin;
+    const unsigned c = (unsigned) pair[1] - (unsigned) yMin;
+    if (r < (unsigned) xSize && c < (unsigned) ySize) {
+      m->bits[(size_t) r * m->rowWords + c / 64] |= (uint64_t) 1 << (c % 64);
+    }
+  }
+
+  if ((stat = cjBitMatrixTranspose(m, &out->transposed)) != CJ_ERROR_OK) {
+    cjDefMatrixFree(out);
+    return stat;
+  }
+  return CJ_ERROR_OK;
+}
+
+void cjDefMatrixFree(CjDefMatrix* inout) {
+  if (!inout) { return; }
+  cjBitMatrixFree(&inout->noGoods);
+  cjBitMatrixFree(&inout->transposed);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Set algebra
+//
+
+enum { SET_UNION, SET_INTERSECTION, SET_DIFFERENCE };
+
+/**
+ * The most words of bit matrix per pair of the inputs for which a matrix
+ * beats sorting the pairs: past it, the matrix is mostly empty rows.
+ */
+static const long long SET_WORDS_PER_PAIR = 8;
+
+static int setValid(const CjIntTuples* t) {
+  return t && (t->size == 0 || t->arity == 2);
+}
+
+/** Set the bounds of the pairs of t, return 0 if it has none. */
+static int setBounds(const CjIntTuples* t, int* xMin, int* xMax, int* yMin, int* yMax) {
+  if (t->size == 0) { return 0; }
+  *xMin = *xMax = t->data[0];
+  *yMin = *yMax = t->data[1];
+  for (int i = 1; i < t->size; ++i) {
+    const int x = t->data[2 * i];
+    const int y = t->data[2 * i + 1];
+    if (x < *xMin) { *xMin = x; }
+    if (x > *xMax) { *xMax = x; }
+    if (y < *yMin) { *yMin = y; }
+    if (y > *yMax) { *yMax = y; }
+  }
+  return 1;
+}
+
+/** 1 if a matrix over [xMin, xMax] x [yMin, yMax] fits CJ_SET_MAX_BYTES. */
+static int setMatrixFits(int xMin, int xMax, int yMin, int yMax) {
+  const long long xSize = (long long) xMax - xMin + 1;
+  const long long ySize = (long long) yMax - yMin + 1;
+  return xSize <= INT_MAX && ySize <= INT_MAX && cjBitMatrixBytes(xSize, ySize) <= CJ_SET_MAX_BYTES;
+}
+
+/**
+ * 1 to combine pairs over [xMin, xMax] x [yMin, yMax] in bit matrices, 0
+ * to sort and merge them since the matrix doesn't fit or the pairs are
+ * sparse in it.
+ */
+static int setUseMatrix(int xMin, int xMax, int yMin, int yMax, long long pairs) {
+  if (!setMatrixFits(xMin, xMax, yMin, yMax)) { return 0; }
+  const long long words = cjBitMatrixBytes((long long) xMax - xMin + 1, (long long) yMax - yMin + 1) / 8;
+  return words / SET_WORDS_PER_PAIR <= pairs;
+}
+
+/** Allocate m over [xMin, xMax] x [yMin, yMax] with the pairs of t set. */
+static CjError setMatrix(const CjIntTuples* t, int xMin, int xMax, int yMin, int yMax, CjBitMatrix* m) {
+  if (!setMatrixFits(xMin, xMax, yMin, yMax)) { return CJ_ERROR_ARG; }
+  CjError stat = cjBitMatrixAlloc(xMin, (int) ((long long) xMax - xMin + 1), yMin, (int) ((long long) yMax - yMin + 1), m);
+  if (stat != CJ_ERROR_OK) { return stat; }
+  return cjBitMatrixSetTuples(m, t);
+}
+
+/**
+ * Count the pairs of xs (row 0) by ys (row 0) that are not set in m, and
+ * write them to out unless it is null.
+ */
+static long long setComplement(
+  const CjBitMatrix* m, const CjBitMatrix* xs, const CjBitMatrix* ys, int* out)
+{
+  long long n = 0;
+  for (int xWord = 0; xWord < xs->rowWords; ++xWord) {
+    for (uint64_t xBits = xs->bits[xWord]; xBits; xBits &= xBits - 1) {
+      const int r = xWord * 64 + __builtin_ctzll(xBits);
+      const uint64_t* row = m->bits + (size_t) r * m->rowWords;
+      for (int yWord = 0; yWord < ys->rowWords; ++yWord) {
+        uint64_t yBits = ys->bits[yWord] & ~row[yWord];
+        if (!out) {
+          n += __builtin_popcountll(yBits);
+          continue;
+        }
+        for (; yBits; yBits &= yBits - 1) {
+          out[2 * n] = xs->colMin + r;
+          out[2 * n + 1] = ys->colMin + yWord * 64 + __builtin_ctzll(yBits);
+          ++n;
+        }
+      }
+    }
+  }
+  return n;
+}
+
+/** -1, 0 or 1 as pair a is before, equal to or after pair b. */
+static int setPairCompare(const int* a, const int* b) {
+  if (a[0] != b[0]) { return a[0] < b[0] ? -1 : 1; }
+  return a[1] < b[1] ? -1 : a[1] > b[1];
+}
+
+/** Set out to the pairs of a and of b (unless null), sorted. */
+static CjError setSorted(const CjIntTuples* a, const CjIntTuples* b, CjIntTuples* out) {
+  const long long n = (long long) a->size + (b ? b->size : 0);
+  if (n > INT_MAX) { return CJ_ERROR_ARG; }
+  CjError stat = cjIntTuplesAlloc((int) n, 2, out);
+  if (stat != CJ_ERROR_OK) { return stat; }
+  if (a->size > 0) { memcpy(out->data, a->data, sizeof(int) * 2 * (size_t) a->size); }
+  if (b && b->size > 0) { memcpy(out->data + 2 * (size_t) a->size, b->data, sizeof(int) * 2 * (size_t) b->size); }
+  if ((stat = cjIntTuplesSortUnique(out)) != CJ_ERROR_OK) { cjIntTuplesFree(out); }
+  return stat;
+}
+
+/** setCombine() by sorting the pairs: the cost is about that of the sort. */
+static CjError setMerge(const CjIntTuples* a, const CjIntTuples* b, int op, CjIntTuples* out) {
+  if (op == SET_UNION) { return setSorted(a, b, out); }
+  CjIntTuples sortedB = cjIntTuplesInit();
+  CjError stat;
+  if ((stat = setSorted(a, NULL, out)) != CJ_ERROR_OK) { return stat; }
+  if ((stat = setSorted(b, NULL, &sortedB)) != CJ_ERROR_OK) {
+    cjIntTuplesFree(out);
+    return stat;
+  }
+
+  // Keep the pairs of a that are in b for an intersection, not for a
+  // difference.
+  const int* p = sortedB.data;
+  const int* end = sortedB.data + 2 * (size_t) sortedB.size;
+  int n = 0;
+  for (int i = 0; i < out->size; ++i) {
+    const int* pair = out->data + 2 * (size_t) i;
+    while (p < end && setPairCompare(p, pair) < 0) { p += 2; }
+    const int inB = p < end && setPairCompare(p, pair) == 0;
+    if (inB == (op == SET_INTERSECTION)) {
+      out->data[2 * n] = pair[0];
+      out->data[2 * n + 1] = pair[1];
+      ++n;
+    }
+  }
+  out->size = n;
+  cjIntTuplesFree(&sortedB);
+  return CJ_ERROR_OK;
+}
+
+static CjError setCombine(const CjIntTuples* a, const CjIntTuples* b, int op, CjIntTuples* out) {
+  if (!setValid(a) || !setValid(b) || !out) { return CJ_ERROR_ARG; }
+  *out = cjIntTuplesInit();
+  out->arity = 2;
+
+  // The range of the result: the pairs of the first input of a difference,
+  // the bounds of both inputs of an intersection, either for a union.
+  int x0 = 0, x1 = 0, y0 = 0, y1 = 0, bx0 = 0, bx1 = 0, by0 = 0, by1 = 0;
+  const int hasA = setBounds(a, &x0, &x1, &y0, &y1);
+  const int hasB = setBounds(b, &bx0, &bx1, &by0, &by1);
+  if (op == SET_UNION && !hasA) {
+    if (!hasB) { return CJ_ERROR_OK; }
+    x0 = bx0; x1 = bx1; y0 = by0; y1 = by1;
+  }
+  else if (!hasA || (op == SET_INTERSECTION && !hasB)) {
+    return CJ_ERROR_OK;
+  }
+  else if (op == SET_UNION && hasB) {
+    if (bx0 < x0) { x0 = bx0; }
+    if (bx1 > x1) { x1 = bx1; }
+    if (by0 < y0) { y0 = by0; }
+    if (by1 > y1) { y1 = by1; }
+  }
+  else if (op == SET_INTERSECTION) {
+    if (bx0 > x0) { x0 = bx0; }
+    if (bx1 < x1) { x1 = bx1; }
+    if (by0 > y0) { y0 = by0; }
+    if (by1 < y1) { y1 = by1; }
+    if (x0 > x1 || y0 > y1) { return CJ_ERROR_OK; }
+  }
+  if (!setUseMatrix(x0, x1, y0, y1, (long long) a->size + b->size)) {
+    return setMerge(a, b, op, out);
+  }
+
+  CjBitMatrix ma = cjBitMatrixInit();
+  CjBitMatrix mb = cjBitMatrixInit();
+  CjError stat;
+  if ((stat = setMatrix(a, x0, x1, y0, y1, &ma)) != CJ_ERROR_OK) { goto done; }
+  if (op == SET_UNION) {
+    cjBitMatrixSetTuples(&ma, b);
+  }
+  else if (hasB) {
+    if ((stat = setMatrix(b, x0, x1, y0, y1, &mb)) != CJ_ERROR_OK) { goto done; }
+    const size_t words = (size_t) ma.rows * ma.rowWords;
+    if (op == SET_INTERSECTION) {
+      for (size_t i = 0; i < words; ++i) { ma.bits[i] &= mb.bits[i]; }
+    }
+    else {
+      for (size_t i = 0; i < words; ++i) { ma.bits[i] &= ~mb.bits[i]; }
+    }
+  }
+  stat = cjBitMatrixTuples(&ma, out);
+
+done:
+  cjBitMatrixFree(&ma);
+  cjBitMatrixFree(&mb);
+  return stat;
+}
+
+CjError cjIntTuplesUnion(const CjIntTuples* a, const CjIntTuples* b, CjIntTuples* out) {
+  return setCombine(a, b, SET_UNION, out);
+}
+
+CjError cjIntTuplesIntersection(const CjIntTuples* a, const CjIntTuples* b, CjIntTuples* out) {
+  return setCombine(a, b, SET_INTERSECTION, out);
+}
+
+CjError cjIntTuplesDifference(const CjIntTuples* a, const CjIntTuples* b, CjIntTuples* out) {
+  return setCombine(a, b, SET_DIFFERENCE, out);
+}
+
+/** Set out to the count values of dom (see cjDomainCount()), sorted. */
+static CjError setDomainValues(const CjDomain* dom, long long count, CjIntTuples* out) {
+  if (count > INT_MAX) { return CJ_ERROR_ARG; }
+  CjError stat = cjIntTuplesAlloc((int) count, -1, out);
+  if (stat != CJ_ERROR_OK) { return stat; }
+  if (dom->type == CJ_DOMAIN_VALUES) {
+    if (count > 0) { memcpy(out->data, dom->values.data, sizeof(int) * (size_t) count); }
+  }
+  else {
+    int n = 0;
+    for (int i = 0; i < dom->intervals.size; ++i) {
+      for (long long v = dom->intervals.data[2 * i]; v <= dom->intervals.data[2 * i + 1] && n < count; ++v) {
+        out->data[n++] = (int) v;
+      }
+    }
+  }
+  if ((stat = cjIntTuplesSortUnique(out)) != CJ_ERROR_OK) { cjIntTuplesFree(out); }
+  return stat;
+}
+
+/**
+ * Count the pairs of the values xs by the values ys that are not in a, all
+ * of them sorted, and write them to out unless it is null.
+ */
+static long long setComplementMerge(
+  const CjIntTuples* a, const CjIntTuples* xs, const CjIntTuples* ys, int* out)
+{
+  const int* p = a->data;
+  const int* end = a->data + 2 * (size_t) a->size;
+  long long n = 0;
+  for (int i = 0; i < xs->size; ++i) {
+    for (int j = 0; j < ys->size; ++j) {
+      const int pair[2] = { xs->data[i], ys->data[j] };
+      while (p < end && setPairCompare(p, pair) < 0) { p += 2; }
+      if (p < end && setPairCompare(p, pair) == 0) { continue; }
+      if (out) {
+        out[2 * n] = pair[0];
+        out[2 * n + 1] = pair[1];
+      }
+      ++n;
+    }
+  }
+  return n;
+}
+
+/** cjIntTuplesComplement() by sorting a and the values of the domains. */
+static CjError complementMerge(
+  const CjIntTuples* a, const CjDomain* xs, const CjDomain* ys, long long xCount, long long yCount,
+  CjIntTuples* out)
+{
+  // At most a->size of the pairs of the domains are left out.
+  if (xCount > INT_MAX || yCount > INT_MAX || xCount * yCount - a->size > INT_MAX) { return CJ_ERROR_ARG; }
+  CjIntTuples sorted = cjIntTuplesInit();
+  CjIntTuples xValues = cjIntTuplesInit();
+  CjIntTuples yValues = cjIntTuplesInit();
+  long long n;
+  CjError stat;
+  if ((stat = setSorted(a, NULL, &sorted)) != CJ_ERROR_OK ||
+      (stat = setDomainValues(xs, xCount, &xValues)) != CJ_ERROR_OK ||
+      (stat = setDomainValues(ys, yCount, &yValues)) != CJ_ERROR_OK) {
+    goto done;
+  }
+  n = setComplementMerge(&sorted, &xValues, &yValues, NULL);
+  if ((stat = cjIntTuplesAlloc((int) n, 2, out)) != CJ_ERROR_OK) { goto done; }
+  setComplementMerge(&sorted, &xValues, &yValues, out->data);
+
+done:
+  cjIntTuplesFree(&sorted);
+  cjIntTuplesFree(&xValues);
+  cjIntTuplesFree(&yValues);
+  return stat;
+}
+
+CjError cjIntTuplesComplement(
+  const CjIntTuples* a, const CjDomain* xs, const CjDomain* ys, CjIntTuples* out)
+{
+  if (!setValid(a) || !xs || !ys || !out) { return CJ_ERROR_ARG; }
+  *out = cjIntTuplesInit();
+  out->arity = 2;
+  const long long xCount = cjDomainCount(xs);
+  const long long yCount = cjDomainCount(ys);
+  if (xCount < 0 || yCount < 0) { return CJ_ERROR_ARG; }
+  if (xCount == 0 || yCount == 0) { return CJ_ERROR_OK; }
+
+  int xMin, xMax, yMin, yMax;
+  CjError stat;
+  if ((stat = cjDomainBounds(xs, &xMin, &xMax)) != CJ_ERROR_OK ||
+      (stat = cjDomainBounds(ys, &yMin, &yMax)) != CJ_ERROR_OK) {
+    return stat;
+  }
+  // The pairs of the domains count as inputs, a count can be up to 2^32.
+  const long long pairs = xCount <= INT_MAX && yCount <= INT_MAX ? xCount * yCount : LLONG_MAX / 2;
+  if (!setUseMatrix(xMin, xMax, yMin, yMax, a->size + pairs)) {
+    return complementMerge(a, xs, ys, xCount, yCount, out);
+  }
+
+  CjBitMatrix m = cjBitMatrixInit();
+  CjBitMatrix xMask = cjBitMatrixInit();
+  CjBitMatrix yMask = cjBitMatrixInit();
+  long long n;
+  if ((stat = setMatrix(a, xMin, xMax, yMin, yMax, &m)) != CJ_ERROR_OK ||
+      (stat = cjBitMatrixAlloc(0, 1, xMin, m.rows, &xMask)) != CJ_ERROR_OK ||
+      (stat = cjBitMatrixAlloc(0, 1, yMin, m.cols, &yMask)) != CJ_ERROR_OK) {
+    goto done;
+  }
+  cjBitMatrixMarkDomain(&xMask, 0, xs);
+  cjBitMatrixMarkDomain(&yMask, 0, ys);
+  n = setComplement(&m, &xMask, &yMask, NULL);
+  if (n > INT_MAX) {
+    stat = CJ_ERROR_ARG;
+    goto done;
+  }
+  if ((stat = cjIntTuplesAlloc((int) n, 2, out)) != CJ_ERROR_OK) { goto done; }
+  setComplement(&m, &xMask, &yMask, out->data);
+
+done:
+  cjBitMatrixFree(&m);
+  cjBitMatrixFree(&xMask);
+  cjBitMatrixFree(&yMask);
+  return stat;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Encodings
+//
+
+/** Widen [*min, *max] to hold the bounds of dom. */
+static CjError encodeBounds(const CjDomain* dom, int* found, int* min, int* max) {
+  int domMin, domMax;
+  CjError stat = cjDomainBounds(dom, &domMin, &domMax);
+  if (stat != CJ_ERROR_OK) { return stat; }
+  if (!*found || domMin < *min) { *min = domMin; }
+  if (!*found || domMax > *max) { *max = domMax; }
+  return CJ_ERROR_OK;
+}
+
+/** Swap def iDef of csp to its complement if that has fewer tuples. */
+static CjError encodeDef(CjCsp* csp, int iDef) {
+  CjConstraintDef* def = &csp->constraintDefs[iDef];
+  if (def->type == CJ_CONSTRAINT_DEF_LAZY) { return CJ_ERROR_ARG; }
+  if (def->type != CJ_CONSTRAINT_DEF_NO_GOODS && def->type != CJ_CONSTRAINT_DEF_GOODS) { return CJ_ERROR_OK; }
+  CjIntTuples* tuples = def->type == CJ_CONSTRAINT_DEF_NO_GOODS ? &def->noGoods : &def->goods;
+  if (tuples->arity != 2) { return CJ_ERROR_OK; }
+
+  // The values each side of the def can take, over all of its constraints.
+  int found = 0, xMin = 0, xMax = 0, yMin = 0, yMax = 0;
+  CjError stat = CJ_ERROR_OK;
+  for (int iC = 0; iC < csp->constraintsSize; ++iC) {
+    const CjConstraint* c = &csp->constraints[iC];
+    if (c->id != iDef || c->vars.size != 2) { continue; }
+    if ((stat = encodeBounds(&csp->domains[csp->vars.data[c->vars.data[0]]], &found, &xMin, &xMax)) != CJ_ERROR_OK ||
+        (stat = encodeBounds(&csp->domains[csp->vars.data[c->vars.data[1]]], &found, &yMin, &yMax)) != CJ_ERROR_OK) {
+      return stat;
+    }
+    found = 1;
+  }
+  if (!found) { return CJ_ERROR_OK; }
+  const long long xSize = (long long) xMax - xMin + 1;
+  const long long ySize = (long long) yMax - yMin + 1;
+  if (!setMatrixFits(xMin, xMax, yMin, yMax)) { return CJ_ERROR_OK; }
+
+  CjBitMatrix m = cjBitMatrixInit();
+  CjBitMatrix xs = cjBitMatrixInit();
+  CjBitMatrix ys = cjBitMatrixInit();
+  CjIntTuples complement = cjIntTuplesInit();
+  long long n;
+  if ((stat = cjBitMatrixAlloc(xMin, (int) xSize, yMin, (int) ySize, &m)) != CJ_ERROR_OK ||
+      (stat = cjBitMatrixAlloc(0, 1, xMin, (int) xSize, &xs)) != CJ_ERROR_OK ||
+      (stat = cjBitMatrixAlloc(0, 1, yMin, (int) ySize, &ys)) != CJ_ERROR_OK) {
+    goto done;
+  }
+  cjBitMatrixSetTuples(&m, tuples);
+  for (int iC = 0; iC < csp->constraintsSize; ++iC) {
+    const CjConstraint* c = &csp->constraints[iC];
+    if (c->id != iDef || c->vars.size != 2) { continue; }
+    cjBitMatrixMarkDomain(&xs, 0, &csp->domains[csp->vars.data[c->vars.data[0]]]);
+    cjBitMatrixMarkDomain(&ys, 0, &csp->domains[csp->vars.data[c->vars.data[1]]]);
+  }
+
+  n = setComplement(&m, &xs, &ys, NULL);
+  if (n >= tuples->size) { goto done; }
+
+  if (csp->borrowed && !csp->arena && !(csp->arena = cjArenaNew(0))) {
+    stat = CJ_ERROR_NOMEM;
+    goto done;
+  }
+  if (csp->arena) {
+    complement.size = (int) n;
+    complement.arity = 2;
+    if (n > 0 && !(complement.data = (int*) cjArenaAlloc(csp->arena, sizeof(int) * 2 * n))) {
+      stat = CJ_ERROR_NOMEM;
+      goto done;
+    }
+  }
+  else if ((stat = cjIntTuplesAlloc((int) n, 2, &complement)) != CJ_ERROR_OK) {
+    goto done;
+  }
+  setComplement(&m, &xs, &ys, complement.data);
+
+  const int wasNoGoods = def->type == CJ_CONSTRAINT_DEF_NO_GOODS;
+  if (!csp->arena) { cjConstraintDefFree(def); }
+  if (wasNoGoods) {
+    def->type = CJ_CONSTRAINT_DEF_GOODS;
+    def->goods = complement;
+  }
+  else {
+    def->type = CJ_CONSTRAINT_DEF_NO_GOODS;
+    def->noGoods = complement;
+  }
+
+done:
+  cjBitMatrixFree(&m);
+  cjBitMatrixFree(&xs);
+  cjBitMatrixFree(&ys);
+  return stat;
+}
+
+CjError cjCspEncodeSmallest(CjCsp* csp) {
+  if (!csp) { return CJ_ERROR_ARG; }
+  CjError stat = cjCspValidate(csp);
+  if (stat != CJ_ERROR_OK) { return stat; }
+  for (int iDef = 0; iDef < csp->constraintDefsSize; ++iDef) {
+    if ((stat = encodeDef(csp, iDef)) != CJ_ERROR_OK) { return stat; }
+  }
+  return CJ_ERROR_OK;
+}
@@ -1,6 +1,8 @@
 #include <assert.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "cj-csp.h"
 
@@ -90,11 +92,29 @@ CjError cjDomainValuesAlloc(int size, CjDomain* out) {
   return CJ_ERROR_OK;
 }
 
+CjError cjDomainIntervalsAlloc(int size, CjDomain* out) {
+  if (!out) { return CJ_ERROR_ARG; }
+  const int arity = 2;
+  out->type = CJ_DOMAIN_INTERVALS;
+  int stat = cjIntTuplesAlloc(size, arity, &out->intervals);
+  if (stat != CJ_ERROR_OK) {
+    *out = cjDomainInit();
+    return stat;
+  }
+  return CJ_ERROR_OK;
+}
+
 void cjDomainFree(CjDomain* inout) {
   if (!inout) { return; }
   switch (inout->type) {
+    case CJ_DOMAIN_UNDEF:
+      break;
     case CJ_DOMAIN_VALUES:
       cjIntTuplesFree(&inout->values);
+      break;
+    case CJ_DOMAIN_INTERVALS:
+      cjIntTuplesFree(&inout->intervals);
+      break;
     default:
       assert(0);
       break;
@@ -102,6 +122,41 @@ void cjDomainFree(CjDomain* inout) {
   inout->type = CJ_DOMAIN_UNDEF;
 }
 
+CjError cjDomainBounds(const CjDomain* domain, int* min, int* max) {
+  if (!domain || !min || !max) { return CJ_ERROR_ARG; }
+  if (domain->type == CJ_DOMAIN_INTERVALS) {
+    const CjIntTuples* xs = &domain->intervals;
+    if (xs->arity != 2 || xs->size <= 0) { return CJ_ERROR_ARG; }
+    *min = xs->data[0];
+    *max = xs->data[2 * xs->size - 1];
+    return CJ_ERROR_OK;
+  }
+  if (domain->type != CJ_DOMAIN_VALUES || domain->values.size <= 0) { return CJ_ERROR_ARG; }
+  *min = *max = domain->values.data[0];
+  for (int i = 1; i < domain->values.size; ++i) {
+    if (domain->values.data[i] < *min) { *min = domain->values.data[i]; }
+    if (domain->values.data[i] > *max) { *max = domain->values.data[i]; }
+  }
+  return CJ_ERROR_OK;
+}
+
+long long cjDomainCount(const CjDomain* domain) {
+  if (!domain) { return -1; }
+  switch (domain->type) {
+    case CJ_DOMAIN_VALUES:
+      return domain->values.size;
+    case CJ_DOMAIN_INTERVALS: {
+      long long count = 0;
+      for (int i = 0; i < domain->intervals.size; ++i) {
+        count += (long long) domain->intervals.data[2 * i + 1] - domain->intervals.data[2 * i] + 1;
+      }
+      return count;
+    }
+    default:
+      return -1;
+  }
+}
+
 CjDomain* cjDomainArray(int size) {
   CjDomain* xs = (CjDomain*) malloc(sizeof(CjDomain) * size);
   if (!xs) { return NULL; }
@@ -135,15 +190,32 @@ CjError cjConstraintDefNoGoodAlloc(int arity, int size, CjConstraintDef* out) {
   return CJ_ERROR_OK;
 }
 
+CjError cjConstraintDefGoodAlloc(int arity, int size, CjConstraintDef* out) {
+  if (!out) { return CJ_ERROR_ARG; }
+  out->type = CJ_CONSTRAINT_DEF_GOODS;
+  int stat = cjIntTuplesAlloc(size, arity, &out->goods);
+  if (stat != CJ_ERROR_OK) { return stat; }
+  return CJ_ERROR_OK;
+}
+
 void cjConstraintDefFree(CjConstraintDef* inout) {
   if (!inout) { return; }
   switch (inout->type) {
+    case CJ_CONSTRAINT_DEF_UNDEF:
+      break;
     case CJ_CONSTRAINT_DEF_NO_GOODS:
       cjIntTuplesFree(&inout->noGoods);
+      break;
+    case CJ_CONSTRAINT_DEF_GOODS:
+      cjIntTuplesFree(&inout->goods);
+      break;
+    case CJ_CONSTRAINT_DEF_LAZY:
+      break;
     default:
       assert(0);
       break;
   }
+  inout->type = CJ_CONSTRAINT_DEF_UNDEF;
 }
 
 CjConstraintDef* cjConstraintDefArray(int size) {
@@ -206,6 +278,161 @@ void cjConstraintArrayFree(CjConstraint** inout, int size) {
   *inout = NULL;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// CjArena
+//
+
+/** A block of arena memory. The data follows the (padded) header. */
+typedef struct CjArenaBlock {
+  struct CjArenaBlock* next;
+  size_t size;
+} CjArenaBlock;
+
+#define CJ_ARENA_ALIGN ((size_t) 16)
+#define CJ_ARENA_HEADER ((sizeof(CjArenaBlock) + CJ_ARENA_ALIGN - 1) & ~(CJ_ARENA_ALIGN - 1))
+/** Blocks double in size up to this. */
+#define CJ_ARENA_MAX_BLOCK ((size_t) 1 << 20)
+
+struct CjArena {
+  /** Blocks shared by small allocations, the current one first. */
+  CjArenaBlock* blocks;
+  /** Blocks of a single large allocation each, the newest first. */
+  CjArenaBlock* large;
+  /** Blocks moved in by cjArenaMerge(), only kept to be freed. */
+  CjArenaBlock* merged;
+  /** The free space of the current block. */
+  char* cur;
+  char* end;
+  /** The most recent small allocation, it can grow in place. */
+  char* last;
+  /** The size of the next block. */
+  size_t blockSize;
+};
+
+static size_t arenaRound(size_t size) {
+  return (size + CJ_ARENA_ALIGN - 1) & ~(CJ_ARENA_ALIGN - 1);
+}
+
+static char* arenaBlockData(CjArenaBlock* b) {
+  return (char*) b + CJ_ARENA_HEADER;
+}
+
+static CjArenaBlock* arenaBlockNew(size_t size, CjArenaBlock** list) {
+  CjArenaBlock* b = (CjArenaBlock*) malloc(CJ_ARENA_HEADER + size);
+  if (!b) { return NULL; }
+  b->size = size;
+  b->next = *list;
+  *list = b;
+  return b;
+}
+
+static void arenaBlocksFree(CjArenaBlock* b) {
+  while (b) {
+    CjArenaBlock* next = b->next;
+    free(b);
+    b = next;
+  }
+}
+
+/** Put the blocks of list in front of *into. */
+static void arenaBlocksAppend(CjArenaBlock** into, CjArenaBlock* list) {
+  if (!list) { return; }
+  CjArenaBlock* tail = list;
+  while (tail->next) { tail = tail->next; }
+  tail->next = *into;
+  *into = list;
+}
+
+static size_t arenaBlocksSize(const CjArenaBlock* b) {
+  size_t size = 0;
+  for (; b; b = b->next) { size += b->size; }
+  return size;
+}
+
+CjArena* cjArenaNew(size_t blockSize) {
+  CjArena* arena = (CjArena*) malloc(sizeof(CjArena));
+  if (!arena) { return NULL; }
+  arena->blocks = NULL;
+  arena->large = NULL;
+  arena->merged = NULL;
+  arena->cur = NULL;
+  arena->end = NULL;
+  arena->last = NULL;
+  arena->blockSize = blockSize ? arenaRound(blockSize) : (size_t) 1 << 16;
+  return arena;
+}
+
+void* cjArenaAlloc(CjArena* arena, size_t size) {
+  if (!arena) { return NULL; }
+  size = arenaRound(size);
+  if (size > (size_t) (arena->end - arena->cur)) {
+    // Large allocations get a block of their own, so that the current block
+    // keeps its free space and they can grow with realloc().
+    if (size > arena->blockSize / 4) {
+      CjArenaBlock* b = arenaBlockNew(size, &arena->large);
+      return b ? arenaBlockData(b) : NULL;
+    }
+    CjArenaBlock* b = arenaBlockNew(arena->blockSize, &arena->blocks);
+    if (!b) { return NULL; }
+    arena->cur = arenaBlockData(b);
+    arena->end = arena->cur + b->size;
+    if (arena->blockSize < CJ_ARENA_MAX_BLOCK) { arena->blockSize *= 2; }
+  }
+  arena->last = arena->cur;
+  arena->cur += size;
+  return arena->last;
+}
+
+void* cjArenaRealloc(CjArena* arena, void* p, size_t oldSize, size_t newSize) {
+  if (!arena) { return NULL; }
+  if (!p) { return cjArenaAlloc(arena, newSize); }
+
+  // The most recent small allocation ends at cur.
+  if ((char*) p == arena->last && arenaRound(newSize) <= (size_t) (arena->end - arena->last)) {
+    arena->cur = arena->last + arenaRound(newSize);
+    return p;
+  }
+  // The newest large allocation is the only one in its block.
+  if (arena->large && (char*) p == arenaBlockData(arena->large)) {
+    CjArenaBlock* b = (CjArenaBlock*) realloc(arena->large, CJ_ARENA_HEADER + arenaRound(newSize));
+    if (!b) { return NULL; }
+    b->size = arenaRound(newSize);
+    arena->large = b;
+    return arenaBlockData(b);
+  }
+
+  if (newSize <= oldSize) { return p; }
+  void* grown = cjArenaAlloc(arena, newSize);
+  if (!grown) { return NULL; }
+  memcpy(grown, p, oldSize);
+  return grown;
+}
+
+void cjArenaMerge(CjArena* into, CjArena** from) {
+  if (!into || !from || !(*from)) { return; }
+  arenaBlocksAppend(&into->merged, (*from)->blocks);
+  arenaBlocksAppend(&into->merged, (*from)->large);
+  arenaBlocksAppend(&into->merged, (*from)->merged);
+  free(*from);
+  *from = NULL;
+}
+
+size_t cjArenaCapacity(const CjArena* arena) {
+  if (!arena) { return 0; }
+  return arenaBlocksSize(arena->blocks) + arenaBlocksSize(arena->large) +
+         arenaBlocksSize(arena->merged);
+}
+
+void cjArenaFree(CjArena** inout) {
+  if (!inout) { return; }
+  if (!(*inout)) { return; }
+  arenaBlocksFree((*inout)->blocks);
+  arenaBlocksFree((*inout)->large);
+  arenaBlocksFree((*inout)->merged);
+  free(*inout);
+  *inout = NULL;
+}
+
 CjCsp cjCspInit() {
   CjCsp x;
 
@@ -222,13 +449,32 @@ CjCsp cjCspInit() {
   x.constraintsSize = 0;
   x.constraints = NULL;
 
+  x.borrowed = NULL;
+  x.arena = NULL;
+
   return x;
 }
 
 void cjCspFree(CjCsp* inout) {
   if (!inout) { return; }
+  if (inout->borrowed) {
+    // Only the arrays of structs are allocated, and replaced tuples if any.
+    free(inout->domains);
+    free(inout->constraintDefs);
+    free(inout->constraints);
+    cjArenaFree(&inout->arena);
+    *inout = cjCspInit();
+    return;
+  }
+  if (inout->arena) {
+    // Everything is in the arena.
+    cjArenaFree(&inout->arena);
+    *inout = cjCspInit();
+    return;
+  }
   cjMetaFree(&inout->meta);
   cjDomainArrayFree(&inout->domains, inout->domainsSize);
+  cjIntTuplesFree(&inout->vars);
   cjConstraintDefArrayFree(&inout->constraintDefs, inout->constraintDefsSize);
   cjConstraintArrayFree(&inout->constraints, inout->constraintsSize);
   *inout = cjCspInit();
@@ -242,6 +488,14 @@ CjError cjCspValidate(const CjCsp* csp) {
   for (int iDom = 0; iDom < csp->domainsSize; ++iDom) {
     if (csp->domains[iDom].type <= CJ_DOMAIN_UNDEF) { return CJ_ERROR_VALIDATION_DOMAINS_TYPE; }
     if (csp->domains[iDom].type >= CJ_DOMAIN_SIZE) { return CJ_ERROR_VALIDATION_DOMAINS_TYPE; }
+    if (csp->domains[iDom].type == CJ_DOMAIN_INTERVALS) {
+      const CjIntTuples* xs = &csp->domains[iDom].intervals;
+      if (xs->arity != 2 || xs->size <= 0) { return CJ_ERROR_VALIDATION_DOMAIN_INTERVALS; }
+      for (int i = 0; i < xs->size; ++i) {
+        if (xs->data[2 * i] > xs->data[2 * i + 1]) { return CJ_ERROR_VALIDATION_DOMAIN_INTERVALS; }
+        if (i > 0 && xs->data[2 * i] <= xs->data[2 * i - 1]) { return CJ_ERROR_VALIDATION_DOMAIN_INTERVALS; }
+      }
+    }
   }
 
   // Check vars
@@ -274,3 +528,365 @@ CjError cjCspValidate(const CjCsp* csp) {
 
   return CJ_ERROR_OK;
 }
+
+////////////////////////////////////////////////////////////////////////////////
+// CjIntTuples sorting
+//
+// Tuples are sorted lexicographically. When the value ranges of the columns
+// fit 64 bits together, each tuple is packed into one key (first column in
+// the high bits) and the keys are sorted with an LSD radix sort, 8 bits a
+// pass, then unpacked. Otherwise the tuples are merge sorted by index.
+//
+
+static const CjIntTuples* defTuples(const CjConstraintDef* def) {
+  if (def->type == CJ_CONSTRAINT_DEF_NO_GOODS) { return &def->noGoods; }
+  if (def->type == CJ_CONSTRAINT_DEF_GOODS) { return &def->goods; }
+  return NULL;
+}
+
+static int tuplesArity(const CjIntTuples* ts) {
+  return ts->arity < 0 ? 1 : ts->arity;
+}
+
+static int tuplesCompare(const int* a, const int* b, int arity) {
+  for (int k = 0; k < arity; ++k) {
+    if (a[k] != b[k]) { return a[k] < b[k] ? -1 : 1; }
+  }
+  return 0;
+}
+
+/** Set order to the indices of the tuples of ts in sorted order (a merge sort). */
+static CjError tuplesSortOrder(const CjIntTuples* ts, int* order) {
+  const int n = ts->size;
+  const int arity = tuplesArity(ts);
+  for (int i = 0; i < n; ++i) { order[i] = i; }
+  if (n < 2) { return CJ_ERROR_OK; }
+  int* tmp = (int*) malloc(sizeof(int) * n);
+  if (!tmp) { return CJ_ERROR_NOMEM; }
+  int* from = order;
+  int* to = tmp;
+  for (int width = 1; width < n; width *= 2) {
+    for (int lo = 0; lo < n; lo += 2 * width) {
+      const int mid = lo + width < n ? lo + width : n;
+      const int hi = lo + 2 * width < n ? lo + 2 * width : n;
+      int i = lo, j = mid, k = lo;
+      while (i < mid && j < hi) {
+        const int* a = ts->data + (size_t) from[i] * arity;
+        const int* b = ts->data + (size_t) from[j] * arity;
+        to[k++] = tuplesCompare(b, a, arity) < 0 ? from[j++] : from[i++];
+      }
+      while (i < mid) { to[k++] = from[i++]; }
+      while (j < hi) { to[k++] = from[j++]; }
+    }
+    int* swap = from;
+    from = to;
+    to = swap;
+  }
+  if (from != order) { memcpy(order, from, sizeof(int) * n); }
+  free(tmp);
+  return CJ_ERROR_OK;
+}
+
+/** 1 if the tuples of ts are in strictly increasing order. */
+static int tuplesSortedUnique(const CjIntTuples* ts) {
+  const int arity = tuplesArity(ts);
+  for (int i = 1; i < ts->size; ++i) {
+    const int* prev = ts->data + (size_t) (i - 1) * arity;
+    if (tuplesCompare(prev, prev + arity, arity) >= 0) { return 0; }
+  }
+  return 1;
+}
+
+/** Sort n keys on their low bits bits, tmp has room for n keys. */
+static void tuplesRadixSort(uint64_t* keys, uint64_t* tmp, int n, int bits) {
+  size_t counts[256];
+  uint64_t* from = keys;
+  uint64_t* to = tmp;
+  for (int shift = 0; shift < bits; shift += 8) {
+    memset(counts, 0, sizeof(counts));
+    for (int i = 0; i < n; ++i) { ++counts[(from[i] >> shift) & 0xff]; }
+    // Nothing moves if every key has the same digit.
+    if (counts[(from[0] >> shift) & 0xff] == (size_t) n) { continue; }
+    size_t sum = 0;
+    for (int d = 0; d < 256; ++d) {
+      const size_t count = counts[d];
+      counts[d] = sum;
+      sum += count;
+    }
+    for (int i = 0; i < n; ++i) { to[counts[(from[i] >> shift) & 0xff]++] = from[i]; }
+    uint64_t* swap = from;
+    from = to;
+    to = swap;
+  }
+  if (from != keys) { memcpy(keys, from, sizeof(uint64_t) * n); }
+}
+
+/** cjIntTuplesSortUnique() by packed keys, shifts[k] and bits[k] place column k. */
+static CjError tuplesSortUniquePacked(
+  CjIntTuples* inout, const int* mins, const int* shifts, const int* bits, int totalBits)
+{
+  const int n = inout->size;
+  const int arity = tuplesArity(inout);
+  uint64_t* keys = (uint64_t*) malloc(sizeof(uint64_t) * 2 * n);
+  if (!keys) { return CJ_ERROR_NOMEM; }
+  for (int i = 0; i < n; ++i) {
+    const int* t = inout->data + (size_t) i * arity;
+    uint64_t key = 0;
+    for (int k = 0; k < arity; ++k) {
+      if (bits[k] > 0) { key |= (uint64_t) ((long long) t[k] - mins[k]) << shifts[k]; }
+    }
+    keys[i] = key;
+  }
+  tuplesRadixSort(keys, keys + n, n, totalBits);
+
+  int size = 0;
+  for (int i = 0; i < n; ++i) {
+    if (i > 0 && keys[i] == keys[i - 1]) { continue; }
+    int* t = inout->data + (size_t) size++ * arity;
+    for (int k = 0; k < arity; ++k) {
+      const uint64_t mask = bits[k] > 0 ? ((uint64_t) 1 << bits[k]) - 1 : 0;
+      t[k] = (int) ((long long) mins[k] + (long long) ((keys[i] >> shifts[k]) & mask));
+    }
+  }
+  inout->size = size;
+  free(keys);
+  return CJ_ERROR_OK;
+}
+
+/** cjIntTuplesSortUnique() by a sorted order of indices. */
+static CjError tuplesSortUniqueMerge(CjIntTuples* inout) {
+  const int n = inout->size;
+  const int arity = tuplesArity(inout);
+  CjError err = CJ_ERROR_NOMEM;
+  int* order = (int*) malloc(sizeof(int) * n);
+  int* sorted = (int*) malloc(sizeof(int) * n * (size_t) arity);
+  if (!order || !sorted) { goto done; }
+  if ((err = tuplesSortOrder(inout, order)) != CJ_ERROR_OK) { goto done; }
+
+  int size = 0;
+  for (int i = 0; i < n; ++i) {
+    const int* t = inout->data + (size_t) order[i] * arity;
+    if (size > 0 && tuplesCompare(sorted + (size_t) (size - 1) * arity, t, arity) == 0) { continue; }
+    memcpy(sorted + (size_t) size++ * arity, t, sizeof(int) * arity);
+  }
+  memcpy(inout->data, sorted, sizeof(int) * size * (size_t) arity);
+  inout->size = size;
+
+done:
+  free(order);
+  free(sorted);
+  return err;
+}
+
+CjError cjIntTuplesSortUnique(CjIntTuples* inout) {
+  if (!inout || inout->size < 0 || inout->arity < -1) { return CJ_ERROR_ARG; }
+  const int arity = tuplesArity(inout);
+  if (inout->size < 2) { return CJ_ERROR_OK; }
+  if (arity == 0) {
+    inout->size = 1;
+    return CJ_ERROR_OK;
+  }
+  if (tuplesSortedUnique(inout)) { return CJ_ERROR_OK; }
+
+  // The columns from last to first take the bits of their range of values.
+  CjError err = CJ_ERROR_NOMEM;
+  int* mins = (int*) malloc(sizeof(int) * 3 * arity);
+  if (!mins) { return err; }
+  int* shifts = mins + arity;
+  int* bits = shifts + arity;
+  int totalBits = 0;
+  for (int k = arity - 1; k >= 0; --k) {
+    int lo = inout->data[k];
+    int hi = lo;
+    for (int i = 1; i < inout->size; ++i) {
+      const int v = inout->data[(size_t) i * arity + k];
+      if (v < lo) { lo = v; }
+      if (v > hi) { hi = v; }
+    }
+    const unsigned long long span = (unsigned long long) ((long long) hi - lo);
+    mins[k] = lo;
+    bits[k] = 0;
+    while (bits[k] < 64 && (span >> bits[k]) != 0) { ++bits[k]; }
+    shifts[k] = totalBits < 64 ? totalBits : 0;
+    totalBits += bits[k];
+  }
+  err = totalBits <= 64
+    ? tuplesSortUniquePacked(inout, mins, shifts, bits, totalBits)
+    : tuplesSortUniqueMerge(inout);
+  free(mins);
+  return err;
+}
+
+int cjIntTuplesContains(const CjIntTuples* tuples, const int* tuple) {
+  const int arity = tuplesArity(tuples);
+  int lo = 0, hi = tuples->size;
+  while (lo < hi) {
+    const int mid = lo + (hi - lo) / 2;
+    const int c = tuplesCompare(tuples->data + (size_t) mid * arity, tuple, arity);
+    if (c == 0) { return 1; }
+    if (c < 0) { lo = mid + 1; }
+    else { hi = mid; }
+  }
+  return 0;
+}
+
+CjError cjCspSortUniqueConstraintDefs(CjCsp* csp) {
+  if (!csp) { return CJ_ERROR_ARG; }
+  for (int i = 0; i < csp->constraintDefsSize; ++i) {
+    if (!defTuples(&csp->constraintDefs[i])) { return CJ_ERROR_ARG; }
+  }
+  for (int i = 0; i < csp->constraintDefsSize; ++i) {
+    CjIntTuples* ts = (CjIntTuples*) defTuples(&csp->constraintDefs[i]);
+    if (ts->size < 2 || tuplesSortedUnique(ts)) { continue; }
+    // The tuples of a borrowed csp point into its (read only) buffer, sort
+    // a copy in the arena.
+    if (csp->borrowed) {
+      if (!csp->arena && !(csp->arena = cjArenaNew(0))) { return CJ_ERROR_NOMEM; }
+      const size_t bytes = sizeof(int) * ts->size * (size_t) tuplesArity(ts);
+      int* data = (int*) cjArenaAlloc(csp->arena, bytes);
+      if (!data) { return CJ_ERROR_NOMEM; }
+      memcpy(data, ts->data, bytes);
+      ts->data = data;
+    }
+    CjError err;
+    if ((err = cjIntTuplesSortUnique(ts)) != CJ_ERROR_OK) { return err; }
+  }
+  return CJ_ERROR_OK;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// cjCspDedupConstraintDefs
+//
+// Each def is hashed as the sum of the hashes of its tuples, which doesn't
+// depend on their order, into an open addressing table. Defs with the same
+// hash are compared tuple by tuple in sorted order. The order is sorted
+// indices (see tuplesSortOrder()), so the tuple data is never written (it
+// may be borrowed).
+//
+
+static uint64_t dedupMix(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+static uint64_t dedupHash(const CjConstraintDef* def) {
+  const CjIntTuples* ts = defTuples(def);
+  const int arity = tuplesArity(ts);
+  uint64_t sum = 0;
+  for (int i = 0; i < ts->size; ++i) {
+    uint64_t h = (uint64_t) arity;
+    for (int k = 0; k < arity; ++k) {
+      h = dedupMix(h ^ (uint32_t) ts->data[(size_t) i * arity + k]);
+    }
+    sum += dedupMix(h);
+  }
+  return dedupMix(sum ^ ((uint64_t) def->type << 32) ^ (uint64_t) ts->size ^ ((uint64_t) arity << 48));
+}
+
+/**
+ * 1 if defs a and b list the same tuples, 0 otherwise. orders[i] is the
+ * sorted order of def i, made on first use.
+ */
+static int dedupEqual(const CjCsp* csp, int a, int b, int** orders, CjError* err) {
+  const CjConstraintDef* defs[2] = {&csp->constraintDefs[a], &csp->constraintDefs[b]};
+  const CjIntTuples* ts[2] = {defTuples(defs[0]), defTuples(defs[1])};
+  if (defs[0]->type != defs[1]->type || ts[0]->size != ts[1]->size) { return 0; }
+  if (ts[0]->size == 0) { return 1; }
+  if (ts[0]->arity != ts[1]->arity) { return 0; }
+
+  const int ids[2] = {a, b};
+  for (int i = 0; i < 2; ++i) {
+    if (orders[ids[i]]) { continue; }
+    if (!(orders[ids[i]] = (int*) malloc(sizeof(int) * ts[i]->size)) ||
+        (*err = tuplesSortOrder(ts[i], orders[ids[i]])) != CJ_ERROR_OK) {
+      if (*err == CJ_ERROR_OK) { *err = CJ_ERROR_NOMEM; }
+      return 0;
+    }
+  }
+  const int arity = tuplesArity(ts[0]);
+  for (int i = 0; i < ts[0]->size; ++i) {
+    const int* x = ts[0]->data + (size_t) orders[a][i] * arity;
+    const int* y = ts[1]->data + (size_t) orders[b][i] * arity;
+    if (tuplesCompare(x, y, arity) != 0) { return 0; }
+  }
+  return 1;
+}
+
+CjError cjCspDedupConstraintDefs(CjCsp* csp, int* numMerged) {
+  if (!csp) { return CJ_ERROR_ARG; }
+  if (numMerged) { *numMerged = 0; }
+  const int n = csp->constraintDefsSize;
+  for (int i = 0; i < n; ++i) {
+    if (!defTuples(&csp->constraintDefs[i])) { return CJ_ERROR_ARG; }
+  }
+  for (int i = 0; i < csp->constraintsSize; ++i) {
+    if (csp->constraints[i].id < 0 || csp->constraints[i].id >= n) { return CJ_ERROR_ARG; }
+  }
+  if (n < 2) { return CJ_ERROR_OK; }
+
+  int tableSize = 4;
+  while (tableSize < 2 * n) { tableSize *= 2; }
+  CjError err = CJ_ERROR_NOMEM;
+  int* table = (int*) malloc(sizeof(int) * tableSize);
+  uint64_t* hashes = (uint64_t*) malloc(sizeof(uint64_t) * n);
+  int* survivor = (int*) malloc(sizeof(int) * n);
+  int** orders = (int**) calloc(n, sizeof(int*));
+  if (!table || !hashes || !survivor || !orders) { goto done; }
+  for (int i = 0; i < tableSize; ++i) { table[i] = -1; }
+
+  // survivor[i] is the def that def i is merged into, i if none.
+  err = CJ_ERROR_OK;
+  for (int i = 0; i < n; ++i) {
+    hashes[i] = dedupHash(&csp->constraintDefs[i]);
+    survivor[i] = i;
+    int slot = (int) (hashes[i] & (uint64_t) (tableSize - 1));
+    for (; table[slot] >= 0; slot = (slot + 1) & (tableSize - 1)) {
+      const int j = table[slot];
+      if (hashes[j] == hashes[i] && dedupEqual(csp, j, i, orders, &err)) {
+        survivor[i] = j;
+        break;
+      }
+      if (err != CJ_ERROR_OK) { goto done; }
+    }
+    if (survivor[i] == i) { table[slot] = i; }
+    // The order of a def is only needed again if it survives.
+    if (survivor[i] != i) {
+      free(orders[i]);
+      orders[i] = NULL;
+    }
+  }
+
+  // Compact the survivors, survivor[i] becomes the new index of def i.
+  int numDefs = 0;
+  for (int i = 0; i < n; ++i) {
+    if (survivor[i] == i) {
+      csp->constraintDefs[numDefs] = csp->constraintDefs[i];
+      survivor[i] = numDefs++;
+    }
+    else {
+      // Tuples of an arena or a borrowed buffer go with the csp.
+      if (!csp->arena && !csp->borrowed) { cjConstraintDefFree(&csp->constraintDefs[i]); }
+      survivor[i] = survivor[survivor[i]];
+    }
+  }
+  for (int i = numDefs; i < n; ++i) { csp->constraintDefs[i] = cjConstraintDefInit(); }
+  csp->constraintDefsSize = numDefs;
+  for (int i = 0; i < csp->constraintsSize; ++i) {
+    csp->constraints[i].id = survivor[csp->constraints[i].id];
+  }
+  if (numMerged) { *numMerged = n - numDefs; }
+
+done:
+  if (orders) {
+    for (int i = 0; i < n; ++i) { free(orders[i]); }
+  }
+  free(orders);
+  free(table);
+  free(hashes);
+  free(survivor);
+  return err;
+}
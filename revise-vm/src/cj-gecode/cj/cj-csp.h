@@ -1,6 +1,8 @@
 #ifndef __CJ_CSP_H__
 #define __CJ_CSP_H__
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -13,13 +15,13 @@ extern "C" {
 typedef enum CjError {
   /** No error. */
   CJ_ERROR_OK = 0,
-  /** JSMN Library: Not enough tokens were provided. */
+  /** JSON syntax: Not enough tokens were provided (no longer returned). */
   CJ_ERROR_JSMN_NOMEM = -1,
-  /** JSMN Library: Invalid character inside JSON string. */
+  /** JSON syntax: Invalid or unexpected character. */
   CJ_ERROR_JSMN_INVAL = -2,
-  /** JSMN Library: The string is not a full JSON packet, more bytes expected */
+  /** JSON syntax: The string is not a full JSON packet, more bytes expected */
   CJ_ERROR_JSMN_PART = -3,
-  /** JSMN Library: Unknown error. */
+  /** JSON syntax: Unknown error. */
   CJ_ERROR_JSMN = -4,
   /** Unknown error. */
   CJ_ERROR = -5,
@@ -41,7 +43,7 @@ typedef enum CjError {
   CJ_ERROR_DOMAINS_IS_NOT_ARRAY = -13,
   /** csp-json.domains[i] is not an object. */
   CJ_ERROR_DOMAIN_IS_NOT_OBJECT = -14,
-  /** csp-json.domains[i] has an unknown type (eg. "values" key is known). */
+  /** csp-json.domains[i] has an unknown type (eg. "values" and "intervals" keys are known). */
   CJ_ERROR_DOMAIN_UNKNOWN_TYPE = -15,
   /** csp-json.domains[i].values is not a JSON array. */
   CJ_ERROR_DOMAIN_VALUES_IS_NOT_ARRAY = -16,
@@ -53,7 +55,7 @@ typedef enum CjError {
   CJ_ERROR_VAR_IS_NOT_INT = -19,
   /** csp-json.constraintDefs is not an array. */
   CJ_CONSTRAINTDEFS_IS_NOT_ARRAY = -20,
-  /** csp-json.constraintDefs[i] is an unknown type (eg. noGoods is known). */
+  /** csp-json.constraintDefs[i] is an unknown type (eg. noGoods and goods are known). */
   CJ_CONSTRAINTDEF_UNKNOWN_TYPE = -21,
   /** csp-json.constraintDefs[i].noGoods is not an array. */
   CJ_ERROR_NOGOODS_IS_NOT_ARRAY = -22,
@@ -97,7 +99,25 @@ typedef enum CjError {
   CJ_ERROR_VALIDATION_CONSTRAINT_ID_RANGE = -45,
   CJ_ERROR_VALIDATION_CONSTRAINT_VARS_ARITY = -46,
   CJ_ERROR_VALIDATION_CONSTRAINT_VARS_SIZE = -47,
-  CJ_ERROR_VALIDATION_CONSTRAINT_VAR_RANGE = -48
+  CJ_ERROR_VALIDATION_CONSTRAINT_VAR_RANGE = -48,
+  /** Not a cj-bin file, or a cj-bin version that is not supported. */
+  CJ_ERROR_BIN_MAGIC = -49,
+  /** cj-bin files are little-endian and this host is not. */
+  CJ_ERROR_BIN_BYTE_ORDER = -50,
+  /** A cj-bin size, offset or type is out of range. */
+  CJ_ERROR_BIN_CORRUPT = -51,
+  /** cj-bin data is misaligned (eg. the buffer is not 4-byte aligned). */
+  CJ_ERROR_BIN_ALIGNMENT = -52,
+  /** Writing a cj-bin file failed. */
+  CJ_ERROR_BIN_WRITE = -53,
+  /** Writing CSP-JSON text failed. */
+  CJ_ERROR_WRITE = -54,
+  /** csp-json.domains[i].intervals is not an array of [min, max] integer pairs. */
+  CJ_ERROR_DOMAIN_INTERVALS_IS_NOT_ARRAY = -55,
+  /** Validation failed because intervals are empty, unsorted or overlapping. */
+  CJ_ERROR_VALIDATION_DOMAIN_INTERVALS = -56,
+  /** csp-json.constraintDefs[i].goods is not an array. */
+  CJ_ERROR_GOODS_IS_NOT_ARRAY = -57
 } CjError;
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -149,6 +169,22 @@ CjIntTuples* cjIntTuplesArray(int size);
 /** (1) free each item (2) free the array (3) set pointer to null. */
 void cjIntTuplesArrayFree(CjIntTuples** inout, int size);
 
+/**
+ * Sort the tuples in increasing lexicographic order and drop the duplicates,
+ * which lowers size (data keeps its allocation). A 1D array is sorted as
+ * tuples of arity 1. Packs each tuple into a 64-bit key and radix sorts the
+ * keys when the value ranges of the columns allow, about linear time.
+ * data needs to be writable, see cjCspSortUniqueConstraintDefs() for a csp.
+ * @return CJ_ERROR_OK on success
+ */
+CjError cjIntTuplesSortUnique(CjIntTuples* inout);
+
+/**
+ * 1 if tuple (arity values) is one of tuples, 0 otherwise, in O(log size).
+ * tuples needs to be sorted, see cjIntTuplesSortUnique().
+ */
+int cjIntTuplesContains(const CjIntTuples* tuples, const int* tuple);
+
 ////////////////////////////////////////////////////////////////////////////////
 // CjMeta
 //
@@ -174,13 +210,19 @@ void cjMetaFree(CjMeta* inout);
 
 /** The Domain of a CSP variable. */
 typedef struct CjDomain {
-  enum {CJ_DOMAIN_UNDEF, CJ_DOMAIN_VALUES, CJ_DOMAIN_SIZE} type;
+  enum {CJ_DOMAIN_UNDEF, CJ_DOMAIN_VALUES, CJ_DOMAIN_INTERVALS, CJ_DOMAIN_SIZE} type;
   union {
     /**
      * Explicitly list the values of the domain, one by one.
      * This union field is only used if type == CJ_DOMAIN_VALUES.
      **/
     CjIntTuples values;
+    /**
+     * List the values of the domain as [min, max] pairs (both inclusive) of
+     * arity 2, in increasing order and without overlaps, eg. [[0, 1023]].
+     * This union field is only used if type == CJ_DOMAIN_INTERVALS.
+     **/
+    CjIntTuples intervals;
   };
 } CjDomain;
 
@@ -193,8 +235,27 @@ CjDomain cjDomainInit();
  * Free the resulting struct with cjDomainFree().
  */
 CjError cjDomainValuesAlloc(int size, CjDomain* out);
+
+/**
+ * Init & allocate a domain of size intervals.
+ * Return 0 on success.
+ * Free the resulting struct with cjDomainFree().
+ */
+CjError cjDomainIntervalsAlloc(int size, CjDomain* out);
 void cjDomainFree(CjDomain* inout);
 
+/**
+ * Set the smallest and the largest value of a domain.
+ * @return CJ_ERROR_ARG if the domain is empty or of an unknown type.
+ */
+CjError cjDomainBounds(const CjDomain* domain, int* min, int* max);
+
+/**
+ * The number of values of a domain, or -1 if it is of an unknown type.
+ * The intervals are expected to be valid (see cjCspValidate).
+ */
+long long cjDomainCount(const CjDomain* domain);
+
 /**
  * Allocate an array of CjDomain and cjDomainInit() each item.
  * @return null on memory allocation error.
@@ -212,6 +273,9 @@ typedef struct CjConstraintDef {
   enum {
     CJ_CONSTRAINT_DEF_UNDEF,
     CJ_CONSTRAINT_DEF_NO_GOODS,
+    CJ_CONSTRAINT_DEF_GOODS,
+    /** Not decoded yet, see cjCspConstraintDefGet(). */
+    CJ_CONSTRAINT_DEF_LAZY,
     CJ_CONSTRAINT_DEF_SIZE
   } type;
 
@@ -221,6 +285,19 @@ typedef struct CjConstraintDef {
      * This union field is used only if type == CJ_CONSTRAINT_DEF_NO_GOODS.
      */
     CjIntTuples noGoods;
+    /**
+     * List the combination of values that are valid, any other is invalid.
+     * This union field is used only if type == CJ_CONSTRAINT_DEF_GOODS.
+     */
+    CjIntTuples goods;
+    /**
+     * The JSON text of the definition, in the buffer it was parsed from.
+     * This union field is used only if type == CJ_CONSTRAINT_DEF_LAZY.
+     */
+    struct {
+      const char* json;
+      size_t jsonLen;
+    } lazy;
   };
 } CjConstraintDef;
 
@@ -234,6 +311,13 @@ CjConstraintDef cjConstraintDefInit();
  * Free the resulting struct with cjConstraintDefFree().
  */
 CjError cjConstraintDefNoGoodAlloc(int arity, int size, CjConstraintDef* out);
+
+/**
+ * Init & allocate a constraint def based on a goods definition.
+ * Return 0 on success.
+ * Free the resulting struct with cjConstraintDefFree().
+ */
+CjError cjConstraintDefGoodAlloc(int arity, int size, CjConstraintDef* out);
 void cjConstraintDefFree(CjConstraintDef* inout);
 
 /**
@@ -275,6 +359,41 @@ CjConstraint* cjConstraintArray(int size);
 /** (1) free each item (2) free the array (3) set pointer to null. */
 void cjConstraintArrayFree(CjConstraint** inout, int size);
 
+////////////////////////////////////////////////////////////////////////////////
+// CjArena
+//
+// A bump allocator. Everything allocated from an arena is released at once
+// by cjArenaFree(), never one by one. Allocations are 16-byte aligned.
+//
+
+typedef struct CjArena CjArena;
+
+/**
+ * Create an empty arena.
+ * @arg blockSize the size of the first block, 0 for the default (64 KB).
+ * @return null on memory allocation error.
+ */
+CjArena* cjArenaNew(size_t blockSize);
+
+/** @return null on memory allocation error. */
+void* cjArenaAlloc(CjArena* arena, size_t size);
+
+/**
+ * Resize p (allocated from arena with oldSize bytes) to newSize bytes, like
+ * realloc(). The most recent allocation is resized in place when possible.
+ * @return null on memory allocation error, p is left as is.
+ */
+void* cjArenaRealloc(CjArena* arena, void* p, size_t oldSize, size_t newSize);
+
+/** Move all the memory of *from to into, free *from and set it to null. */
+void cjArenaMerge(CjArena* into, CjArena** from);
+
+/** The number of bytes the arena holds, including unused space. */
+size_t cjArenaCapacity(const CjArena* arena);
+
+/** (1) free all memory of the arena (2) set pointer to null. */
+void cjArenaFree(CjArena** inout);
+
 ////////////////////////////////////////////////////////////////////////////////
 // CjCsp
 //
@@ -295,6 +414,24 @@ typedef struct CjCsp {
 
   int constraintsSize;
   CjConstraint* constraints;
+
+  /**
+   * Non-null if the meta strings and the CjIntTuples data point into this
+   * caller owned buffer (eg. a mapped cj-bin file, see cjCspBinView()). The
+   * buffer must outlive the csp, and cjCspFree() leaves that memory alone.
+   * Tuples replaced after the view (eg. by cjCspEncodeSmallest()) are
+   * allocated from the arena below.
+   */
+  const void* borrowed;
+
+  /**
+   * Non-null if all of the csp (arrays, strings and CjIntTuples data) is
+   * allocated from this arena, see CjParseOptions.useArena. cjCspFree()
+   * then releases the arena as a whole, so don't free the parts on their
+   * own. Of a borrowed csp, only the tuples that don't point into the
+   * borrowed buffer are in the arena.
+   */
+  CjArena* arena;
 } CjCsp;
 
 /**
@@ -310,6 +447,28 @@ void cjCspFree(CjCsp* inout);
  */
 CjError cjCspValidate(const CjCsp* csp);
 
+/**
+ * cjIntTuplesSortUnique() the tuples of each constraintDef, which can then
+ * be searched with cjIntTuplesContains(). The tuples of a borrowed csp are
+ * copied to its arena first.
+ * csp needs its constraintDefs decoded (see cjCspConstraintDefsDecode()).
+ * @return CJ_ERROR_OK on success
+ */
+CjError cjCspSortUniqueConstraintDefs(CjCsp* csp);
+
+/**
+ * Merge the constraintDefs of the same type and the same tuples (in any
+ * order) into the first of them: the constraints of the others are moved
+ * to it, and the others are dropped from constraintDefs. Defs are found by
+ * a hash of their tuples, so this is about linear in the size of the defs.
+ * csp needs to be valid (see cjCspValidate()) with its constraintDefs
+ * decoded (see cjCspConstraintDefsDecode()).
+ * Backends then build one table per distinct def.
+ * @param numMerged if not null, set to the number of defs dropped.
+ * @return CJ_ERROR_OK on success
+ */
+CjError cjCspDedupConstraintDefs(CjCsp* csp, int* numMerged);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -1,7 +1,9 @@
 #include <gecode/int.hh>
 #include <gecode/search.hh>
 #include "cj/cj-csp.h"
+#include "cj/cj-csp-bin.h"
 #include "cj/cj-csp-io.h"
+#include "cj/cj.hpp"
 #include "io.h"
 
 using namespace Gecode;
@@ -11,15 +13,21 @@ class SpaceCJ : public Space {
 protected:
   IntVarArray xs;
 public:
-  SpaceCJ(CjCsp& csp) : xs(*this, csp.vars.size) {
+  SpaceCJ(const cj::Csp& csp) : xs(*this, (int) csp.vars().size()) {
 
     // Domains
     std::vector<IntSet> domains;
-    for (int iDom = 0; iDom < csp.domainsSize; ++iDom) {
-      if (csp.domains[iDom].type == CjDomain::CJ_DOMAIN_VALUES) {
-        assert(csp.domains[iDom].values.arity == -1); // TODO
-        IntSet values(csp.domains[iDom].values.data, csp.domains[iDom].values.size);
-        domains.push_back(values);
+    for (const CjDomain& dom : csp.domains()) {
+      if (dom.type == CjDomain::CJ_DOMAIN_VALUES) {
+        assert(dom.values.arity == -1); // TODO
+        cj::Span<const int> values = cj::values(dom);
+        domains.push_back(IntSet(values.data(), (int) values.size()));
+      }
+      else if (dom.type == CjDomain::CJ_DOMAIN_INTERVALS) {
+        // Gecode keeps a domain as a list of ranges, so hand them over as is.
+        cj::Tuples intervals = cj::intervals(dom);
+        IntSet ranges(reinterpret_cast<const int (*)[2]>(intervals.flat().data()), (int) intervals.size());
+        domains.push_back(ranges);
       }
       else {
         assert(false); // TODO: handle
@@ -27,22 +35,24 @@ public:
     }
 
     // Variables
-    assert(csp.vars.arity == -1); // TODO: make hard error
-    for (int iVar = 0; iVar < csp.vars.size; ++iVar) {
-      xs[iVar] = IntVar(*this, domains[csp.vars.data[iVar]]);
+    assert(csp->vars.arity == -1); // TODO: make hard error
+    cj::Span<const int> varDomains = csp.vars();
+    for (size_t iVar = 0; iVar < varDomains.size(); ++iVar) {
+      xs[iVar] = IntVar(*this, domains[varDomains[iVar]]);
     }
 
     // Constraint Definitions
     vector<TupleSet> constraintDefs;
-    for (int iCDef = 0; iCDef < csp.constraintDefsSize; ++iCDef) {
-      CjConstraintDef& cDef = csp.constraintDefs[iCDef];
-      if (cDef.type == CjConstraintDef::CJ_CONSTRAINT_DEF_NO_GOODS) {
-        TupleSet tuples(cDef.noGoods.arity);
-        for (int iTuple = 0; iTuple < cDef.noGoods.size; ++iTuple) {
-          tuples.add(
-            vector<int>(
-              &cDef.noGoods.data[iTuple * cDef.noGoods.arity],
-              &cDef.noGoods.data[(iTuple + 1) * cDef.noGoods.arity]));
+    for (const CjConstraintDef& cDef : csp.constraintDefs()) {
+      if (cDef.type == CjConstraintDef::CJ_CONSTRAINT_DEF_NO_GOODS ||
+          cDef.type == CjConstraintDef::CJ_CONSTRAINT_DEF_GOODS) {
+        // Goods and noGoods are the same table, only posted differently.
+        // IntArgs keeps up to 16 values on the stack, so nothing is
+        // allocated per tuple.
+        cj::Tuples defTuples = cj::tuples(cDef);
+        TupleSet tuples((int) defTuples.arity());
+        for (cj::Span<const int> tuple : defTuples) {
+          tuples.add(IntArgs((int) tuple.size(), tuple.data()));
         }
         tuples.finalize();
         constraintDefs.push_back(tuples);
@@ -53,18 +63,18 @@ public:
     }
 
     // Constraints
-    for (int iConstraint = 0; iConstraint < csp.constraintsSize; ++iConstraint) {
-      CjConstraint& constraint = csp.constraints[iConstraint];
-      CjConstraintDef& cDef = csp.constraintDefs[constraint.id];
+    for (const CjConstraint& constraint : csp.constraints()) {
+      const CjConstraintDef& cDef = csp.constraintDefOf(constraint);
       TupleSet& tuples = constraintDefs[constraint.id];
-      if (cDef.type == CjConstraintDef::CJ_CONSTRAINT_DEF_NO_GOODS) {
+      if (cDef.type == CjConstraintDef::CJ_CONSTRAINT_DEF_NO_GOODS ||
+          cDef.type == CjConstraintDef::CJ_CONSTRAINT_DEF_GOODS) {
         assert(constraint.vars.arity == -1);
-        vector<IntVar> vars(constraint.vars.size);
-        for (int iVar = 0; iVar < constraint.vars.size; ++iVar) {
-          vars[iVar] = xs[constraint.vars.data[iVar]];
+        cj::Span<const int> scope = cj::scope(constraint);
+        IntVarArgs varArgs((int) scope.size());
+        for (size_t iVar = 0; iVar < scope.size(); ++iVar) {
+          varArgs[iVar] = xs[scope[iVar]];
         }
-        IntVarArgs varArgs(vars);
-        const bool posneg = false;
+        const bool posneg = cDef.type == CjConstraintDef::CJ_CONSTRAINT_DEF_GOODS;
         extensional(*this, varArgs, tuples, posneg);
       }
       else {
@@ -94,7 +104,7 @@ public:
 };
 
 void printUsage() {
-  fprintf(stderr, "Usage: csp-solve-gecode --csp INSTANCE_FILENAME\n");
+  fprintf(stderr, "Usage: csp-solve-gecode --csp INSTANCE_FILENAME|- [--threads N]\n");
 }
 
 int main(int argc, char** argv) {
@@ -104,7 +114,7 @@ int main(int argc, char** argv) {
       GECODE_VERSION_NUMBER % 100);
 
   int err = 0;
-  if (argc != 3) {
+  if (argc < 3 || argc % 2 != 1) {
     fprintf(stderr, "ERROR: number of command line parameters.\n\n");
     printUsage();
     return 1;
@@ -116,25 +126,46 @@ int main(int argc, char** argv) {
   }
   char* cspInstanceFilename = argv[2];
 
-  FILE* cspInstanceFile = fopen(cspInstanceFilename, "r");
-  if (! cspInstanceFile) {
-    fprintf(stderr, "ERROR: failed to open csp instance file.\n");
+  CjParseOptions parseOptions = cjParseOptionsInit();
+  for (int i = 3; i < argc; i += 2) {
+    if (strcmp(argv[i], "--threads") == 0 && (parseOptions.numThreads = atoi(argv[i + 1])) >= 0) {
+      continue;
+    }
+    fprintf(stderr, "ERROR: bad %s flag.\n\n", argv[i]);
+    printUsage();
     return 1;
   }
 
-  char* cspJson = NULL;
-  size_t cspJsonLen = 0;
-  if (0 != (err = readAll(cspInstanceFile, &cspJson, &cspJsonLen))) {
+  // The file goes after the csp, which may point into it.
+  ScopedLoadedFile cspInstanceFile;
+  if (0 != (err = loadAll(cspInstanceFilename, &cspInstanceFile))) {
     fprintf(stderr, "ERROR(%d): failed to read csp instance file.", err);
     return 1;
   }
+  const char* cspJson = cspInstanceFile.contents;
+  size_t cspJsonLen = cspInstanceFile.len;
 
-  CjCsp csp = cjCspInit();
-  if (0 != (err = cjCspJsonParse(cspJson, cspJsonLen, &csp))) {
+  cj::Csp csp;
+  if (0 != (err = csp.parse(cspJson, cspJsonLen, parseOptions))) {
     fprintf(stderr, "ERROR(%d): failed to parse csp instance file.", err);
     return 1;
   }
+  // A CSP-JSON csp holds its own copy of everything it needs, a cj-bin one
+  // points into the file.
+  if (!csp.borrowed()) {
+    unloadAll(&cspInstanceFile);
+  }
 
+  if (CJ_ERROR_OK != (err = cjCspValidate(csp.get()))) {
+    fprintf(stderr, "ERROR(%d): failed to validate the csp instance.", err);
+    return 1;
+  }
+
+  // Instances often repeat the same table, build each once.
+  if (CJ_ERROR_OK != (err = cjCspDedupConstraintDefs(csp.get(), NULL))) {
+    fprintf(stderr, "ERROR(%d): failed to merge the constraint definitions.", err);
+    return 1;
+  }
 
   auto startTime = std::chrono::high_resolution_clock::now();
   long int startTimeSec = std::chrono::duration_cast<std::chrono::seconds>(startTime.time_since_epoch()).count();
@@ -0,0 +1,74 @@
+#ifndef __CJ_CSP_BIN_H__
+#define __CJ_CSP_BIN_H__
+
+#include <stddef.h>
+#include <stdio.h>
+
+#include "cj-csp.h"
+#include "cj-csp-io.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// cj-bin
+//
+// A binary container for a whole CjCsp that can be used in place, without
+// parsing or copying the tuple data. All integers are little-endian and all
+// offsets are from the start of the file.
+//
+//   header (128 bytes)
+//     char     magic[8]         "CJCSPBIN"
+//     uint32   version          1
+//     uint32   byteOrder        0x01020304
+//     uint64   fileSize
+//     uint64   meta.id          offsets of null terminated strings,
+//     uint64   meta.algo        0 for NULL
+//     uint64   meta.paramsJSON
+//     tuples   vars
+//     int32    domainsSize, constraintDefsSize, constraintsSize, reserved
+//     uint64   domains, constraintDefs, constraints   (record arrays)
+//   tuples (16 bytes)
+//     int32    size, arity
+//     uint64   data             size * abs(arity) int32, 64-byte aligned
+//   record (24 bytes)
+//     int32    domain type, constraintDef type or constraint id
+//     int32    reserved
+//     tuples   values, intervals, noGoods, goods or vars
+//
+
+/** return 1 if data starts like a cj-bin file, 0 otherwise. */
+int cjCspBinIs(const void* data, size_t len);
+
+/**
+ * View a cj-bin file as a csp: csp->borrowed is set to data and every
+ * string and CjIntTuples of the csp points into data, which must outlive
+ * it. data must be at least 4-byte aligned (eg. a mapping or malloc'ed).
+ * @param csp Needs to be freed prior to call. Free with cjCspFree().
+ * @return CJ_ERROR_OK on success
+ */
+CjError cjCspBinView(const void* data, size_t len, CjCsp* csp);
+
+/**
+ * Write csp as a cj-bin file. Lazy constraintDefs need to be decoded first
+ * (see cjCspConstraintDefsDecode()).
+ * @return CJ_ERROR_OK on success
+ */
+CjError cjCspBinWrite(FILE* f, const CjCsp* csp);
+
+/**
+ * Parse either a cj-bin file (see cjCspBinView()) or a CSP-JSON text (see
+ * cjCspJsonParse()), depending on how data starts.
+ * @return CJ_ERROR_OK on success
+ */
+CjError cjCspParse(const char* data, size_t len, CjCsp* csp);
+
+/** cjCspParse() with the options of a CSP-JSON text, unused for cj-bin. */
+CjError cjCspParseOpts(const char* data, size_t len, const CjParseOptions* options, CjCsp* csp);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // __CJ_CSP_BIN_H__
@@ -0,0 +1,70 @@
+#ifndef __CJ_CSP_INDEX_H__
+#define __CJ_CSP_INDEX_H__
+
+#include "cj-csp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// CjCspIndex
+//
+// The constraints of a csp as flat arrays (a struct of arrays instead of an
+// array of CjConstraint with a vars allocation each), and the reverse
+// index from each variable to the constraints on it in compressed sparse
+// row form. Build it once after loading, eg.
+//
+//   for (int i = index.varOffsets[c]; i < index.varOffsets[c + 1]; ++i)
+//     ... index.varData[i] is a variable of constraint c
+//   for (int i = index.adjOffsets[v]; i < index.adjOffsets[v + 1]; ++i)
+//     ... index.adjData[i] is a constraint on variable v
+//
+
+typedef struct CjCspIndex {
+  int constraintsSize;
+  /** The constraintDef of each constraint. */
+  int* ids;
+  /**
+   * constraintsSize + 1 entries, the variables of constraint c are
+   * varData[varOffsets[c]] to varData[varOffsets[c + 1] - 1].
+   */
+  int* varOffsets;
+  int* varData;
+
+  int varsSize;
+  /**
+   * varsSize + 1 entries, the constraints on variable v are
+   * adjData[adjOffsets[v]] to adjData[adjOffsets[v + 1] - 1], in increasing
+   * order and each once (even if v appears twice in it).
+   */
+  int* adjOffsets;
+  int* adjData;
+} CjCspIndex;
+
+/** Zero/null init a CjCspIndex. */
+CjCspIndex cjCspIndexInit();
+
+/**
+ * Build the index of csp, which needs to be valid (see cjCspValidate()).
+ * Free the created object with cjCspIndexFree.
+ * @return CJ_ERROR_OK on success
+ */
+CjError cjCspIndexAlloc(const CjCsp* csp, CjCspIndex* out);
+void cjCspIndexFree(CjCspIndex* inout);
+
+/** The number of variables of constraint c. */
+static inline int cjCspIndexArity(const CjCspIndex* index, int c) {
+  return index->varOffsets[c + 1] - index->varOffsets[c];
+}
+
+/** The number of constraints on variable v. */
+static inline int cjCspIndexDegree(const CjCspIndex* index, int v) {
+  return index->adjOffsets[v + 1] - index->adjOffsets[v];
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // __CJ_CSP_INDEX_H__
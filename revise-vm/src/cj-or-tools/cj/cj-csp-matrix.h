@@ -0,0 +1,183 @@
+#ifndef __CJ_CSP_MATRIX_H__
+#define __CJ_CSP_MATRIX_H__
+
+#include <stdint.h>
+
+#include "cj-csp.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// CjBitMatrix
+//
+// A rows x cols matrix of bits. Row r is rowWords uint64 words starting at
+// bits[r * rowWords], column c is bit (c % 64) of word c / 64. Every row
+// starts on a 64-byte cache line, padding bits are 0.
+//
+
+typedef struct CjBitMatrix {
+  /** The value of row 0 and column 0. */
+  int rowMin;
+  int colMin;
+  int rows;
+  int cols;
+  /** A multiple of 8 (a cache line). */
+  int rowWords;
+  uint64_t* bits;
+} CjBitMatrix;
+
+/** Zero/null init a CjBitMatrix. */
+CjBitMatrix cjBitMatrixInit();
+
+/** The bytes of a rows x cols matrix, row padding included. */
+static inline long long cjBitMatrixBytes(long long rows, long long cols) {
+  return rows * ((cols + 511) / 512) * 64;
+}
+
+/**
+ * Allocate a zeroed matrix for row values [rowMin, rowMin + rows) and
+ * column values [colMin, colMin + cols).
+ * Free the created object with cjBitMatrixFree.
+ */
+CjError cjBitMatrixAlloc(int rowMin, int rows, int colMin, int cols, CjBitMatrix* out);
+void cjBitMatrixFree(CjBitMatrix* inout);
+
+/**
+ * The words of the row of value x (bit c is column value colMin + c), or
+ * null if x is out of range.
+ */
+static inline const uint64_t* cjBitMatrixRow(const CjBitMatrix* m, int x) {
+  const unsigned r = (unsigned) x - (unsigned) m->rowMin;
+  return r < (unsigned) m->rows ? m->bits + (size_t) r * m->rowWords : 0;
+}
+
+/** 1 if the bit of values (x, y) is set, 0 if not or out of range. */
+static inline int cjBitMatrixGet(const CjBitMatrix* m, int x, int y) {
+  const unsigned r = (unsigned) x - (unsigned) m->rowMin;
+  const unsigned c = (unsigned) y - (unsigned) m->colMin;
+  if (r >= (unsigned) m->rows || c >= (unsigned) m->cols) { return 0; }
+  return (int) ((m->bits[(size_t) r * m->rowWords + c / 64] >> (c % 64)) & 1);
+}
+
+/** The number of set bits. */
+long long cjBitMatrixCount(const CjBitMatrix* m);
+
+/**
+ * Set the bits of the pairs of values of tuples (arity 2). Pairs outside of
+ * the matrix are left out.
+ * @return CJ_ERROR_ARG if tuples is not empty and its arity is not 2.
+ */
+CjError cjBitMatrixSetTuples(CjBitMatrix* m, const CjIntTuples* tuples);
+
+/**
+ * Set out to the pairs of values of the set bits, sorted (see
+ * cjIntTuplesSortUnique()). Free the created object with cjIntTuplesFree.
+ */
+CjError cjBitMatrixTuples(const CjBitMatrix* m, CjIntTuples* out);
+
+/** Set the transpose of m into out (which needs to be freed prior to call). */
+CjError cjBitMatrixTranspose(const CjBitMatrix* m, CjBitMatrix* out);
+
+/**
+ * Set the bits of the row of value x for every value of dom. Values outside
+ * of the columns are left out.
+ * @return CJ_ERROR_ARG if x is out of range or dom is of an unknown type.
+ */
+CjError cjBitMatrixMarkDomain(CjBitMatrix* m, int x, const CjDomain* dom);
+
+////////////////////////////////////////////////////////////////////////////////
+// CjDefMatrix
+//
+// A binary no-goods constraintDef compiled for lookups: noGoods[x][y] is set
+// if (x, y) is a no-good, and transposed[y][x] holds the same bits so that
+// the supports of either variable can be scanned a row at a time.
+//
+
+typedef struct CjDefMatrix {
+  CjBitMatrix noGoods;
+  CjBitMatrix transposed;
+} CjDefMatrix;
+
+/** Zero/null init a CjDefMatrix. */
+CjDefMatrix cjDefMatrixInit();
+
+/**
+ * Compile the no-goods of arity 2 for first values [xMin, xMin + xSize) and
+ * second values [yMin, yMin + ySize), eg. the bounds of the domains of the
+ * constrained variables. No-goods outside of these are left out since they
+ * can't be assigned.
+ * Free the created object with cjDefMatrixFree.
+ * @return CJ_ERROR_OK on success, CJ_ERROR_ARG if the arity is not 2.
+ */
+CjError cjDefMatrixCompile(
+  const CjIntTuples* noGoods, int xMin, int xSize, int yMin, int ySize, CjDefMatrix* out);
+void cjDefMatrixFree(CjDefMatrix* inout);
+
+/** 1 if (x, y) is a no-good, 0 otherwise. */
+static inline int cjDefMatrixConflict(const CjDefMatrix* def, int x, int y) {
+  return cjBitMatrixGet(&def->noGoods, x, y);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Set algebra
+//
+// Operations on binary CjIntTuples as sets of pairs of values. When the
+// pairs are dense in the range of values of the result, the inputs are put
+// in bit matrices over that range and combined a word at a time, so the
+// cost is about the number of pairs plus the number of words of the range.
+// Otherwise, or when the matrices would take more than CJ_SET_MAX_BYTES,
+// the inputs are sorted and merged instead. Inputs can hold duplicates and
+// be in any order, results are sorted (see cjIntTuplesSortUnique()) and
+// need to be freed with cjIntTuplesFree. Every operation returns
+// CJ_ERROR_ARG if an input is not empty and its arity is not 2, or if the
+// result has more than INT_MAX pairs.
+//
+
+/** The most bytes a bit matrix of a set operation can take. */
+#define CJ_SET_MAX_BYTES (1LL << 29)
+
+/** Set out to the pairs of a or b. */
+CjError cjIntTuplesUnion(const CjIntTuples* a, const CjIntTuples* b, CjIntTuples* out);
+
+/** Set out to the pairs of both a and b. */
+CjError cjIntTuplesIntersection(const CjIntTuples* a, const CjIntTuples* b, CjIntTuples* out);
+
+/** Set out to the pairs of a that are not in b. */
+CjError cjIntTuplesDifference(const CjIntTuples* a, const CjIntTuples* b, CjIntTuples* out);
+
+/**
+ * Set out to the pairs of values of xs by values of ys that are not in a,
+ * eg. the goods of the noGoods a of a constraint on variables of domains
+ * xs and ys.
+ */
+CjError cjIntTuplesComplement(
+  const CjIntTuples* a, const CjDomain* xs, const CjDomain* ys, CjIntTuples* out);
+
+////////////////////////////////////////////////////////////////////////////////
+// Encodings
+//
+// A binary constraintDef can list either its no-goods or its goods, the
+// pairs of values of the constrained variables that are left. Whichever is
+// shorter makes for a smaller file and a smaller table in the solvers.
+//
+
+/**
+ * Swap each binary noGoods or goods constraintDef to the other encoding
+ * when that one has fewer tuples. The complement is taken over the values
+ * of the domains of the variables the def constrains, so a def that no
+ * constraint uses is kept. So are defs whose bit matrix over the values of
+ * the two sides would take more than CJ_SET_MAX_BYTES.
+ * Lazy constraintDefs need to be decoded first (see
+ * cjCspConstraintDefsDecode()). New tuples are allocated like the rest of
+ * csp, cjCspFree() releases them.
+ * @return CJ_ERROR_OK on success
+ */
+CjError cjCspEncodeSmallest(CjCsp* csp);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif // __CJ_CSP_MATRIX_H__
@@ -0,0 +1,211 @@
+#ifndef __CJ_HPP__
+#define __CJ_HPP__
+
+// C++ wrappers of the cj library for the solver adapters, header only.
+//
+// cj::Csp owns a CjCsp: it can be moved but not copied and its destructor
+// calls cjCspFree(). The views (cj::Span, cj::Tuples) point into the arrays
+// of a csp and copy nothing, so they need the csp to outlive them, eg.
+//
+//   cj::Csp csp;
+//   if (CJ_ERROR_OK != csp.parse(contents, len)) { ... }
+//   for (const CjConstraint& c : csp.constraints()) {
+//     cj::Span<const int> vars = cj::scope(c);
+//     for (cj::Span<const int> tuple : cj::tuples(csp.constraintDefOf(c))) { ... }
+//   }
+
+#include <cstddef>
+#include <utility>
+#if __has_include(<version>)
+#include <version>
+#endif
+#ifdef __cpp_lib_span
+#include <span>
+#endif
+
+#include "cj-csp.h"
+#include "cj-csp-bin.h"
+
+namespace cj {
+
+////////////////////////////////////////////////////////////////////////////////
+// Span
+//
+
+#ifdef __cpp_lib_span
+template <class T>
+using Span = std::span<T>;
+#else
+/** The part of std::span (C++20) that the views use. */
+template <class T>
+class Span {
+public:
+  constexpr Span() noexcept : data_(nullptr), size_(0) {}
+  constexpr Span(T* data, size_t size) noexcept : data_(data), size_(size) {}
+
+  constexpr T* data() const noexcept { return data_; }
+  constexpr size_t size() const noexcept { return size_; }
+  constexpr bool empty() const noexcept { return size_ == 0; }
+  constexpr T& operator[](size_t i) const { return data_[i]; }
+  constexpr T& front() const { return data_[0]; }
+  constexpr T& back() const { return data_[size_ - 1]; }
+  constexpr T* begin() const noexcept { return data_; }
+  constexpr T* end() const noexcept { return data_ + size_; }
+  constexpr Span subspan(size_t offset, size_t count) const { return Span(data_ + offset, count); }
+
+private:
+  T* data_;
+  size_t size_;
+};
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+// Tuples
+//
+
+/**
+ * The tuples of a CjIntTuples, each a span of arity values (a 1D array is
+ * seen as tuples of arity 1).
+ */
+class Tuples {
+public:
+  class Iterator {
+  public:
+    Iterator(const int* data, size_t arity, size_t i) : data_(data), arity_(arity), i_(i) {}
+    Span<const int> operator*() const { return Span<const int>(data_ + i_ * arity_, arity_); }
+    Iterator& operator++() { ++i_; return *this; }
+    bool operator==(const Iterator& o) const { return i_ == o.i_; }
+    bool operator!=(const Iterator& o) const { return i_ != o.i_; }
+
+  private:
+    const int* data_;
+    size_t arity_;
+    size_t i_;
+  };
+
+  Tuples() : data_(nullptr), size_(0), arity_(0) {}
+  explicit Tuples(const CjIntTuples& tuples)
+    : data_(tuples.data),
+      size_(tuples.size > 0 ? tuples.size : 0),
+      arity_(tuples.arity < 0 ? 1 : tuples.arity) {}
+
+  size_t size() const { return size_; }
+  size_t arity() const { return arity_; }
+  bool empty() const { return size_ == 0; }
+  Span<const int> operator[](size_t i) const { return Span<const int>(data_ + i * arity_, arity_); }
+  /** All the values, size() * arity() of them. */
+  Span<const int> flat() const { return Span<const int>(data_, size_ * arity_); }
+  Iterator begin() const { return Iterator(data_, arity_, 0); }
+  Iterator end() const { return Iterator(data_, arity_, size_); }
+
+private:
+  const int* data_;
+  size_t size_;
+  size_t arity_;
+};
+
+/** The values of a 1D CjIntTuples. */
+inline Span<const int> values(const CjIntTuples& tuples) {
+  return Tuples(tuples).flat();
+}
+
+/** The values of a CJ_DOMAIN_VALUES domain, empty for other types. */
+inline Span<const int> values(const CjDomain& domain) {
+  return domain.type == CjDomain::CJ_DOMAIN_VALUES ? values(domain.values) : Span<const int>();
+}
+
+/** The [lo, hi] pairs of a CJ_DOMAIN_INTERVALS domain, empty for other types. */
+inline Tuples intervals(const CjDomain& domain) {
+  return domain.type == CjDomain::CJ_DOMAIN_INTERVALS ? Tuples(domain.intervals) : Tuples();
+}
+
+/** The noGoods or goods of def, empty for other types. */
+inline Tuples tuples(const CjConstraintDef& def) {
+  if (def.type == CjConstraintDef::CJ_CONSTRAINT_DEF_NO_GOODS) { return Tuples(def.noGoods); }
+  if (def.type == CjConstraintDef::CJ_CONSTRAINT_DEF_GOODS) { return Tuples(def.goods); }
+  return Tuples();
+}
+
+/** The variables of constraint. */
+inline Span<const int> scope(const CjConstraint& constraint) {
+  return values(constraint.vars);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Csp
+//
+
+class Csp {
+public:
+  Csp() noexcept : csp_(cjCspInit()) {}
+  /** Take over csp, which is reset to cjCspInit(). */
+  explicit Csp(CjCsp* csp) noexcept : csp_(*csp) { *csp = cjCspInit(); }
+  ~Csp() { cjCspFree(&csp_); }
+
+  Csp(const Csp&) = delete;
+  Csp& operator=(const Csp&) = delete;
+  Csp(Csp&& o) noexcept : csp_(o.release()) {}
+  Csp& operator=(Csp&& o) noexcept {
+    if (this != &o) {
+      cjCspFree(&csp_);
+      csp_ = o.release();
+    }
+    return *this;
+  }
+
+  /**
+   * Replace the csp by the one parsed from data, see cjCspParse(). A cj-bin
+   * csp points into data, which then needs to outlive it (see borrowed()).
+   * @return CJ_ERROR_OK on success, the csp is empty otherwise.
+   */
+  CjError parse(const char* data, size_t len) {
+    cjCspFree(&csp_);
+    return cjCspParse(data, len, &csp_);
+  }
+
+  /** parse() with the options of a CSP-JSON text, see cjCspParseOpts(). */
+  CjError parse(const char* data, size_t len, const CjParseOptions& options) {
+    cjCspFree(&csp_);
+    return cjCspParseOpts(data, len, &options, &csp_);
+  }
+
+  /** Give up ownership, the csp is left empty. */
+  CjCsp release() noexcept {
+    CjCsp csp = csp_;
+    csp_ = cjCspInit();
+    return csp;
+  }
+
+  CjCsp* get() noexcept { return &csp_; }
+  const CjCsp* get() const noexcept { return &csp_; }
+  CjCsp& operator*() noexcept { return csp_; }
+  const CjCsp& operator*() const noexcept { return csp_; }
+  CjCsp* operator->() noexcept { return &csp_; }
+  const CjCsp* operator->() const noexcept { return &csp_; }
+
+  /** true if the csp points into the buffer it was parsed from. */
+  bool borrowed() const { return csp_.borrowed != nullptr; }
+
+  Span<const CjDomain> domains() const { return Span<const CjDomain>(csp_.domains, sizeOf(csp_.domainsSize)); }
+  /** The domain of each variable, as an index into domains(). */
+  Span<const int> vars() const { return values(csp_.vars); }
+  const CjDomain& domainOf(int var) const { return csp_.domains[csp_.vars.data[var]]; }
+  Span<const CjConstraintDef> constraintDefs() const {
+    return Span<const CjConstraintDef>(csp_.constraintDefs, sizeOf(csp_.constraintDefsSize));
+  }
+  Span<const CjConstraint> constraints() const {
+    return Span<const CjConstraint>(csp_.constraints, sizeOf(csp_.constraintsSize));
+  }
+  const CjConstraintDef& constraintDefOf(const CjConstraint& constraint) const {
+    return csp_.constraintDefs[constraint.id];
+  }
+
+private:
+  static size_t sizeOf(int size) { return size > 0 ? (size_t) size : 0; }
+
+  CjCsp csp_;
+};
+
+} // namespace cj
+
+#endif // __CJ_HPP__
@@ -1,32 +1,47 @@
+#include <climits>
 #include <iostream>
+#include <map>
+#include <tuple>
 //#include <ortools/base/version.h>
 #include <ortools/init/init.h>
 #include <ortools/constraint_solver/constraint_solver.h>
 #include <sstream>
 
 #include "cj/cj-csp.h"
+#include "cj/cj-csp-bin.h"
 #include "cj/cj-csp-io.h"
+#include "cj/cj-csp-matrix.h"
+#include "cj/cj.hpp"
 #include "io.h"
 
 using namespace operations_research;
 using namespace std;
 
-vector<IntVar*> genDomains(const CjCsp& csp, Solver& solver) {
+vector<IntVar*> genDomains(const cj::Csp& csp, Solver& solver) {
   vector<IntVar*> vars;
-  for (int iVar = 0; iVar < csp.vars.size; ++iVar) {
-    const CjDomain& dom = csp.domains[csp.vars.data[iVar]];
+  for (size_t iVar = 0; iVar < csp.vars().size(); ++iVar) {
+    const CjDomain& dom = csp.domainOf((int) iVar);
+    stringstream ss;
+    ss << "x" << iVar;
     if (dom.type == CjDomain::CJ_DOMAIN_VALUES) {
-      vector<int64_t> values;
-      for (int iVal = 0; iVal < dom.values.size - 1; ++iVal) {
-        values.push_back(dom.values.data[iVal]);
-      }
-      stringstream ss;
-      ss << "x" << iVar;
+      cj::Span<const int> domValues = cj::values(dom);
+      vector<int64_t> values(domValues.begin(), domValues.end());
       vars.push_back(solver.MakeIntVar(values, ss.str().c_str()));
       // Can also usage the Domain class:
       //   Domain non_zero_digit(1, kBase - 1);
       //   IntVar c = cp_model.NewIntVar(non_zero_digit).WithName("C");
     }
+    else if (dom.type == CjDomain::CJ_DOMAIN_INTERVALS) {
+      // A bounds variable, with the gaps between the intervals cut out.
+      cj::Tuples intervals = cj::intervals(dom);
+      const size_t last = intervals.size() - 1;
+      IntVar* var = solver.MakeIntVar(intervals[0][0], intervals[last][1], ss.str().c_str());
+      for (size_t i = 0; i < last; ++i) {
+        solver.AddConstraint(
+          solver.MakeNotBetweenCt(var, intervals[i][1] + 1, intervals[i + 1][0] - 1));
+      }
+      vars.push_back(var);
+    }
     else {
       assert(false); // TODO: handle
     }
@@ -34,80 +49,120 @@ vector<IntVar*> genDomains(const CjCsp& csp, Solver& solver) {
   return vars;
 }
 
-int maxDomValue(const CjCsp& csp) {
-  int maxVal = 0;
-  for (int iDom = 0; iDom < csp.domainsSize; ++iDom) {
-    CjDomain& dom = csp.domains[iDom];
-    if (dom.type == CjDomain::CJ_DOMAIN_VALUES) {
-      for (int iVal = 0; iVal < dom.values.size; ++iVal) {
-        maxVal = std::max(maxVal, dom.values.data[iVal]);
-      }
-    }
-    else {
-      throw std::string("ERROR: unsupported domain type.");
-    }
+/**
+ * Add to tuples the allowed pairs of a binary no-goods def for variables
+ * with domains xDom and yDom: the complement of the no-goods over the
+ * actual values of the two domains. Values are walked a word (64 values)
+ * at a time.
+ * @return CJ_ERROR_ARG if the bit matrices of the domains would take more
+ * than CJ_SET_MAX_BYTES.
+ */
+CjError allowedTuples(const CjConstraintDef& cDef, const CjDomain& xDom, const CjDomain& yDom, IntTupleSet* tuples) {
+  int xMin, xMax, yMin, yMax;
+  CjError err;
+  if (CJ_ERROR_OK != (err = cjDomainBounds(&xDom, &xMin, &xMax)) ||
+      CJ_ERROR_OK != (err = cjDomainBounds(&yDom, &yMin, &yMax))) {
+    return err;
+  }
+  const long long xSize = (long long) xMax - xMin + 1;
+  const long long ySize = (long long) yMax - yMin + 1;
+  if (xSize > INT_MAX || ySize > INT_MAX ||
+      cjBitMatrixBytes(xSize, ySize) > CJ_SET_MAX_BYTES || cjBitMatrixBytes(ySize, xSize) > CJ_SET_MAX_BYTES) {
+    return CJ_ERROR_ARG;
   }
-  return maxVal;
-}
 
-void genConstraints(const CjCsp& csp, Solver& solver, vector<IntVar*>& vars) {
-  // TODO: The correct way to get these is by looking at all the domains of the variables involved in a constraint.
-  int domMinVal = 0;
-  int domMaxVal = maxDomValue(csp);
-
-  // Constraint Definitions
-  vector<IntTupleSet> tupleSets;
-  for (int iCDef = 0; iCDef < csp.constraintDefsSize; ++iCDef) {
-    CjConstraintDef& cDef = csp.constraintDefs[iCDef];
-    if (cDef.type == CjConstraintDef::CJ_CONSTRAINT_DEF_NO_GOODS) {
-
-      typedef set<pair<int, int> > Tuples;
-      Tuples tuples;
-      for (int xVal = domMinVal; xVal <= domMaxVal; ++xVal) {
-        for (int yVal = domMinVal; yVal <= domMaxVal; ++yVal) {
-          tuples.insert(pair<int, int>(xVal, yVal));
+  CjDefMatrix noGoods = cjDefMatrixInit();
+  CjBitMatrix xDomBits = cjBitMatrixInit();
+  CjBitMatrix yDomBits = cjBitMatrixInit();
+  if (CJ_ERROR_OK != (err = cjDefMatrixCompile(&cDef.noGoods, xMin, (int) xSize, yMin, (int) ySize, &noGoods)) ||
+      CJ_ERROR_OK != (err = cjBitMatrixAlloc(0, 1, xMin, (int) xSize, &xDomBits)) ||
+      CJ_ERROR_OK != (err = cjBitMatrixAlloc(0, 1, yMin, (int) ySize, &yDomBits))) {
+    cjDefMatrixFree(&noGoods);
+    cjBitMatrixFree(&xDomBits);
+    cjBitMatrixFree(&yDomBits);
+    return err;
+  }
+  // A single row marking the values of each domain.
+  cjBitMatrixMarkDomain(&xDomBits, 0, &xDom);
+  cjBitMatrixMarkDomain(&yDomBits, 0, &yDom);
+  const uint64_t* xValues = xDomBits.bits;
+  const uint64_t* yValues = yDomBits.bits;
+
+  const int yWords = (int) ((ySize + 63) / 64);
+  for (int xWord = 0; xWord < (int) ((xSize + 63) / 64); ++xWord) {
+    for (uint64_t xs = xValues[xWord]; xs; xs &= xs - 1) {
+      const int x = xMin + xWord * 64 + __builtin_ctzll(xs);
+      const uint64_t* row = cjBitMatrixRow(&noGoods.noGoods, x);
+      for (int yWord = 0; yWord < yWords; ++yWord) {
+        for (uint64_t ys = yValues[yWord] & ~row[yWord]; ys; ys &= ys - 1) {
+          tuples->Insert2(x, yMin + yWord * 64 + __builtin_ctzll(ys));
         }
       }
-      for (int iTuple = 0; iTuple < cDef.noGoods.size; ++iTuple) {
-        tuples.erase(pair<int, int>(
-          cDef.noGoods.data[iTuple * cDef.noGoods.arity + 0],
-          cDef.noGoods.data[iTuple * cDef.noGoods.arity + 1]));
-      }
+    }
+  }
 
+  cjBitMatrixFree(&xDomBits);
+  cjBitMatrixFree(&yDomBits);
+  cjDefMatrixFree(&noGoods);
+  return CJ_ERROR_OK;
+}
 
-      const int arity = 2;
-      tupleSets.push_back(IntTupleSet(arity));
-      for (Tuples::const_iterator it = tuples.begin(); it != tuples.end(); ++it) {
-        tupleSets.back().Insert2(it->first, it->second);
-      }
-    }
-    else {
-      assert(false);
-    }
+/** Add to tuples the allowed pairs of a binary goods def, as listed. */
+void goodsTuples(const CjConstraintDef& cDef, IntTupleSet* tuples) {
+  for (cj::Span<const int> pair : cj::tuples(cDef)) {
+    tuples->Insert2(pair[0], pair[1]);
   }
+}
+
+/** @return CJ_ERROR_OK on success */
+CjError genConstraints(const cj::Csp& csp, Solver& solver, vector<IntVar*>& vars) {
+  // Constraint Definitions: the allowed pairs of a noGoods def depend on the
+  // domains of the constrained variables, so build them once per combination.
+  // Those of a goods def don't, its key leaves the domains out.
+  map<std::tuple<int, int, int>, IntTupleSet> tupleSets;
 
   // Constraints
-  for (int iConstraint = 0; iConstraint < csp.constraintsSize; ++iConstraint) {
-    CjConstraint& constraint = csp.constraints[iConstraint];
-    CjConstraintDef& cDef = csp.constraintDefs[constraint.id];
-    if (cDef.type == CjConstraintDef::CJ_CONSTRAINT_DEF_NO_GOODS) {
+  for (const CjConstraint& constraint : csp.constraints()) {
+    const CjConstraintDef& cDef = csp.constraintDefOf(constraint);
+    if (cDef.type == CjConstraintDef::CJ_CONSTRAINT_DEF_NO_GOODS ||
+        cDef.type == CjConstraintDef::CJ_CONSTRAINT_DEF_GOODS) {
       assert(constraint.vars.size == 2); // TODO: make this a stronger check
+      const bool goods = cDef.type == CjConstraintDef::CJ_CONSTRAINT_DEF_GOODS;
+      const int xVar = cj::scope(constraint)[0];
+      const int yVar = cj::scope(constraint)[1];
+      const std::tuple<int, int, int> key(
+        constraint.id, goods ? -1 : csp.vars()[xVar], goods ? -1 : csp.vars()[yVar]);
+      auto it = tupleSets.find(key);
+      if (it == tupleSets.end()) {
+        const int arity = 2;
+        IntTupleSet tuples(arity);
+        if (goods) {
+          goodsTuples(cDef, &tuples);
+        }
+        else {
+          CjError err = allowedTuples(cDef, csp.domainOf(xVar), csp.domainOf(yVar), &tuples);
+          if (err != CJ_ERROR_OK) { return err; }
+        }
+        it = tupleSets.emplace(key, tuples).first;
+      }
+
       std::vector<IntVar*> cvars;
-      cvars.push_back(vars[constraint.vars.data[0]]);
-      cvars.push_back(vars[constraint.vars.data[1]]);
-      solver.AddConstraint(solver.MakeAllowedAssignments(cvars, tupleSets[constraint.id]));
+      cvars.push_back(vars[xVar]);
+      cvars.push_back(vars[yVar]);
+      solver.AddConstraint(solver.MakeAllowedAssignments(cvars, it->second));
     }
     else {
       assert(false);
     }
   }
+  return CJ_ERROR_OK;
 }
 
 void printUsage() {
-  fprintf(stderr, "Usage: cj-solve-or-tools --csp INSTANCE_FILENAME\n");
+  fprintf(stderr, "Usage: cj-solve-or-tools --csp INSTANCE_FILENAME|- [--threads N]\n");
 }
 
-void solve(CjCsp& csp, Solver& solver, vector<IntVar*>& vars) {
+void solve(const cj::Csp& csp, Solver& solver, vector<IntVar*>& vars) {
   DecisionBuilder* const db = solver.MakePhase(
     vars, Solver::CHOOSE_FIRST_UNBOUND, Solver::ASSIGN_MIN_VALUE);
 
@@ -142,7 +197,7 @@ int main(int argc, char** argv) {
   printOrToolsVersion();
 
   int err = 0;
-  if (argc != 3) {
+  if (argc < 3 || argc % 2 != 1) {
     fprintf(stderr, "ERROR: number of command line parameters.\n\n");
     printUsage();
     return 1;
@@ -154,33 +209,53 @@ int main(int argc, char** argv) {
   }
   char* cspInstanceFilename = argv[2];
 
-  FILE* cspInstanceFile = fopen(cspInstanceFilename, "r");
-  if (! cspInstanceFile) {
-    fprintf(stderr, "ERROR: failed to open csp instance file.\n");
+  CjParseOptions parseOptions = cjParseOptionsInit();
+  for (int i = 3; i < argc; i += 2) {
+    if (strcmp(argv[i], "--threads") == 0 && (parseOptions.numThreads = atoi(argv[i + 1])) >= 0) {
+      continue;
+    }
+    fprintf(stderr, "ERROR: bad %s flag.\n\n", argv[i]);
+    printUsage();
     return 1;
   }
 
-  char* cspJson = NULL;
-  size_t cspJsonLen = 0;
-  if (CJ_ERROR_OK != (err = readAll(cspInstanceFile, &cspJson, &cspJsonLen))) {
+  // The file goes after the csp, which may point into it.
+  ScopedLoadedFile cspInstanceFile;
+  if (0 != (err = loadAll(cspInstanceFilename, &cspInstanceFile))) {
     fprintf(stderr, "ERROR(%d): failed to read csp instance file.", err);
     return 1;
   }
+  const char* cspJson = cspInstanceFile.contents;
+  size_t cspJsonLen = cspInstanceFile.len;
 
-  CjCsp csp = cjCspInit();
-  if (CJ_ERROR_OK != (err = cjCspJsonParse(cspJson, cspJsonLen, &csp))) {
+  cj::Csp csp;
+  if (CJ_ERROR_OK != (err = csp.parse(cspJson, cspJsonLen, parseOptions))) {
     fprintf(stderr, "ERROR(%d): failed to parse csp instance file.", err);
     return 1;
   }
+  // A CSP-JSON csp holds its own copy of everything it needs, a cj-bin one
+  // points into the file.
+  if (!csp.borrowed()) {
+    unloadAll(&cspInstanceFile);
+  }
 
-  if (CJ_ERROR_OK != (err = cjCspValidate(&csp))) {
+  if (CJ_ERROR_OK != (err = cjCspValidate(csp.get()))) {
     fprintf(stderr, "ERROR(%d): failed to validate the csp instance.", err);
     return 1;
   }
 
+  // Instances often repeat the same table, build each once.
+  if (CJ_ERROR_OK != (err = cjCspDedupConstraintDefs(csp.get(), NULL))) {
+    fprintf(stderr, "ERROR(%d): failed to merge the constraint definitions.", err);
+    return 1;
+  }
+
   Solver solver("csp-json-or-tools-cp");
   vector<IntVar*> vars = genDomains(csp, solver);
-  genConstraints(csp, solver, vars);
+  if (CJ_ERROR_OK != (err = genConstraints(csp, solver, vars))) {
+    fprintf(stderr, "ERROR(%d): failed to compile the constraint definitions.", err);
+    return 1;
+  }
   solve(csp, solver, vars);
 
   return 0;
@@ -10,26 +10,32 @@
 #include <time.h>
 
 #include "cj/cj-csp.h"
+#include "cj/cj-csp-bin.h"
 #include "cj/cj-csp-io.h"
+#include "cj/cj.hpp"
 #include "io.h"
 
 using namespace operations_research;
 using namespace operations_research::sat;
 using namespace std;
 
-vector<IntVar> genDomains(const CjCsp& csp, CpModelBuilder& cpModel) {
+vector<IntVar> genDomains(const cj::Csp& csp, CpModelBuilder& cpModel) {
   vector<IntVar> vars;
-  for (int iVar = 0; iVar < csp.vars.size; ++iVar) {
-    const CjDomain& dom = csp.domains[csp.vars.data[iVar]];
+  for (size_t iVar = 0; iVar < csp.vars().size(); ++iVar) {
+    const CjDomain& dom = csp.domainOf((int) iVar);
+    stringstream ss;
+    ss << "x" << iVar;
     if (dom.type == CjDomain::CJ_DOMAIN_VALUES) {
-      vector<int64_t> values;
-      for (int iVal = 0; iVal < dom.values.size - 1; ++iVal) {
-        values.push_back(dom.values.data[iVal]);
-      }
-      stringstream ss;
-      ss << "x" << iVar;
+      cj::Span<const int> domValues = cj::values(dom);
+      vector<int64_t> values(domValues.begin(), domValues.end());
       vars.push_back(cpModel.NewIntVar(Domain::FromValues(values)).WithName(ss.str()));
     }
+    else if (dom.type == CjDomain::CJ_DOMAIN_INTERVALS) {
+      // [lo0, hi0, lo1, hi1, ...] is the layout of the intervals tuples already.
+      cj::Span<const int> intervals = cj::intervals(dom).flat();
+      vector<int64_t> flat(intervals.begin(), intervals.end());
+      vars.push_back(cpModel.NewIntVar(Domain::FromFlatIntervals(flat)).WithName(ss.str()));
+    }
     else {
       assert(false); // TODO: handle
     }
@@ -37,38 +43,35 @@ vector<IntVar> genDomains(const CjCsp& csp, CpModelBuilder& cpModel) {
   return vars;
 }
 
-int maxDomValue(const CjCsp& csp) {
+int maxDomValue(const cj::Csp& csp) {
   int maxVal = 0;
-  for (int iDom = 0; iDom < csp.domainsSize; ++iDom) {
-    CjDomain& dom = csp.domains[iDom];
-    if (dom.type == CjDomain::CJ_DOMAIN_VALUES) {
-      for (int iVal = 0; iVal < dom.values.size; ++iVal) {
-        maxVal = std::max(maxVal, dom.values.data[iVal]);
-      }
-    }
-    else {
+  for (const CjDomain& dom : csp.domains()) {
+    int domMin, domMax;
+    if (CJ_ERROR_OK != cjDomainBounds(&dom, &domMin, &domMax)) {
       throw std::string("ERROR: unsupported domain type.");
     }
+    maxVal = std::max(maxVal, domMax);
   }
   return maxVal;
 }
 
-void genConstraints(const CjCsp& csp, CpModelBuilder& cpModel, vector<IntVar>& vars) {
+void genConstraints(const cj::Csp& csp, CpModelBuilder& cpModel, vector<IntVar>& vars) {
   // Constraints
-  for (int iConstraint = 0; iConstraint < csp.constraintsSize; ++iConstraint) {
-    CjConstraint& constraint = csp.constraints[iConstraint];
-    CjConstraintDef& cDef = csp.constraintDefs[constraint.id];
-    if (cDef.type == CjConstraintDef::CJ_CONSTRAINT_DEF_NO_GOODS) {
+  for (const CjConstraint& constraint : csp.constraints()) {
+    const CjConstraintDef& cDef = csp.constraintDefOf(constraint);
+    if (cDef.type == CjConstraintDef::CJ_CONSTRAINT_DEF_NO_GOODS ||
+        cDef.type == CjConstraintDef::CJ_CONSTRAINT_DEF_GOODS) {
       assert(constraint.vars.size == 2); // TODO: make this a stronger check
 
-      TableConstraint table = cpModel.AddForbiddenAssignments({
-        vars[constraint.vars.data[0]],
-        vars[constraint.vars.data[1]]});
+      const bool goods = cDef.type == CjConstraintDef::CJ_CONSTRAINT_DEF_GOODS;
+      cj::Span<const int> scope = cj::scope(constraint);
+      const vector<IntVar> cvars = {vars[scope[0]], vars[scope[1]]};
+      TableConstraint table = goods
+        ? cpModel.AddAllowedAssignments(cvars)
+        : cpModel.AddForbiddenAssignments(cvars);
 
-      for (int iTuple = 0; iTuple < cDef.noGoods.size; ++iTuple) {
-        table.AddTuple({
-          cDef.noGoods.data[iTuple * cDef.noGoods.arity + 0],
-          cDef.noGoods.data[iTuple * cDef.noGoods.arity + 1]});
+      for (cj::Span<const int> pair : cj::tuples(cDef)) {
+        table.AddTuple({pair[0], pair[1]});
       }
     }
     else {
@@ -78,10 +81,10 @@ void genConstraints(const CjCsp& csp, CpModelBuilder& cpModel, vector<IntVar>& v
 }
 
 void printUsage() {
-  fprintf(stderr, "Usage: cj-solve-or-tools --csp INSTANCE_FILENAME\n");
+  fprintf(stderr, "Usage: cj-solve-or-tools --csp INSTANCE_FILENAME|- [--threads N]\n");
 }
 
-void solve(CjCsp& csp, CpModelBuilder& cpModel, vector<IntVar>& vars) {
+void solve(const cj::Csp& csp, CpModelBuilder& cpModel, vector<IntVar>& vars) {
   srand(time(NULL));
   int seed = rand();
   cerr << "seed:" << seed << endl;
@@ -120,7 +123,7 @@ int main(int argc, char** argv) {
   printOrToolsVersion();
 
   int err = 0;
-  if (argc != 3) {
+  if (argc < 3 || argc % 2 != 1) {
     fprintf(stderr, "ERROR: number of command line parameters.\n\n");
     printUsage();
     return 1;
@@ -132,30 +135,47 @@ int main(int argc, char** argv) {
   }
   char* cspInstanceFilename = argv[2];
 
-  FILE* cspInstanceFile = fopen(cspInstanceFilename, "r");
-  if (! cspInstanceFile) {
-    fprintf(stderr, "ERROR: failed to open csp instance file.\n");
+  CjParseOptions parseOptions = cjParseOptionsInit();
+  for (int i = 3; i < argc; i += 2) {
+    if (strcmp(argv[i], "--threads") == 0 && (parseOptions.numThreads = atoi(argv[i + 1])) >= 0) {
+      continue;
+    }
+    fprintf(stderr, "ERROR: bad %s flag.\n\n", argv[i]);
+    printUsage();
     return 1;
   }
 
-  char* cspJson = NULL;
-  size_t cspJsonLen = 0;
-  if (CJ_ERROR_OK != (err = readAll(cspInstanceFile, &cspJson, &cspJsonLen))) {
+  // The file goes after the csp, which may point into it.
+  ScopedLoadedFile cspInstanceFile;
+  if (0 != (err = loadAll(cspInstanceFilename, &cspInstanceFile))) {
     fprintf(stderr, "ERROR(%d): failed to read csp instance file.", err);
     return 1;
   }
+  const char* cspJson = cspInstanceFile.contents;
+  size_t cspJsonLen = cspInstanceFile.len;
 
-  CjCsp csp = cjCspInit();
-  if (CJ_ERROR_OK != (err = cjCspJsonParse(cspJson, cspJsonLen, &csp))) {
+  cj::Csp csp;
+  if (CJ_ERROR_OK != (err = csp.parse(cspJson, cspJsonLen, parseOptions))) {
     fprintf(stderr, "ERROR(%d): failed to parse csp instance file.", err);
     return 1;
   }
+  // A CSP-JSON csp holds its own copy of everything it needs, a cj-bin one
+  // points into the file.
+  if (!csp.borrowed()) {
+    unloadAll(&cspInstanceFile);
+  }
 
-  if (CJ_ERROR_OK != (err = cjCspValidate(&csp))) {
+  if (CJ_ERROR_OK != (err = cjCspValidate(csp.get()))) {
     fprintf(stderr, "ERROR(%d): failed to validate the csp instance.", err);
     return 1;
   }
 
+  // The tables take the tuples as listed, duplicates included.
+  if (CJ_ERROR_OK != (err = cjCspSortUniqueConstraintDefs(csp.get()))) {
+    fprintf(stderr, "ERROR(%d): failed to sort the constraint definitions.", err);
+    return 1;
+  }
+
   CpModelBuilder cpModel;
   vector<IntVar> vars = genDomains(csp, cpModel);
   genConstraints(csp, cpModel, vars);
@@ -20,17 +20,24 @@ if __name__ == '__main__':
         csp_json = json.loads(f.read())
 
     def domfn(i):
-        return csp_json['domains'][csp_json['vars'][i]]['values']
+        dom = csp_json['domains'][csp_json['vars'][i]]
+        if 'intervals' in dom:
+            ranges = [range(lo, hi + 1) for lo, hi in dom['intervals']]
+            return ranges[0] if len(ranges) == 1 else {v for r in ranges for v in r}
+        return dom['values']
     x = VarArray(size=len(csp_json['vars']), dom=domfn)
 
     tables = []
     for constraintDef in csp_json['constraintDefs']:
-        tables.append(constraintDef['noGoods'])
+        if 'goods' in constraintDef:
+            tables.append((True, constraintDef['goods']))
+        else:
+            tables.append((False, constraintDef['noGoods']))
 
     for constraint in csp_json['constraints']:
-        cid = constraint['id']
-        cvars = constraint['vars']
-        satisfy([x[i] for i in cvars] not in tables[cid]) # TODO in/not-in depends on constraintDef
+        goods, table = tables[constraint['id']]
+        cvars = [x[i] for i in constraint['vars']]
+        satisfy(cvars in table if goods else cvars not in table)
 
     time_start = time.time_ns()
     instance = compile()
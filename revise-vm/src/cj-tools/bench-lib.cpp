@@ -0,0 +1,517 @@
+// Benchmark the cj library on its own: parse, validate, compile (the binary
+// constraintDefs to CjDefMatrix), make dense (CjDense), index (CjCspIndex),
+// combine (the union and intersection of each constraintDef with the next),
+// print and free urbcsp instances of the sizes in generate-all.sh (d64 to
+// d1024).
+//
+// The instances are generated in memory (random model B, like
+// cj-gen-urbcsp) so no files or external tools are needed. One JSON line
+// is printed per size with, for each step, the best time of all reps, the
+// throughput and the number of allocations. maxRssKB is the peak RSS of the
+// process so far, sizes run from small to large.
+
+#include <chrono>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "cj/cj-csp.h"
+#include "cj/cj-csp-dense.h"
+#include "cj/cj-csp-index.h"
+#include "cj/cj-csp-io.h"
+#include "cj/cj-csp-matrix.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Allocation counting
+//
+// malloc() and friends are replaced for the whole process and forward to
+// glibc, counting calls on the way.
+//
+
+#if defined(__GLIBC__) && !defined(__SANITIZE_ADDRESS__)
+#define CJ_COUNT_ALLOCS
+
+static long long numAllocs = 0;
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t n, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* p);
+
+void* malloc(size_t size) {
+  __atomic_fetch_add(&numAllocs, 1, __ATOMIC_RELAXED);
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t n, size_t size) {
+  __atomic_fetch_add(&numAllocs, 1, __ATOMIC_RELAXED);
+  return __libc_calloc(n, size);
+}
+
+void* realloc(void* p, size_t size) {
+  __atomic_fetch_add(&numAllocs, 1, __ATOMIC_RELAXED);
+  return __libc_realloc(p, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+  __atomic_fetch_add(&numAllocs, 1, __ATOMIC_RELAXED);
+  return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** p, size_t alignment, size_t size) {
+  __atomic_fetch_add(&numAllocs, 1, __ATOMIC_RELAXED);
+  *p = __libc_memalign(alignment, size);
+  return *p ? 0 : ENOMEM;
+}
+
+void free(void* p) {
+  __libc_free(p);
+}
+} // extern "C"
+#endif
+
+/** The number of allocation calls so far, or -1. */
+static long long allocCount() {
+#ifdef CJ_COUNT_ALLOCS
+  return __atomic_load_n(&numAllocs, __ATOMIC_RELAXED);
+#else
+  return -1;
+#endif
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// urbcsp
+//
+
+/** The parameters of cj-gen-urbcsp, see generate.sh. */
+struct Urbcsp {
+  int numVars;
+  int numVals;
+  int numConstraints;
+  int tightness;
+  int numConstraintDefs;
+};
+
+/** The instance sizes of generate-all.sh. */
+static const Urbcsp urbcspSizes[] = {
+  {16, 64, 98, 2048, 10},
+  {16, 128, 96, 9338, 10},
+  {12, 256, 52, 47382, 10},
+  {10, 512, 36, 217579, 5},
+  {10, 1024, 36, 891289, 5},
+};
+
+static uint64_t rngNext(uint64_t* state) {
+  // xorshift64*
+  *state ^= *state >> 12;
+  *state ^= *state << 25;
+  *state ^= *state >> 27;
+  return *state * 2685821657736338717ULL;
+}
+
+/**
+ * Pick k of [0, n) without repetition, in increasing order, into out.
+ * Return 0 on memory allocation error.
+ */
+static int pickSorted(int n, int k, uint64_t* rng, int* out) {
+  int* xs = (int*) malloc(sizeof(int) * n);
+  char* picked = (char*) calloc(n, 1);
+  if (!xs || !picked) { free(xs); free(picked); return 0; }
+  for (int i = 0; i < n; ++i) { xs[i] = i; }
+  for (int i = 0; i < k; ++i) {
+    const int j = i + (int) (rngNext(rng) % (uint64_t) (n - i));
+    const int x = xs[j];
+    xs[j] = xs[i];
+    xs[i] = x;
+    picked[x] = 1;
+  }
+  for (int i = 0, iOut = 0; i < n; ++i) {
+    if (picked[i]) { out[iOut++] = i; }
+  }
+  free(xs);
+  free(picked);
+  return 1;
+}
+
+/** Generate an instance and print it as CSP-JSON into *json (malloc'ed). */
+static CjError urbcspJson(const Urbcsp& u, uint64_t seed, char** json, size_t* jsonLen) {
+  CjCsp csp = cjCspInit();
+  uint64_t rng = seed * 0x9E3779B97F4A7C15ULL + 1;
+  CjError err = CJ_ERROR_NOMEM;
+  char name[128];
+  snprintf(name, sizeof(name), "n%dd%dc%dt%ds%llui0k%d", u.numVars, u.numVals,
+    u.numConstraints, u.tightness, (unsigned long long) seed, u.numConstraintDefs);
+  FILE* f = NULL;
+  int* pairs = NULL;
+
+  csp.meta.id = strdup(name);
+  csp.meta.algo = strdup("urbcsp");
+  csp.meta.paramsJSON = strdup("{}");
+  if (!csp.meta.id || !csp.meta.algo || !csp.meta.paramsJSON) { goto done; }
+
+  csp.domainsSize = 1;
+  if (!(csp.domains = cjDomainArray(1))) { goto done; }
+  if ((err = cjDomainValuesAlloc(u.numVals, &csp.domains[0])) != CJ_ERROR_OK) { goto done; }
+  for (int i = 0; i < u.numVals; ++i) { csp.domains[0].values.data[i] = i; }
+
+  if ((err = cjIntTuplesAlloc(u.numVars, -1, &csp.vars)) != CJ_ERROR_OK) { goto done; }
+  for (int i = 0; i < u.numVars; ++i) { csp.vars.data[i] = 0; }
+
+  // Each def has tightness distinct no-goods out of the numVals^2 pairs.
+  err = CJ_ERROR_NOMEM;
+  csp.constraintDefsSize = u.numConstraintDefs;
+  if (!(csp.constraintDefs = cjConstraintDefArray(u.numConstraintDefs))) { goto done; }
+  for (int iDef = 0; iDef < u.numConstraintDefs; ++iDef) {
+    CjConstraintDef* def = &csp.constraintDefs[iDef];
+    if ((err = cjConstraintDefNoGoodAlloc(2, u.tightness, def)) != CJ_ERROR_OK) { goto done; }
+    err = CJ_ERROR_NOMEM;
+    if (!pickSorted(u.numVals * u.numVals, u.tightness, &rng, def->noGoods.data)) { goto done; }
+    for (int i = u.tightness - 1; i >= 0; --i) {
+      const int pair = def->noGoods.data[i];
+      def->noGoods.data[2 * i] = pair / u.numVals;
+      def->noGoods.data[2 * i + 1] = pair % u.numVals;
+    }
+  }
+
+  // The constraints are on distinct pairs of distinct variables.
+  pairs = (int*) malloc(sizeof(int) * u.numConstraints);
+  csp.constraintsSize = u.numConstraints;
+  csp.constraints = cjConstraintArray(u.numConstraints);
+  if (!pairs || !csp.constraints) { goto done; }
+  if (!pickSorted(u.numVars * (u.numVars - 1) / 2, u.numConstraints, &rng, pairs)) { goto done; }
+  for (int i = 0, x = 0, y = 1, pair = 0; i < u.numConstraints; ++i) {
+    // Walk the pairs x < y in order up to the picked one.
+    for (; pair < pairs[i]; ++pair) {
+      if (++y == u.numVars) { ++x; y = x + 1; }
+    }
+    CjConstraint* c = &csp.constraints[i];
+    if ((err = cjConstraintAlloc(2, c)) != CJ_ERROR_OK) { goto done; }
+    c->id = (int) (rngNext(&rng) % (uint64_t) u.numConstraintDefs);
+    c->vars.data[0] = x;
+    c->vars.data[1] = y;
+  }
+
+  err = CJ_ERROR_NOMEM;
+  if (!(f = open_memstream(json, jsonLen))) { goto done; }
+  err = cjCspJsonPrint(f, &csp);
+  if (0 != fclose(f) && err == CJ_ERROR_OK) { err = CJ_ERROR_WRITE; }
+
+done:
+  free(pairs);
+  cjCspFree(&csp);
+  return err;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Measurements
+//
+
+typedef std::chrono::high_resolution_clock Clock;
+
+static double elapsedMs(Clock::time_point start, Clock::time_point end) {
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static double mbPerSec(size_t bytes, double ms) {
+  return ms > 0 ? (bytes / (1024.0 * 1024.0)) / (ms / 1000.0) : 0;
+}
+
+/** The best time and the allocations of a step. */
+struct Step {
+  double ms = -1;
+  long long allocs = 0;
+
+  void add(Clock::time_point start, Clock::time_point end, long long allocsStart, long long allocsEnd) {
+    if (ms < 0 || elapsedMs(start, end) < ms) { ms = elapsedMs(start, end); }
+    allocs = allocsStart < 0 ? -1 : allocsEnd - allocsStart;
+  }
+};
+
+static long maxRssKB() {
+  struct rusage usage;
+  return getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : -1;
+}
+
+/** The number of no-good tuples of all constraintDefs. */
+static long long numTuples(const CjCsp& csp) {
+  long long n = 0;
+  for (int i = 0; i < csp.constraintDefsSize; ++i) {
+    if (csp.constraintDefs[i].type == CjConstraintDef::CJ_CONSTRAINT_DEF_NO_GOODS) {
+      n += csp.constraintDefs[i].noGoods.size;
+    }
+  }
+  return n;
+}
+
+/** The bytes of the tuples of all constraintDefs, as int and as dense. */
+static long long tupleBytes(const CjCsp& csp) {
+  long long n = 0;
+  for (int i = 0; i < csp.constraintDefsSize; ++i) {
+    const CjIntTuples& ts = csp.constraintDefs[i].noGoods;
+    n += (long long) sizeof(int) * ts.size * abs(ts.arity);
+  }
+  return n;
+}
+
+static long long denseTupleBytes(const CjDense& dense) {
+  long long n = 0;
+  for (int i = 0; i < dense.defsSize; ++i) {
+    const CjDenseTuples& ts = dense.defs[i].tuples;
+    n += (long long) ts.width * ts.size * ts.arity;
+  }
+  return n;
+}
+
+/**
+ * Compile each binary no-goods def over the bounds of all the domains into
+ * defs (constraintDefsSize items). @return CJ_ERROR_OK on success
+ */
+static CjError compileDefs(const CjCsp& csp, CjDefMatrix* defs) {
+  int min = 0, max = -1;
+  for (int i = 0; i < csp.domainsSize; ++i) {
+    int domainMin, domainMax;
+    if (CJ_ERROR_OK != cjDomainBounds(&csp.domains[i], &domainMin, &domainMax)) { continue; }
+    if (max < min || domainMin < min) { min = domainMin; }
+    if (max < min || domainMax > max) { max = domainMax; }
+  }
+  for (int i = 0; i < csp.constraintDefsSize; ++i) {
+    defs[i] = cjDefMatrixInit();
+    const CjConstraintDef& def = csp.constraintDefs[i];
+    if (def.type != CjConstraintDef::CJ_CONSTRAINT_DEF_NO_GOODS || def.noGoods.arity != 2) { continue; }
+    CjError err = cjDefMatrixCompile(&def.noGoods, min, max - min + 1, min, max - min + 1, &defs[i]);
+    if (err != CJ_ERROR_OK) { return err; }
+  }
+  return CJ_ERROR_OK;
+}
+
+/**
+ * The union and the intersection of the no-goods of each def with the next.
+ * @return CJ_ERROR_OK on success
+ */
+static CjError combineDefs(const CjCsp& csp) {
+  for (int i = 0; i + 1 < csp.constraintDefsSize; ++i) {
+    const CjConstraintDef& a = csp.constraintDefs[i];
+    const CjConstraintDef& b = csp.constraintDefs[i + 1];
+    if (a.type != CjConstraintDef::CJ_CONSTRAINT_DEF_NO_GOODS ||
+        b.type != CjConstraintDef::CJ_CONSTRAINT_DEF_NO_GOODS) {
+      continue;
+    }
+    CjIntTuples both = cjIntTuplesInit();
+    CjIntTuples either = cjIntTuplesInit();
+    CjError err;
+    if (CJ_ERROR_OK != (err = cjIntTuplesUnion(&a.noGoods, &b.noGoods, &either)) ||
+        CJ_ERROR_OK != (err = cjIntTuplesIntersection(&a.noGoods, &b.noGoods, &both))) {
+      cjIntTuplesFree(&either);
+      return err;
+    }
+    cjIntTuplesFree(&either);
+    cjIntTuplesFree(&both);
+  }
+  return CJ_ERROR_OK;
+}
+
+/** The number of bytes cjCspJsonPrintOpts() writes. */
+static CjError printedBytes(CjCsp* csp, const CjPrintOptions* options, size_t* bytes) {
+  char* text = NULL;
+  FILE* f = open_memstream(&text, bytes);
+  if (!f) { return CJ_ERROR_NOMEM; }
+  CjError err = cjCspJsonPrintOpts(f, csp, options);
+  if (0 != fclose(f) && err == CJ_ERROR_OK) { err = CJ_ERROR_WRITE; }
+  free(text);
+  return err;
+}
+
+void printUsage() {
+  fprintf(stderr, "Usage: cj-bench-lib [--reps N] [--threads N] [--arena 0|1] [--compact 0|1] [--max-vals N]\n");
+}
+
+int main(int argc, char** argv) {
+  int err = 0;
+  if (argc % 2 != 1) {
+    fprintf(stderr, "ERROR: number of command line parameters.\n\n");
+    printUsage();
+    return 1;
+  }
+
+  int reps = 5;
+  int maxVals = 1024;
+  CjParseOptions parseOptions = cjParseOptionsInit();
+  CjPrintOptions printOptions = cjPrintOptionsInit();
+  for (int i = 1; i < argc; i += 2) {
+    const bool isBool = strcmp(argv[i + 1], "0") == 0 || strcmp(argv[i + 1], "1") == 0;
+    if (strcmp(argv[i], "--reps") == 0 && (reps = atoi(argv[i + 1])) > 0) {
+      continue;
+    }
+    if (strcmp(argv[i], "--threads") == 0 && (parseOptions.numThreads = atoi(argv[i + 1])) >= 0) {
+      continue;
+    }
+    if (strcmp(argv[i], "--arena") == 0 && isBool) {
+      parseOptions.useArena = atoi(argv[i + 1]);
+      continue;
+    }
+    if (strcmp(argv[i], "--compact") == 0 && isBool) {
+      printOptions.compact = atoi(argv[i + 1]);
+      continue;
+    }
+    if (strcmp(argv[i], "--max-vals") == 0 && (maxVals = atoi(argv[i + 1])) > 0) {
+      continue;
+    }
+    fprintf(stderr, "ERROR: bad %s flag.\n\n", argv[i]);
+    printUsage();
+    return 1;
+  }
+
+  FILE* devNull = fopen("/dev/null", "w");
+  if (!devNull) {
+    fprintf(stderr, "ERROR: failed to open /dev/null.");
+    return 1;
+  }
+
+  for (const Urbcsp& u : urbcspSizes) {
+    if (u.numVals > maxVals) { break; }
+
+    char* json = NULL;
+    size_t jsonLen = 0;
+    if (CJ_ERROR_OK != (err = urbcspJson(u, 1, &json, &jsonLen))) {
+      fprintf(stderr, "ERROR(%d): failed to generate d%d instance.", err, u.numVals);
+      return 1;
+    }
+
+    // Sizes first, outside of the measurements.
+    CjCsp csp = cjCspInit();
+    size_t printBytes = 0;
+    if (CJ_ERROR_OK != (err = cjCspJsonParse(json, jsonLen, &csp)) ||
+        CJ_ERROR_OK != (err = printedBytes(&csp, &printOptions, &printBytes))) {
+      fprintf(stderr, "ERROR(%d): failed to read back d%d instance.", err, u.numVals);
+      return 1;
+    }
+    const long long tuples = numTuples(csp);
+    CjDense dense = cjDenseInit();
+    if (CJ_ERROR_OK != (err = cjDenseAlloc(&csp, &dense))) {
+      fprintf(stderr, "ERROR(%d): failed to make d%d instance dense.", err, u.numVals);
+      return 1;
+    }
+    const long long intBytes = tupleBytes(csp);
+    const long long denseBytes = denseTupleBytes(dense);
+    cjDenseFree(&dense);
+    CjDefMatrix* matrices = (CjDefMatrix*) malloc(sizeof(CjDefMatrix) * (csp.constraintDefsSize + 1));
+    cjCspFree(&csp);
+    if (!matrices) {
+      fprintf(stderr, "ERROR: out of memory.");
+      return 1;
+    }
+
+    Step parse, validate, compile, densify, indexing, combine, print, release;
+    for (int iRep = 0; iRep < reps; ++iRep) {
+      CjCsp csp = cjCspInit();
+      long long a0 = allocCount();
+      auto t0 = Clock::now();
+      if (CJ_ERROR_OK != (err = cjCspJsonParseOpts(json, jsonLen, &parseOptions, &csp))) {
+        fprintf(stderr, "ERROR(%d): failed to parse d%d instance.", err, u.numVals);
+        return 1;
+      }
+      auto t1 = Clock::now();
+      long long a1 = allocCount();
+      if (CJ_ERROR_OK != (err = cjCspValidate(&csp))) {
+        fprintf(stderr, "ERROR(%d): failed to validate d%d instance.", err, u.numVals);
+        return 1;
+      }
+      auto t2 = Clock::now();
+      long long a2 = allocCount();
+      parse.add(t0, t1, a0, a1);
+      validate.add(t1, t2, a1, a2);
+
+      a0 = allocCount();
+      t0 = Clock::now();
+      if (CJ_ERROR_OK != (err = compileDefs(csp, matrices))) {
+        fprintf(stderr, "ERROR(%d): failed to compile d%d instance.", err, u.numVals);
+        return 1;
+      }
+      t1 = Clock::now();
+      a1 = allocCount();
+      compile.add(t0, t1, a0, a1);
+      for (int i = 0; i < csp.constraintDefsSize; ++i) { cjDefMatrixFree(&matrices[i]); }
+
+      a0 = allocCount();
+      t0 = Clock::now();
+      if (CJ_ERROR_OK != (err = cjDenseAlloc(&csp, &dense))) {
+        fprintf(stderr, "ERROR(%d): failed to make d%d instance dense.", err, u.numVals);
+        return 1;
+      }
+      t1 = Clock::now();
+      a1 = allocCount();
+      densify.add(t0, t1, a0, a1);
+      cjDenseFree(&dense);
+
+      CjCspIndex index = cjCspIndexInit();
+      a0 = allocCount();
+      t0 = Clock::now();
+      if (CJ_ERROR_OK != (err = cjCspIndexAlloc(&csp, &index))) {
+        fprintf(stderr, "ERROR(%d): failed to index d%d instance.", err, u.numVals);
+        return 1;
+      }
+      t1 = Clock::now();
+      a1 = allocCount();
+      indexing.add(t0, t1, a0, a1);
+      cjCspIndexFree(&index);
+
+      a0 = allocCount();
+      t0 = Clock::now();
+      if (CJ_ERROR_OK != (err = combineDefs(csp))) {
+        fprintf(stderr, "ERROR(%d): failed to combine d%d instance.", err, u.numVals);
+        return 1;
+      }
+      t1 = Clock::now();
+      a1 = allocCount();
+      combine.add(t0, t1, a0, a1);
+
+      a0 = allocCount();
+      t0 = Clock::now();
+      if (CJ_ERROR_OK != (err = cjCspJsonPrintOpts(devNull, &csp, &printOptions)) || 0 != fflush(devNull)) {
+        fprintf(stderr, "ERROR(%d): failed to print d%d instance.", err, u.numVals);
+        return 1;
+      }
+      t1 = Clock::now();
+      a1 = allocCount();
+      cjCspFree(&csp);
+      t2 = Clock::now();
+      a2 = allocCount();
+      print.add(t0, t1, a0, a1);
+      release.add(t1, t2, a1, a2);
+    }
+
+    printf("{\"instance\": \"d%d\", \"bytes\": %zu, \"tuples\": %lld, \"reps\": %d, "
+           "\"threads\": %d, \"arena\": %d, \"compact\": %d, "
+           "\"parseMs\": %.3f, \"parseMBs\": %.1f, \"parseNsPerTuple\": %.2f, \"parseAllocs\": %lld, "
+           "\"validateMs\": %.3f, \"validateAllocs\": %lld, "
+           "\"compileMs\": %.3f, \"compileNsPerTuple\": %.2f, \"compileAllocs\": %lld, "
+           "\"denseMs\": %.3f, \"denseNsPerTuple\": %.2f, \"denseAllocs\": %lld, "
+           "\"tupleBytes\": %lld, \"denseTupleBytes\": %lld, "
+           "\"indexMs\": %.3f, \"indexAllocs\": %lld, "
+           "\"combineMs\": %.3f, \"combineNsPerTuple\": %.2f, \"combineAllocs\": %lld, "
+           "\"printMs\": %.3f, \"printMBs\": %.1f, \"printNsPerTuple\": %.2f, \"printAllocs\": %lld, "
+           "\"freeMs\": %.3f, \"maxRssKB\": %ld}\n",
+      u.numVals, jsonLen, tuples, reps,
+      parseOptions.numThreads, parseOptions.useArena, printOptions.compact,
+      parse.ms, mbPerSec(jsonLen, parse.ms), tuples ? parse.ms * 1e6 / tuples : 0, parse.allocs,
+      validate.ms, validate.allocs,
+      compile.ms, tuples ? compile.ms * 1e6 / tuples : 0, compile.allocs,
+      densify.ms, tuples ? densify.ms * 1e6 / tuples : 0, densify.allocs,
+      intBytes, denseBytes,
+      indexing.ms, indexing.allocs,
+      combine.ms, tuples ? combine.ms * 1e6 / tuples : 0, combine.allocs,
+      print.ms, mbPerSec(printBytes, print.ms), tuples ? print.ms * 1e6 / tuples : 0, print.allocs,
+      release.ms, maxRssKB());
+    fflush(stdout);
+    free(matrices);
+    free(json);
+  }
+
+  fclose(devNull);
+  return 0;
+}
@@ -0,0 +1,151 @@
+// Measure the parse throughput (MB/s) of a CSP-JSON instance.
+//
+// cjCspJsonParse() reads the text directly without building tokens. For
+// reference, jsmn tokenization alone is timed two ways: count tokens in a
+// first pass then fill them in a second pass, or fill a growable token buffer
+// in one pass.
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define JSMN_STATIC
+#define JSMN_STRICT
+#define JSMN_PARENT_LINKS
+#include "cj/jsmn.h"
+#include "cj/cj-csp.h"
+#include "cj/cj-csp-io.h"
+#include "io.h"
+
+/** Return the number of tokens, or a negative jsmn error. */
+static int tokenizeTwoPass(const char* json, size_t jsonLen) {
+  jsmn_parser p;
+  jsmn_init(&p);
+  int numTokens = jsmn_parse(&p, json, jsonLen, NULL, 0);
+  if (numTokens <= 0) { return numTokens; }
+
+  jsmntok_t* t = (jsmntok_t*) malloc(sizeof(jsmntok_t) * numTokens);
+  if (!t) { return JSMN_ERROR_NOMEM; }
+  jsmn_init(&p);
+  numTokens = jsmn_parse(&p, json, jsonLen, t, numTokens);
+  free(t);
+  return numTokens;
+}
+
+/** Return the number of tokens, or a negative jsmn error. */
+static int tokenizeOnePass(const char* json, size_t jsonLen) {
+  jsmn_parser p;
+  jsmn_init(&p);
+  size_t capacity = jsonLen / 8 + 16;
+  jsmntok_t* t = (jsmntok_t*) malloc(sizeof(jsmntok_t) * capacity);
+  if (!t) { return JSMN_ERROR_NOMEM; }
+
+  int numTokens = 0;
+  while ((numTokens = jsmn_parse(&p, json, jsonLen, t, capacity)) == JSMN_ERROR_NOMEM) {
+    capacity *= 2;
+    jsmntok_t* grown = (jsmntok_t*) realloc(t, sizeof(jsmntok_t) * capacity);
+    if (!grown) { free(t); return JSMN_ERROR_NOMEM; }
+    t = grown;
+  }
+  free(t);
+  return numTokens;
+}
+
+static double elapsedMs(
+  std::chrono::high_resolution_clock::time_point start,
+  std::chrono::high_resolution_clock::time_point end)
+{
+  return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+static double mbPerSec(size_t bytes, double ms) {
+  return ms > 0 ? (bytes / (1024.0 * 1024.0)) / (ms / 1000.0) : 0;
+}
+
+void printUsage() {
+  fprintf(stderr, "Usage: cj-bench-parse --csp INSTANCE_FILENAME|- [--reps N] [--threads N] [--arena 0|1] [--lazy 0|1]\n");
+}
+
+int main(int argc, char** argv) {
+  int err = 0;
+  if (argc < 3 || argc % 2 != 1) {
+    fprintf(stderr, "ERROR: number of command line parameters.\n\n");
+    printUsage();
+    return 1;
+  }
+  else if (strcmp(argv[1], "--csp") != 0) {
+    fprintf(stderr, "ERROR: missing --csp flag.\n\n");
+    printUsage();
+    return 1;
+  }
+  char* cspInstanceFilename = argv[2];
+
+  int reps = 5;
+  CjParseOptions options = cjParseOptionsInit();
+  for (int i = 3; i < argc; i += 2) {
+    if (strcmp(argv[i], "--reps") == 0 && (reps = atoi(argv[i + 1])) > 0) {
+      continue;
+    }
+    if (strcmp(argv[i], "--threads") == 0 && (options.numThreads = atoi(argv[i + 1])) >= 0) {
+      continue;
+    }
+    if (strcmp(argv[i], "--arena") == 0 && (strcmp(argv[i + 1], "0") == 0 || strcmp(argv[i + 1], "1") == 0)) {
+      options.useArena = atoi(argv[i + 1]);
+      continue;
+    }
+    if (strcmp(argv[i], "--lazy") == 0 && (strcmp(argv[i + 1], "0") == 0 || strcmp(argv[i + 1], "1") == 0)) {
+      options.lazyConstraintDefs = atoi(argv[i + 1]);
+      continue;
+    }
+    fprintf(stderr, "ERROR: bad %s flag.\n\n", argv[i]);
+    printUsage();
+    return 1;
+  }
+
+  LoadedFile cspInstanceFile;
+  if (0 != (err = loadAll(cspInstanceFilename, &cspInstanceFile))) {
+    fprintf(stderr, "ERROR(%d): failed to read csp instance file.", err);
+    return 1;
+  }
+  const char* cspJson = cspInstanceFile.contents;
+  size_t cspJsonLen = cspInstanceFile.len;
+
+  // Keep the best of all reps for each measurement.
+  double twoPassMs = -1, onePassMs = -1, parseMs = -1, freeMs = -1;
+  int numTokens = 0;
+  for (int iRep = 0; iRep < reps; ++iRep) {
+    auto t0 = std::chrono::high_resolution_clock::now();
+    int twoPassTokens = tokenizeTwoPass(cspJson, cspJsonLen);
+    auto t1 = std::chrono::high_resolution_clock::now();
+    numTokens = tokenizeOnePass(cspJson, cspJsonLen);
+    auto t2 = std::chrono::high_resolution_clock::now();
+    if (twoPassTokens < 0 || numTokens < 0 || twoPassTokens != numTokens) {
+      fprintf(stderr, "ERROR(%d, %d): failed to tokenize csp instance file.", twoPassTokens, numTokens);
+      return 1;
+    }
+
+    CjCsp csp = cjCspInit();
+    auto t3 = std::chrono::high_resolution_clock::now();
+    if (CJ_ERROR_OK != (err = cjCspJsonParseOpts(cspJson, cspJsonLen, &options, &csp))) {
+      fprintf(stderr, "ERROR(%d): failed to parse csp instance file.", err);
+      return 1;
+    }
+    auto t4 = std::chrono::high_resolution_clock::now();
+    cjCspFree(&csp);
+    auto t5 = std::chrono::high_resolution_clock::now();
+
+    if (twoPassMs < 0 || elapsedMs(t0, t1) < twoPassMs) { twoPassMs = elapsedMs(t0, t1); }
+    if (onePassMs < 0 || elapsedMs(t1, t2) < onePassMs) { onePassMs = elapsedMs(t1, t2); }
+    if (parseMs < 0 || elapsedMs(t3, t4) < parseMs) { parseMs = elapsedMs(t3, t4); }
+    if (freeMs < 0 || elapsedMs(t4, t5) < freeMs) { freeMs = elapsedMs(t4, t5); }
+  }
+
+  printf("{\"file\": \"%s\", \"bytes\": %zu, \"tokens\": %d, \"reps\": %d, \"threads\": %d, \"arena\": %d, \"lazy\": %d, "
+         "\"tokenizeTwoPassMBs\": %.1f, \"tokenizeOnePassMBs\": %.1f, \"parseMBs\": %.1f, \"freeMs\": %.3f}\n",
+    cspInstanceFilename, cspJsonLen, numTokens, reps, options.numThreads, options.useArena, options.lazyConstraintDefs,
+    mbPerSec(cspJsonLen, twoPassMs), mbPerSec(cspJsonLen, onePassMs), mbPerSec(cspJsonLen, parseMs), freeMs);
+
+  unloadAll(&cspInstanceFile);
+  return 0;
+}
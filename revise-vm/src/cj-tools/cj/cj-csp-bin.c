@@ -0,0 +1,371 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cj-csp-bin.h"
+#include "cj-csp-io.h"
+
+////////////////////////////////////////////////////////////////////////////////
+// Layout
+//
+
+#define CJ_BIN_MAGIC "CJCSPBIN"
+#define CJ_BIN_VERSION 1
+#define CJ_BIN_BYTE_ORDER 0x01020304u
+#define CJ_BIN_DATA_ALIGN 64
+
+typedef struct CjBinTuples {
+  int32_t size;
+  int32_t arity;
+  uint64_t data;
+} CjBinTuples;
+
+typedef struct CjBinRecord {
+  int32_t tag;
+  int32_t reserved;
+  CjBinTuples tuples;
+} CjBinRecord;
+
+typedef struct CjBinHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t byteOrder;
+  uint64_t fileSize;
+  uint64_t metaId;
+  uint64_t metaAlgo;
+  uint64_t metaParamsJSON;
+  CjBinTuples vars;
+  int32_t domainsSize;
+  int32_t constraintDefsSize;
+  int32_t constraintsSize;
+  int32_t reserved;
+  uint64_t domains;
+  uint64_t constraintDefs;
+  uint64_t constraints;
+  uint8_t padding[24];
+} CjBinHeader;
+
+_Static_assert(sizeof(CjBinTuples) == 16, "cj-bin tuples are 16 bytes");
+_Static_assert(sizeof(CjBinRecord) == 24, "cj-bin records are 24 bytes");
+_Static_assert(sizeof(CjBinHeader) == 128, "the cj-bin header is 128 bytes");
+
+/** The structs above are the file layout as is on little-endian hosts. */
+static int binHostIsLittleEndian() {
+  const uint32_t x = CJ_BIN_BYTE_ORDER;
+  uint8_t first;
+  memcpy(&first, &x, 1);
+  return first == 0x04;
+}
+
+static uint64_t binAlign(uint64_t offset, uint64_t alignment) {
+  return (offset + alignment - 1) / alignment * alignment;
+}
+
+static uint64_t binTuplesBytes(const CjIntTuples* ts) {
+  if (ts->size <= 0 || ts->arity == 0) { return 0; }
+  return (uint64_t) ts->size * (uint64_t) abs(ts->arity) * sizeof(int32_t);
+}
+
+int cjCspBinIs(const void* data, size_t len) {
+  return data && len >= 8 && memcmp(data, CJ_BIN_MAGIC, 8) == 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Reading
+//
+
+/** Point *out at the null terminated string at offset, or NULL if 0. */
+static CjError binString(const char* base, size_t len, uint64_t offset, char** out) {
+  *out = NULL;
+  if (offset == 0) { return CJ_ERROR_OK; }
+  if (offset >= len) { return CJ_ERROR_BIN_CORRUPT; }
+  if (!memchr(base + offset, '\0', len - offset)) { return CJ_ERROR_BIN_CORRUPT; }
+  *out = (char*) (base + offset);
+  return CJ_ERROR_OK;
+}
+
+static CjError binTuples(const char* base, size_t len, const CjBinTuples* in, CjIntTuples* out) {
+  *out = cjIntTuplesInit();
+  if (in->size < 0 || in->arity < -1) { return CJ_ERROR_BIN_CORRUPT; }
+  out->size = in->size;
+  out->arity = in->arity;
+  const uint64_t bytes = binTuplesBytes(out);
+  if (bytes == 0) { return CJ_ERROR_OK; }
+  if (in->data % CJ_BIN_DATA_ALIGN != 0) { return CJ_ERROR_BIN_ALIGNMENT; }
+  if (in->data == 0 || in->data > len || bytes > len - in->data) { return CJ_ERROR_BIN_CORRUPT; }
+  out->data = (int*) (base + in->data);
+  return CJ_ERROR_OK;
+}
+
+/** Check that the n records at offset are in the file. */
+static CjError binRecordsFit(size_t len, uint64_t offset, int n) {
+  if (n == 0) { return CJ_ERROR_OK; }
+  const uint64_t bytes = (uint64_t) n * sizeof(CjBinRecord);
+  if (offset > len || bytes > len - offset) { return CJ_ERROR_BIN_CORRUPT; }
+  return CJ_ERROR_OK;
+}
+
+/** Copy the n records at offset (see binRecordsFit()) to out, which holds n records. */
+static void binRecords(const char* base, uint64_t offset, int n, CjBinRecord* out) {
+  if (n > 0) { memcpy(out, base + offset, (size_t) n * sizeof(CjBinRecord)); }
+}
+
+static CjError binView(const char* base, size_t len, CjCsp* csp) {
+  CjBinHeader h;
+  memcpy(&h, base, sizeof(h));
+  if (h.version != CJ_BIN_VERSION) { return CJ_ERROR_BIN_MAGIC; }
+  if (h.byteOrder != CJ_BIN_BYTE_ORDER) { return CJ_ERROR_BIN_BYTE_ORDER; }
+  if (h.fileSize > len) { return CJ_ERROR_BIN_CORRUPT; }
+  if (h.domainsSize < 0 || h.constraintDefsSize < 0 || h.constraintsSize < 0) { return CJ_ERROR_BIN_CORRUPT; }
+  len = (size_t) h.fileSize;
+
+  CjError err = CJ_ERROR_OK;
+  if (CJ_ERROR_OK != (err = binString(base, len, h.metaId, &csp->meta.id))) { return err; }
+  if (CJ_ERROR_OK != (err = binString(base, len, h.metaAlgo, &csp->meta.algo))) { return err; }
+  if (CJ_ERROR_OK != (err = binString(base, len, h.metaParamsJSON, &csp->meta.paramsJSON))) { return err; }
+  if (CJ_ERROR_OK != (err = binTuples(base, len, &h.vars, &csp->vars))) { return err; }
+
+  // The counts of records come from the header, check that the records are
+  // in the file before allocating for them.
+  if (CJ_ERROR_OK != (err = binRecordsFit(len, h.domains, h.domainsSize))) { return err; }
+  if (CJ_ERROR_OK != (err = binRecordsFit(len, h.constraintDefs, h.constraintDefsSize))) { return err; }
+  if (CJ_ERROR_OK != (err = binRecordsFit(len, h.constraints, h.constraintsSize))) { return err; }
+  int maxSize = h.domainsSize;
+  if (h.constraintDefsSize > maxSize) { maxSize = h.constraintDefsSize; }
+  if (h.constraintsSize > maxSize) { maxSize = h.constraintsSize; }
+  CjBinRecord* records = (CjBinRecord*) malloc(sizeof(CjBinRecord) * (maxSize > 0 ? maxSize : 1));
+  if (!records) { return CJ_ERROR_NOMEM; }
+
+  // Domains
+  binRecords(base, h.domains, h.domainsSize, records);
+  if (!(csp->domains = cjDomainArray(h.domainsSize))) { err = CJ_ERROR_NOMEM; goto done; }
+  csp->domainsSize = h.domainsSize;
+  for (int i = 0; i < h.domainsSize; ++i) {
+    CjDomain* d = &csp->domains[i];
+    if (records[i].tag == CJ_DOMAIN_VALUES) {
+      d->type = CJ_DOMAIN_VALUES;
+      if (CJ_ERROR_OK != (err = binTuples(base, len, &records[i].tuples, &d->values))) { goto done; }
+    }
+    else if (records[i].tag == CJ_DOMAIN_INTERVALS) {
+      d->type = CJ_DOMAIN_INTERVALS;
+      if (CJ_ERROR_OK != (err = binTuples(base, len, &records[i].tuples, &d->intervals))) { goto done; }
+      if (d->intervals.arity != 2) { err = CJ_ERROR_BIN_CORRUPT; goto done; }
+    }
+    else {
+      err = CJ_ERROR_BIN_CORRUPT;
+      goto done;
+    }
+  }
+
+  // Constraint defs
+  binRecords(base, h.constraintDefs, h.constraintDefsSize, records);
+  if (!(csp->constraintDefs = cjConstraintDefArray(h.constraintDefsSize))) { err = CJ_ERROR_NOMEM; goto done; }
+  csp->constraintDefsSize = h.constraintDefsSize;
+  for (int i = 0; i < h.constraintDefsSize; ++i) {
+    CjConstraintDef* def = &csp->constraintDefs[i];
+    if (records[i].tag == CJ_CONSTRAINT_DEF_NO_GOODS) {
+      def->type = CJ_CONSTRAINT_DEF_NO_GOODS;
+      if (CJ_ERROR_OK != (err = binTuples(base, len, &records[i].tuples, &def->noGoods))) { goto done; }
+    }
+    else if (records[i].tag == CJ_CONSTRAINT_DEF_GOODS) {
+      def->type = CJ_CONSTRAINT_DEF_GOODS;
+      if (CJ_ERROR_OK != (err = binTuples(base, len, &records[i].tuples, &def->goods))) { goto done; }
+    }
+    else {
+      err = CJ_ERROR_BIN_CORRUPT;
+      goto done;
+    }
+  }
+
+  // Constraints
+  binRecords(base, h.constraints, h.constraintsSize, records);
+  if (!(csp->constraints = cjConstraintArray(h.constraintsSize))) { err = CJ_ERROR_NOMEM; goto done; }
+  csp->constraintsSize = h.constraintsSize;
+  for (int i = 0; i < h.constraintsSize; ++i) {
+    csp->constraints[i].id = records[i].tag;
+    if (CJ_ERROR_OK != (err = binTuples(base, len, &records[i].tuples, &csp->constraints[i].vars))) { goto done; }
+  }
+
+done:
+  free(records);
+  return err;
+}
+
+CjError cjCspBinView(const void* data, size_t len, CjCsp* csp) {
+  if (!data || !csp) { return CJ_ERROR_ARG; }
+  if (!cjCspBinIs(data, len)) { return CJ_ERROR_BIN_MAGIC; }
+  if (!binHostIsLittleEndian()) { return CJ_ERROR_BIN_BYTE_ORDER; }
+  if (len < sizeof(CjBinHeader)) { return CJ_ERROR_BIN_CORRUPT; }
+  if ((uintptr_t) data % sizeof(int32_t) != 0) { return CJ_ERROR_BIN_ALIGNMENT; }
+
+  *csp = cjCspInit();
+  csp->borrowed = data;
+  CjError err = binView((const char*) data, len, csp);
+  if (err != CJ_ERROR_OK) {
+    cjCspFree(csp);
+  }
+  return err;
+}
+
+CjError cjCspParse(const char* data, size_t len, CjCsp* csp) {
+  if (cjCspBinIs(data, len)) {
+    return cjCspBinView(data, len, csp);
+  }
+  return cjCspJsonParse(data, len, csp);
+}
+
+CjError cjCspParseOpts(const char* data, size_t len, const CjParseOptions* options, CjCsp* csp) {
+  if (cjCspBinIs(data, len)) {
+    return cjCspBinView(data, len, csp);
+  }
+  return cjCspJsonParseOpts(data, len, options, csp);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// Writing
+//
+// The file is laid out in one pass over the csp, then written in the same
+// order: header, records, strings, then the tuple data blocks.
+//
+
+typedef struct CjBinWriter {
+  FILE* f;
+  /** The offset of the next byte written. */
+  uint64_t offset;
+} CjBinWriter;
+
+static CjError binWrite(CjBinWriter* w, const void* data, size_t len) {
+  if (len > 0 && 1 != fwrite(data, len, 1, w->f)) { return CJ_ERROR_BIN_WRITE; }
+  w->offset += len;
+  return CJ_ERROR_OK;
+}
+
+static CjError binWritePadding(CjBinWriter* w, uint64_t offset) {
+  static const char zeros[CJ_BIN_DATA_ALIGN] = {0};
+  while (w->offset < offset) {
+    const uint64_t n = offset - w->offset < sizeof(zeros) ? offset - w->offset : sizeof(zeros);
+    CjError err = binWrite(w, zeros, (size_t) n);
+    if (err != CJ_ERROR_OK) { return err; }
+  }
+  return CJ_ERROR_OK;
+}
+
+/** Lay out a string at *end, return its offset (0 for NULL). */
+static uint64_t binPlaceString(const char* s, uint64_t* end) {
+  if (!s) { return 0; }
+  const uint64_t offset = *end;
+  *end += strlen(s) + 1;
+  return offset;
+}
+
+/** Lay out the data of ts at *end. */
+static CjBinTuples binPlaceTuples(const CjIntTuples* ts, uint64_t* end) {
+  CjBinTuples out = {ts->size, ts->arity, 0};
+  const uint64_t bytes = binTuplesBytes(ts);
+  if (bytes > 0) {
+    out.data = binAlign(*end, CJ_BIN_DATA_ALIGN);
+    *end = out.data + bytes;
+  }
+  return out;
+}
+
+static CjError binWriteTuples(CjBinWriter* w, const CjIntTuples* ts, const CjBinTuples* placed) {
+  if (placed->data == 0) { return CJ_ERROR_OK; }
+  CjError err = binWritePadding(w, placed->data);
+  if (err != CJ_ERROR_OK) { return err; }
+  return binWrite(w, ts->data, (size_t) binTuplesBytes(ts));
+}
+
+/** The tuples of a domain or constraintDef, or null for other types. */
+static const CjIntTuples* binDomainTuples(const CjDomain* d) {
+  if (d->type == CJ_DOMAIN_VALUES) { return &d->values; }
+  if (d->type == CJ_DOMAIN_INTERVALS) { return &d->intervals; }
+  return NULL;
+}
+
+static const CjIntTuples* binDefTuples(const CjConstraintDef* def) {
+  if (def->type == CJ_CONSTRAINT_DEF_NO_GOODS) { return &def->noGoods; }
+  if (def->type == CJ_CONSTRAINT_DEF_GOODS) { return &def->goods; }
+  return NULL;
+}
+
+CjError cjCspBinWrite(FILE* f, const CjCsp* csp) {
+  if (!f || !csp) { return CJ_ERROR_ARG; }
+  if (!binHostIsLittleEndian()) { return CJ_ERROR_BIN_BYTE_ORDER; }
+  if (csp->domainsSize < 0 || csp->constraintDefsSize < 0 || csp->constraintsSize < 0) { return CJ_ERROR_ARG; }
+
+  CjBinHeader h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, CJ_BIN_MAGIC, 8);
+  h.version = CJ_BIN_VERSION;
+  h.byteOrder = CJ_BIN_BYTE_ORDER;
+  h.domainsSize = csp->domainsSize;
+  h.constraintDefsSize = csp->constraintDefsSize;
+  h.constraintsSize = csp->constraintsSize;
+
+  CjBinRecord* domains = (CjBinRecord*) calloc(csp->domainsSize + 1, sizeof(CjBinRecord));
+  CjBinRecord* constraintDefs = (CjBinRecord*) calloc(csp->constraintDefsSize + 1, sizeof(CjBinRecord));
+  CjBinRecord* constraints = (CjBinRecord*) calloc(csp->constraintsSize + 1, sizeof(CjBinRecord));
+  CjError err = CJ_ERROR_OK;
+  if (!domains || !constraintDefs || !constraints) { err = CJ_ERROR_NOMEM; goto done; }
+
+  // Lay out the records and strings.
+  uint64_t end = sizeof(CjBinHeader);
+  h.domains = csp->domainsSize > 0 ? end : 0;
+  end += sizeof(CjBinRecord) * csp->domainsSize;
+  h.constraintDefs = csp->constraintDefsSize > 0 ? end : 0;
+  end += sizeof(CjBinRecord) * csp->constraintDefsSize;
+  h.constraints = csp->constraintsSize > 0 ? end : 0;
+  end += sizeof(CjBinRecord) * csp->constraintsSize;
+  h.metaId = binPlaceString(csp->meta.id, &end);
+  h.metaAlgo = binPlaceString(csp->meta.algo, &end);
+  h.metaParamsJSON = binPlaceString(csp->meta.paramsJSON, &end);
+
+  // Lay out the tuple data.
+  h.vars = binPlaceTuples(&csp->vars, &end);
+  for (int i = 0; i < csp->domainsSize; ++i) {
+    const CjDomain* d = &csp->domains[i];
+    if (!binDomainTuples(d)) { err = CJ_ERROR_VALIDATION_DOMAINS_TYPE; goto done; }
+    domains[i].tag = d->type;
+    domains[i].tuples = binPlaceTuples(binDomainTuples(d), &end);
+  }
+  for (int i = 0; i < csp->constraintDefsSize; ++i) {
+    const CjConstraintDef* def = &csp->constraintDefs[i];
+    if (!binDefTuples(def)) { err = CJ_ERROR_VALIDATION_CONSTRAINTDEF_TYPE; goto done; }
+    constraintDefs[i].tag = def->type;
+    constraintDefs[i].tuples = binPlaceTuples(binDefTuples(def), &end);
+  }
+  for (int i = 0; i < csp->constraintsSize; ++i) {
+    constraints[i].tag = csp->constraints[i].id;
+    constraints[i].tuples = binPlaceTuples(&csp->constraints[i].vars, &end);
+  }
+  h.fileSize = end;
+
+  // Write it all in the same order.
+  CjBinWriter w = {f, 0};
+  if (CJ_ERROR_OK != (err = binWrite(&w, &h, sizeof(h)))) { goto done; }
+  if (CJ_ERROR_OK != (err = binWrite(&w, domains, sizeof(CjBinRecord) * csp->domainsSize))) { goto done; }
+  if (CJ_ERROR_OK != (err = binWrite(&w, constraintDefs, sizeof(CjBinRecord) * csp->constraintDefsSize))) { goto done; }
+  if (CJ_ERROR_OK != (err = binWrite(&w, constraints, sizeof(CjBinRecord) * csp->constraintsSize))) { goto done; }
+  const char* strings[3] = {csp->meta.id, csp->meta.algo, csp->meta.paramsJSON};
+  for (int i = 0; i < 3; ++i) {
+    if (strings[i] && CJ_ERROR_OK != (err = binWrite(&w, strings[i], strlen(strings[i]) + 1))) { goto done; }
+  }
+  if (CJ_ERROR_OK != (err = binWriteTuples(&w, &csp->vars, &h.vars))) { goto done; }
+  for (int i = 0; i < csp->domainsSize; ++i) {
+    if (CJ_ERROR_OK != (err = binWriteTuples(&w, binDomainTuples(&csp->domains[i]), &domains[i].tuples))) { goto done; }
+  }
+  for (int i = 0; i < csp->constraintDefsSize; ++i) {
+    if (CJ_ERROR_OK != (err = binWriteTuples(&w, binDefTuples(&csp->constraintDefs[i]), &constraintDefs[i].tuples))) { goto done; }
+  }
+  for (int i = 0; i < csp->constraintsSize; ++i) {
+    if (CJ_ERROR_OK != (err = binWriteTuples(&w, &csp->constraints[i].vars, &constraints[i].tuples))) { goto done; }
+  }
+  if (w.offset != h.fileSize) { err = CJ_ERROR; }
+
+done:
+  free(domains);
+  free(constraintDefs);
+  free(constraints);
+  return err;
+}
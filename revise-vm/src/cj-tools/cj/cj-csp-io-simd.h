@@ -0,0 +1,230 @@
+// The SIMD int arrays fast path of cj-csp-io.c (see there), included once
+// per ISA it is compiled for, so there is no include guard. The includer
+// defines:
+//
+//   CJ_SIMD_TARGET      the target of the functions, eg. "sse4.1".
+//   CJ_SIMD_NAME(name)  the name of the function name for that target.
+//   CJ_SIMD_AVX2        if the target has AVX2.
+//
+// and the types and tables that don't depend on the target.
+
+#define CJ_SIMD_FN static inline __attribute__((target(CJ_SIMD_TARGET)))
+#define simdClassify CJ_SIMD_NAME(simdClassify)
+#define simdPack CJ_SIMD_NAME(simdPack)
+#define simdSlots CJ_SIMD_NAME(simdSlots)
+#define simdSlotsToInts CJ_SIMD_NAME(simdSlotsToInts)
+#define simdConvert CJ_SIMD_NAME(simdConvert)
+#define simdParseItems CJ_SIMD_NAME(simdParseItems)
+
+CJ_SIMD_FN void simdClassify(const char* p, CjSimdWindow* w) {
+  const __m128i x = _mm_loadu_si128((const __m128i*) p);
+  const __m128i d = _mm_sub_epi8(x, _mm_set1_epi8('0'));
+  const __m128i isDigit = _mm_cmpeq_epi8(_mm_min_epu8(d, _mm_set1_epi8(9)), d);
+  const __m128i isClose = _mm_cmpeq_epi8(x, _mm_set1_epi8(']'));
+  const __m128i isPunct = _mm_or_si128(
+    _mm_or_si128(
+      _mm_cmpeq_epi8(x, _mm_set1_epi8(',')),
+      _mm_cmpeq_epi8(x, _mm_set1_epi8('['))),
+    isClose);
+  const __m128i isSpace = _mm_or_si128(
+    _mm_or_si128(
+      _mm_cmpeq_epi8(x, _mm_set1_epi8(' ')),
+      _mm_cmpeq_epi8(x, _mm_set1_epi8('\n'))),
+    _mm_or_si128(
+      _mm_cmpeq_epi8(x, _mm_set1_epi8('\r')),
+      _mm_cmpeq_epi8(x, _mm_set1_epi8('\t'))));
+  w->digits = (uint32_t) _mm_movemask_epi8(isDigit);
+  w->punct = (uint32_t) _mm_movemask_epi8(isPunct);
+  w->closes = (uint32_t) _mm_movemask_epi8(isClose);
+  w->other = ~(w->digits | w->punct | (uint32_t) _mm_movemask_epi8(isSpace)) & 0xFFFFu;
+  w->tokens = _mm_blendv_epi8(x, _mm_set1_epi8('0'), isDigit);
+  w->values = d;
+}
+
+
+/** Pack the bytes of x selected by a 16-bit mask to the front, in order. */
+CJ_SIMD_FN __m128i simdPack(__m128i x, uint32_t mask) {
+  const __m128i halves = _mm_shuffle_epi8(x, _mm_set_epi64x(
+    (long long) (simdPackControl[(mask >> 8) & 0xFF] + 0x0808080808080808ull),
+    (long long) simdPackControl[mask & 0xFF]));
+  // Move the packed upper half down behind the packed lower half.
+  const int lowCount = __builtin_popcount(mask & 0xFF);
+  const __m128i iota = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  const __m128i join = _mm_blendv_epi8(
+    _mm_add_epi8(iota, _mm_set1_epi8((char) (8 - lowCount))), iota,
+    _mm_cmpgt_epi8(_mm_set1_epi8((char) lowCount), iota));
+  return _mm_shuffle_epi8(halves, join);
+}
+
+/**
+ * Shuffle the digits of the 4 numbers whose first and last digit positions
+ * are in the low 4 bytes of starts and ends into right-aligned 4-byte slots.
+ */
+CJ_SIMD_FN __m128i simdSlots(__m128i values, __m128i starts, __m128i ends) {
+  const __m128i spread = _mm_setr_epi8(0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3);
+  const __m128i slotStarts = _mm_shuffle_epi8(starts, spread);
+  const __m128i control = _mm_sub_epi8(_mm_shuffle_epi8(ends, spread),
+    _mm_setr_epi8(3, 2, 1, 0, 3, 2, 1, 0, 3, 2, 1, 0, 3, 2, 1, 0));
+  // Bytes before the first digit have the high bit set and are zero filled.
+  return _mm_shuffle_epi8(values, _mm_or_si128(control, _mm_cmpgt_epi8(slotStarts, control)));
+}
+
+/** Turn each 4-digit slot [d0 d1 d2 d3] into the int32 d0d1 * 100 + d2d3. */
+CJ_SIMD_FN __m128i simdSlotsToInts(__m128i slots) {
+  const __m128i pairs = _mm_maddubs_epi16(slots, _mm_set1_epi16(0x010A)); // bytes [10, 1]
+  return _mm_madd_epi16(pairs, _mm_set1_epi32(0x00010064));              // words [100, 1]
+}
+
+/**
+ * Convert the numbers of up to 4 digits that start and end at the bits of
+ * starts and ends into out. 8 ints are always written.
+ */
+CJ_SIMD_FN void simdConvert(const CjSimdWindow* w, uint32_t starts, uint32_t ends, int* out) {
+  const __m128i iota = _mm_setr_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+  const __m128i startPos = simdPack(iota, starts);
+  const __m128i endPos = simdPack(iota, ends);
+  const __m128i lo = simdSlots(w->values, startPos, endPos);
+  const __m128i hi = simdSlots(w->values, _mm_srli_si128(startPos, 4), _mm_srli_si128(endPos, 4));
+#ifdef CJ_SIMD_AVX2
+  // Convert both groups (8 ints) with one multiply-add.
+  const __m256i both = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+  const __m256i pairs = _mm256_maddubs_epi16(both, _mm256_set1_epi16(0x010A));
+  const __m256i ints = _mm256_madd_epi16(pairs, _mm256_set1_epi32(0x00010064));
+  _mm256_storeu_si256((__m256i*) out, ints);
+#else
+  _mm_storeu_si128((__m128i*) out, simdSlotsToInts(lo));
+  _mm_storeu_si128((__m128i*) (out + 4), simdSlotsToInts(hi));
+#endif
+}
+
+/**
+ * Decode as many complete items as possible starting at r->cur and append
+ * their ints to buf. An item is a whole tuple "[a, b, ...]" of the given
+ * arity, or a single int if arity is -1 (1D array). r->cur must be at the
+ * start of an item.
+ *
+ * On return r->cur is just past the last decoded item, so the scalar reader
+ * continues with the separator.
+ *
+ * @return the number of items decoded, or a negative CjError.
+ */
+CJ_SIMD_FN int simdParseItems(CjReader* r, const int arity, CjIntBuf* buf) {
+  if (arity == 0 || arity > CJ_SIMD_MAX_ARITY) { return 0; }
+
+  // The tokens of the items repeat with a fixed period, digits read as '0':
+  //   2D: "[0,0,...,0],"
+  //   1D: "0,"
+  // pattern holds enough repeats to compare 16 tokens from any phase.
+  char pattern[CJ_SIMD_MAX_PERIOD + 16];
+  uint8_t nextPhase[CJ_SIMD_MAX_PERIOD + 16];
+  int period = 0;
+  if (arity < 0) {
+    pattern[period++] = '0';
+    pattern[period++] = ',';
+  }
+  else {
+    pattern[period++] = '[';
+    for (int i = 0; i < arity; ++i) {
+      if (i > 0) { pattern[period++] = ','; }
+      pattern[period++] = '0';
+    }
+    pattern[period++] = ']';
+    pattern[period++] = ',';
+  }
+  for (int i = period; i < (int) sizeof(pattern); ++i) { pattern[i] = pattern[i - period]; }
+  for (int i = 0; i < (int) sizeof(nextPhase); ++i) { nextPhase[i] = (uint8_t) (i % period); }
+  int phase = 0;
+
+  const char* p = r->cur;
+  const char* committed = r->cur;
+  size_t committedSize = buf->size;
+  int items = 0;
+
+  while (p + 16 <= r->end) {
+    // A window holds at most 8 numbers and simdConvert() always writes 8.
+    CjError stat = intBufReserve(buf, 8);
+    if (stat != CJ_ERROR_OK) { return stat; }
+
+    CjSimdWindow w;
+    simdClassify(p, &w);
+    const uint32_t numStarts = w.digits & ~(w.digits << 1);
+    const uint32_t numEnds = w.digits & ~(w.digits >> 1);
+    const uint32_t longRuns = w.digits & (w.digits >> 1) & (w.digits >> 2) & (w.digits >> 3) & (w.digits >> 4);
+    int cut = 16;
+    int next = 16;
+    int stop = 0;
+
+    // Only look at the tokens before the first unexpected character or
+    // number of more than 4 digits, and not at a number directly in front of
+    // an unexpected character.
+    if (w.other) {
+      cut = __builtin_ctz(w.other);
+      while (cut > 0 && ((w.digits >> (cut - 1)) & 1)) { --cut; }
+      stop = 1;
+    }
+    if (longRuns && __builtin_ctz(longRuns) < cut) {
+      cut = __builtin_ctz(longRuns);
+      stop = 1;
+    }
+    // A number running into the end of the window is decoded in the next one.
+    if (!stop && ((w.digits >> 15) & 1)) {
+      cut = 15;
+      while (cut > 0 && ((w.digits >> (cut - 1)) & 1)) { --cut; }
+      next = cut;
+      stop = cut == 0;
+    }
+    uint32_t tokens = (numStarts | w.punct) & ((1u << cut) - 1);
+
+    // Keep the tokens up to the first one that doesn't match the pattern.
+    const int n = __builtin_popcount(tokens);
+    const __m128i expected = _mm_loadu_si128((const __m128i*) (pattern + phase));
+    const uint32_t equal = (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(simdPack(w.tokens, tokens), expected));
+    if (~equal & ((1u << n) - 1)) {
+      uint32_t rest = tokens;
+      for (int i = __builtin_ctz(~equal); i > 0; --i) { rest &= rest - 1; }
+      tokens &= ~rest;
+      stop = 1;
+    }
+    else {
+      phase = nextPhase[phase + n];
+    }
+
+    // The numbers kept are the first ones of the window.
+    const uint32_t nums = tokens & numStarts;
+    const int numCount = __builtin_popcount(nums);
+    uint32_t ends = 0;
+    if (nums) {
+      const int lastStart = 31 - __builtin_clz(nums);
+      const int lastEnd = lastStart + __builtin_ctz(~(w.digits >> lastStart)) - 1;
+      ends = numEnds & ((2u << lastEnd) - 1);
+    }
+
+    // Each matched ']' (2D) or number (1D) ends an item.
+    const size_t windowSize = buf->size;
+    const uint32_t itemEnds = arity < 0 ? ends : tokens & w.closes;
+    if (itemEnds) {
+      const int last = 31 - __builtin_clz(itemEnds);
+      committed = p + last + 1;
+      committedSize = windowSize + __builtin_popcount(nums & ((2u << last) - 1));
+      items += __builtin_popcount(itemEnds);
+    }
+
+    simdConvert(&w, nums, ends, buf->data + windowSize);
+    buf->size = windowSize + numCount;
+    if (stop) { break; }
+    p += next;
+  }
+
+  // Drop any partial item.
+  buf->size = committedSize;
+  r->cur = committed;
+  return items;
+}
+
+#undef CJ_SIMD_FN
+#undef simdClassify
+#undef simdPack
+#undef simdSlots
+#undef simdSlotsToInts
+#undef simdConvert
+#undef simdParseItems
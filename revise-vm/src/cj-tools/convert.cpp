@@ -0,0 +1,94 @@
+// Convert an instance between CSP-JSON and cj-bin, eg.
+//
+//   cj-convert --csp instance.json --to bin > instance.cjb
+//   cj-convert --csp instance.cjb --to json > instance.json
+//
+// The input can be either format. json-compact is CSP-JSON without any
+// whitespace. With --smallest each binary constraintDef is written as
+// noGoods or goods, whichever lists fewer tuples. With --dedup the
+// constraintDefs with the same tuples are written once. With --sort the
+// tuples of each constraintDef are written sorted and without duplicates.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cj/cj-csp.h"
+#include "cj/cj-csp-bin.h"
+#include "cj/cj-csp-io.h"
+#include "cj/cj-csp-matrix.h"
+#include "cj/cj.hpp"
+#include "io.h"
+
+void printUsage() {
+  fprintf(stderr, "Usage: cj-convert --csp INSTANCE_FILENAME|- --to json|json-compact|bin [--smallest] [--dedup] [--sort]\n");
+}
+
+int main(int argc, char** argv) {
+  int err = 0;
+  if (argc < 5) {
+    fprintf(stderr, "ERROR: number of command line parameters.\n\n");
+    printUsage();
+    return 1;
+  }
+  else if (strcmp(argv[1], "--csp") != 0) {
+    fprintf(stderr, "ERROR: missing --csp flag.\n\n");
+    printUsage();
+    return 1;
+  }
+  else if (strcmp(argv[3], "--to") != 0 || (strcmp(argv[4], "json") != 0 && strcmp(argv[4], "json-compact") != 0 && strcmp(argv[4], "bin") != 0)) {
+    fprintf(stderr, "ERROR: bad --to flag.\n\n");
+    printUsage();
+    return 1;
+  }
+  bool smallest = false;
+  bool dedup = false;
+  bool sort = false;
+  for (int i = 5; i < argc; ++i) {
+    if (strcmp(argv[i], "--smallest") == 0) { smallest = true; }
+    else if (strcmp(argv[i], "--dedup") == 0) { dedup = true; }
+    else if (strcmp(argv[i], "--sort") == 0) { sort = true; }
+    else {
+      fprintf(stderr, "ERROR: unknown flag %s.\n\n", argv[i]);
+      printUsage();
+      return 1;
+    }
+  }
+  char* cspInstanceFilename = argv[2];
+  const bool toBin = strcmp(argv[4], "bin") == 0;
+  CjPrintOptions printOptions = cjPrintOptionsInit();
+  printOptions.compact = strcmp(argv[4], "json-compact") == 0;
+
+  // The file goes after the csp, which may point into it.
+  ScopedLoadedFile cspInstanceFile;
+  if (0 != (err = loadAll(cspInstanceFilename, &cspInstanceFile))) {
+    fprintf(stderr, "ERROR(%d): failed to read csp instance file.", err);
+    return 1;
+  }
+
+  cj::Csp csp;
+  if (CJ_ERROR_OK != (err = csp.parse(cspInstanceFile.contents, cspInstanceFile.len))) {
+    fprintf(stderr, "ERROR(%d): failed to parse csp instance file.", err);
+    return 1;
+  }
+  if (smallest && CJ_ERROR_OK != (err = cjCspEncodeSmallest(csp.get()))) {
+    fprintf(stderr, "ERROR(%d): failed to re-encode the constraint definitions.", err);
+    return 1;
+  }
+  if (sort && CJ_ERROR_OK != (err = cjCspSortUniqueConstraintDefs(csp.get()))) {
+    fprintf(stderr, "ERROR(%d): failed to sort the constraint definitions.", err);
+    return 1;
+  }
+  // After --smallest, as defs that differ before may be the same after.
+  if (dedup && CJ_ERROR_OK != (err = cjCspDedupConstraintDefs(csp.get(), NULL))) {
+    fprintf(stderr, "ERROR(%d): failed to merge the constraint definitions.", err);
+    return 1;
+  }
+
+  err = toBin ? cjCspBinWrite(stdout, csp.get()) : cjCspJsonPrintOpts(stdout, csp.get(), &printOptions);
+  if (CJ_ERROR_OK != err || 0 != fflush(stdout)) {
+    fprintf(stderr, "ERROR(%d): failed to write csp instance.", err);
+    return 1;
+  }
+  return 0;
+}
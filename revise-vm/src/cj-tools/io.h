@@ -0,0 +1,133 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * The contents of a file loaded by loadAll().
+ * Regular files are memory mapped, anything else (stdin, pipes, FIFOs) is
+ * read in chunks into a malloc'ed buffer.
+ */
+typedef struct LoadedFile {
+  const char* contents;
+  size_t len;
+  /** 1 if contents is a mapping, 0 if it is malloc'ed. */
+  int mapped;
+} LoadedFile;
+
+/**
+ * Return 0 on success.
+ * filename "-" is stdin.
+ * contents is not null terminated and must be released with unloadAll().
+ */
+static int loadAll(const char* filename, LoadedFile* file) {
+  if (!filename || !file) {
+    return 1;
+  }
+  file->contents = NULL;
+  file->len = 0;
+  file->mapped = 0;
+
+  const int isStdin = strcmp(filename, "-") == 0;
+  const int fd = isStdin ? STDIN_FILENO : open(filename, O_RDONLY);
+  if (fd < 0) {
+    return 2;
+  }
+
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    if (!isStdin) { close(fd); }
+    return 3;
+  }
+
+  // Map the file and let the parser read it in place. Pages are faulted in
+  // up front so that parsing doesn't stall on them.
+  if (S_ISREG(st.st_mode) && st.st_size > 0) {
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    flags |= MAP_POPULATE;
+#endif
+    void* mapping = mmap(NULL, (size_t) st.st_size, PROT_READ, flags, fd, 0);
+    if (mapping != MAP_FAILED) {
+#ifndef MAP_POPULATE
+      madvise(mapping, (size_t) st.st_size, MADV_SEQUENTIAL);
+#endif
+      if (!isStdin) { close(fd); }
+      file->contents = (const char*) mapping;
+      file->len = (size_t) st.st_size;
+      file->mapped = 1;
+      return 0;
+    }
+    // Fall back to reading, eg. on file systems that can't map.
+  }
+
+  size_t capacity = 1 << 16;
+  char* contents = (char*) malloc(capacity);
+  if (!contents) {
+    if (!isStdin) { close(fd); }
+    return 5;
+  }
+  size_t len = 0;
+  for (;;) {
+    if (len == capacity) {
+      capacity *= 2;
+      char* grown = (char*) realloc(contents, capacity);
+      if (!grown) {
+        free(contents);
+        if (!isStdin) { close(fd); }
+        return 5;
+      }
+      contents = grown;
+    }
+    const ssize_t n = read(fd, contents + len, capacity - len);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n < 0) {
+      free(contents);
+      if (!isStdin) { close(fd); }
+      return 6;
+    }
+    if (n == 0) {
+      break;
+    }
+    len += (size_t) n;
+  }
+  if (!isStdin) { close(fd); }
+
+  file->contents = contents;
+  file->len = len;
+  return 0;
+}
+
+/** Release the contents of a file loaded by loadAll(). */
+static void unloadAll(LoadedFile* file) {
+  if (!file || !file->contents) {
+    return;
+  }
+  if (file->mapped) {
+    munmap((void*) file->contents, file->len);
+  }
+  else {
+    free((void*) file->contents);
+  }
+  file->contents = NULL;
+  file->len = 0;
+  file->mapped = 0;
+}
+
+#ifdef __cplusplus
+/**
+ * A LoadedFile that is unloadAll()'ed when it goes out of scope. Declare it
+ * before a csp that may borrow from it, so that it is released after.
+ */
+struct ScopedLoadedFile : LoadedFile {
+  ScopedLoadedFile() : LoadedFile() {}
+  ~ScopedLoadedFile() { unloadAll(this); }
+  ScopedLoadedFile(const ScopedLoadedFile&) = delete;
+  ScopedLoadedFile& operator=(const ScopedLoadedFile&) = delete;
+};
+#endif